@@ -0,0 +1,209 @@
+// Per-interval aggregate stream from tracer agents to mlio_collector
+// File: cluster_agent.c
+
+#include "cluster_agent.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define SEND_TIMEOUT_SEC 1
+
+struct cluster_agent {
+  char host[256];
+  char port[32];
+  char node[CLUSTER_NODE_LEN];
+  int fd;
+  char *buf;
+  size_t used;
+  struct cluster_agent_stats stats;
+};
+
+static int parse_addr(struct cluster_agent *a, const char *addr) {
+  char buf[256], *host = buf, *port = NULL;
+
+  snprintf(buf, sizeof(buf), "%s", addr);
+  if (buf[0] == '[') {
+    char *end = strchr(buf, ']');
+    if (!end || (end[1] != ':' && end[1] != '\0'))
+      return -1;
+    *end = '\0';
+    host = buf + 1;
+    if (end[1])
+      port = end + 2;
+  } else if ((port = strrchr(buf, ':')) != NULL) {
+    *port++ = '\0';
+  }
+  if (*host == '\0')
+    return -1;
+
+  snprintf(a->host, sizeof(a->host), "%s", host);
+  snprintf(a->port, sizeof(a->port), "%s",
+           port && *port ? port : CLUSTER_DEFAULT_PORT);
+  return 0;
+}
+
+static int agent_connect(struct cluster_agent *a) {
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct timeval tv = {.tv_sec = SEND_TIMEOUT_SEC};
+  struct addrinfo *res, *ai;
+  int fd = -1;
+
+  if (getaddrinfo(a->host, a->port, &hints, &res) != 0)
+    return -1;
+
+  for (ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    // Also bounds connect() on Linux
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  a->fd = fd;
+  return fd < 0 ? -1 : 0;
+}
+
+static int send_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    data += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static struct cluster_frame_hdr *frame_hdr(struct cluster_agent *a) {
+  return (struct cluster_frame_hdr *)a->buf;
+}
+
+// ============================================================================
+// PUBLIC INTERFACE
+// ============================================================================
+
+struct cluster_agent *cluster_agent_new(const char *addr, const char *node) {
+  struct cluster_agent *a = calloc(1, sizeof(*a));
+
+  if (!a)
+    return NULL;
+  if (parse_addr(a, addr) != 0) {
+    free(a);
+    errno = EINVAL;
+    return NULL;
+  }
+  a->buf = malloc(CLUSTER_FRAME_MAX);
+  if (!a->buf) {
+    free(a);
+    return NULL;
+  }
+  snprintf(a->node, sizeof(a->node), "%s", node);
+  a->fd = -1;
+  return a;
+}
+
+void cluster_agent_free(struct cluster_agent *a) {
+  if (!a)
+    return;
+  if (a->fd >= 0)
+    close(a->fd);
+  free(a->buf);
+  free(a);
+}
+
+void cluster_agent_begin(struct cluster_agent *a, __u64 start_ns,
+                         __u64 interval_ns) {
+  struct cluster_frame_hdr *h = frame_hdr(a);
+
+  memset(h, 0, sizeof(*h));
+  h->magic = CLUSTER_MAGIC;
+  h->version = CLUSTER_VERSION;
+  h->hdr_size = sizeof(*h);
+  h->start_ns = start_ns;
+  h->interval_ns = interval_ns;
+  memcpy(h->node, a->node, sizeof(h->node));
+  a->used = sizeof(*h);
+}
+
+void cluster_agent_set_layer(struct cluster_agent *a, int layer,
+                             const struct cluster_layer *delta) {
+  if (layer > 0 && layer < CLUSTER_LAYERS)
+    frame_hdr(a)->layers[layer] = *delta;
+}
+
+void cluster_agent_set_erasure(struct cluster_agent *a, __u64 encoded_bytes,
+                               __u64 parity_bytes) {
+  frame_hdr(a)->encoded_bytes = encoded_bytes;
+  frame_hdr(a)->parity_bytes = parity_bytes;
+}
+
+int cluster_agent_add_object(struct cluster_agent *a, const char *name,
+                             __u64 app_bytes, __u64 vfs_bytes,
+                             __u64 device_bytes) {
+  size_t len = strlen(name);
+
+  if (len > CLUSTER_NAME_MAX) {
+    name += len - CLUSTER_NAME_MAX;
+    len = CLUSTER_NAME_MAX;
+  }
+
+  size_t size = cluster_object_size(len);
+  if (a->used + size > CLUSTER_FRAME_MAX) {
+    a->stats.objects_truncated++;
+    return -1;
+  }
+
+  struct cluster_object *o = (struct cluster_object *)(a->buf + a->used);
+  memset(o, 0, size);
+  o->key = cluster_name_hash(name, len);
+  o->app_bytes = app_bytes;
+  o->vfs_bytes = vfs_bytes;
+  o->device_bytes = device_bytes;
+  o->name_len = len;
+  memcpy(o + 1, name, len);
+
+  a->used += size;
+  frame_hdr(a)->n_objects++;
+  return 0;
+}
+
+int cluster_agent_send(struct cluster_agent *a) {
+  int err;
+
+  frame_hdr(a)->frame_size = a->used;
+  if (a->fd < 0 && agent_connect(a) != 0) {
+    a->stats.frames_dropped++;
+    return -1;
+  }
+
+  err = send_all(a->fd, a->buf, a->used);
+  if (err) {
+    // A partial frame leaves the stream unusable, so start over
+    close(a->fd);
+    a->fd = -1;
+    a->stats.frames_dropped++;
+    return err;
+  }
+  a->stats.frames_sent++;
+  a->stats.bytes_sent += a->used;
+  return 0;
+}
+
+void cluster_agent_get_stats(const struct cluster_agent *a,
+                             struct cluster_agent_stats *out) {
+  *out = a->stats;
+}
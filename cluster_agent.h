@@ -0,0 +1,109 @@
+// Per-interval aggregate stream from tracer agents to mlio_collector
+// File: cluster_agent.h
+//
+// In agent mode (-U) every tracer sends one frame per interval over TCP:
+// the per-layer deltas of its in-kernel totals, and the bytes each object
+// moved since the last frame. Objects are named by their path below the
+// MinIO drive, which is the same on every node holding a shard, so the
+// collector can sum one object across the cluster. The collector adds the
+// time window; agents only stamp each frame with its wall-clock start.
+//
+// Frames are a cluster_frame_hdr followed by n_objects cluster_object
+// records, each followed by its name padded to 8 bytes. All fields are
+// native little-endian, as on every architecture the tracer runs on.
+
+#ifndef CLUSTER_AGENT_H
+#define CLUSTER_AGENT_H
+
+#include <linux/types.h>
+#include <stddef.h>
+
+#define CLUSTER_MAGIC 0x4f494c4d // "MLIO"
+#define CLUSTER_VERSION 1
+#define CLUSTER_DEFAULT_PORT "9436"
+#define CLUSTER_NODE_LEN 64
+#define CLUSTER_LAYERS 6 // Indexed by layer, 0 unused
+#define CLUSTER_NAME_MAX 255
+#define CLUSTER_FRAME_MAX (4 * 1024 * 1024)
+
+struct cluster_layer {
+  __u64 events;
+  __u64 bytes;
+  __u64 aligned_bytes;
+};
+
+struct cluster_frame_hdr {
+  __u32 magic;
+  __u16 version;
+  __u16 hdr_size;
+  __u32 frame_size; // Including this header
+  __u32 n_objects;
+  __u64 start_ns;   // CLOCK_REALTIME at the start of the interval
+  __u64 interval_ns;
+  char node[CLUSTER_NODE_LEN];
+  struct cluster_layer layers[CLUSTER_LAYERS];
+  __u64 encoded_bytes; // MinIO erasure encode input, the logical PUT bytes
+  __u64 parity_bytes;
+};
+
+struct cluster_object {
+  __u64 key; // cluster_name_hash() of the name
+  __u64 app_bytes;
+  __u64 vfs_bytes;
+  __u64 device_bytes;
+  __u16 name_len; // Bytes of name after this record, without padding
+  __u16 _pad[3];
+};
+
+static inline size_t cluster_object_size(size_t name_len) {
+  return (sizeof(struct cluster_object) + name_len + 7) & ~(size_t)7;
+}
+
+// FNV-1a, the same on every node
+static inline __u64 cluster_name_hash(const char *name, size_t len) {
+  __u64 h = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)name[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// ============================================================================
+// AGENT
+// ============================================================================
+
+struct cluster_agent;
+
+struct cluster_agent_stats {
+  unsigned long long frames_sent;
+  unsigned long long frames_dropped; // Not connected or the send failed
+  unsigned long long bytes_sent;
+  unsigned long long objects_truncated; // Did not fit in CLUSTER_FRAME_MAX
+};
+
+// addr is "HOST:PORT", "HOST" or "[V6ADDR]:PORT". Connects lazily, on the
+// first send, and again after a failed one.
+struct cluster_agent *cluster_agent_new(const char *addr, const char *node);
+void cluster_agent_free(struct cluster_agent *a);
+
+// Starts the next frame, discarding one that was not sent
+void cluster_agent_begin(struct cluster_agent *a, __u64 start_ns,
+                         __u64 interval_ns);
+void cluster_agent_set_layer(struct cluster_agent *a, int layer,
+                             const struct cluster_layer *delta);
+void cluster_agent_set_erasure(struct cluster_agent *a, __u64 encoded_bytes,
+                               __u64 parity_bytes);
+// Names longer than CLUSTER_NAME_MAX keep their tail. Returns -1 when the
+// frame is full.
+int cluster_agent_add_object(struct cluster_agent *a, const char *name,
+                             __u64 app_bytes, __u64 vfs_bytes,
+                             __u64 device_bytes);
+// Sends the frame. Never blocks for more than a second; a frame that cannot
+// be sent is dropped and counted, the next one reconnects.
+int cluster_agent_send(struct cluster_agent *a);
+void cluster_agent_get_stats(const struct cluster_agent *a,
+                             struct cluster_agent_stats *out);
+
+#endif // CLUSTER_AGENT_H
@@ -0,0 +1,177 @@
+// Columnar event export for the Python analysis scripts
+// File: column_file.c
+
+#include "column_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define COLUMN_ALIGN 8
+
+struct column_writer {
+  int fd;
+  int num_columns;
+  __u32 width[COLUMN_MAX];
+  char *data[COLUMN_MAX]; // COLUMN_BLOCK_ROWS values each
+  __u32 rows;             // Rows in the current block
+  __u64 total_rows;
+  int error;
+};
+
+static inline size_t column_bytes(__u32 width, __u32 rows) {
+  return ((size_t)width * rows + COLUMN_ALIGN - 1) &
+         ~(size_t)(COLUMN_ALIGN - 1);
+}
+
+static __u64 clock_ns(clockid_t clk) {
+  struct timespec ts;
+
+  clock_gettime(clk, &ts);
+  return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+  const char *p = data;
+
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static int write_block(struct column_writer *w) {
+  struct column_block_hdr hdr = {.magic = COLUMN_BLOCK_MAGIC, .rows = w->rows};
+  int err;
+
+  if (w->rows == 0)
+    return 0;
+
+  err = write_all(w->fd, &hdr, sizeof(hdr));
+  for (int c = 0; c < w->num_columns && !err; c++) {
+    size_t used = (size_t)w->width[c] * w->rows;
+    size_t len = column_bytes(w->width[c], w->rows);
+
+    memset(w->data[c] + used, 0, len - used);
+    err = write_all(w->fd, w->data[c], len);
+  }
+
+  w->rows = 0;
+  if (err && !w->error)
+    w->error = err;
+  return err;
+}
+
+static void column_writer_free(struct column_writer *w) {
+  for (int c = 0; c < w->num_columns; c++)
+    free(w->data[c]);
+  free(w);
+}
+
+struct column_writer *column_writer_open(const char *path,
+                                         const struct column_def *cols,
+                                         int num_columns) {
+  struct column_file_header hdr = {0};
+  struct column_desc desc[COLUMN_MAX] = {0};
+  struct column_writer *w;
+
+  if (num_columns <= 0 || num_columns > COLUMN_MAX) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  w = calloc(1, sizeof(*w));
+  if (!w)
+    return NULL;
+
+  w->num_columns = num_columns;
+  for (int c = 0; c < num_columns; c++) {
+    __u32 width = cols[c].width;
+
+    if (width != 1 && width != 2 && width != 4 && width != 8) {
+      column_writer_free(w);
+      errno = EINVAL;
+      return NULL;
+    }
+    w->width[c] = width;
+    // Room for the padding written after the last value
+    w->data[c] = malloc(column_bytes(width, COLUMN_BLOCK_ROWS));
+    if (!w->data[c]) {
+      column_writer_free(w);
+      return NULL;
+    }
+    strncpy(desc[c].name, cols[c].name, COLUMN_NAME_LEN - 1);
+    desc[c].width = width;
+  }
+
+  w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (w->fd < 0) {
+    column_writer_free(w);
+    return NULL;
+  }
+
+  memcpy(hdr.magic, COLUMN_FILE_MAGIC, sizeof(COLUMN_FILE_MAGIC));
+  hdr.version = COLUMN_FILE_VERSION;
+  hdr.num_columns = num_columns;
+  hdr.boot_offset_ns = clock_ns(CLOCK_REALTIME) - clock_ns(CLOCK_MONOTONIC);
+  gethostname(hdr.hostname, sizeof(hdr.hostname) - 1);
+
+  w->error = write_all(w->fd, &hdr, sizeof(hdr));
+  if (!w->error)
+    w->error = write_all(w->fd, desc, sizeof(desc[0]) * num_columns);
+  return w;
+}
+
+int column_writer_append(struct column_writer *w, const __u64 *row) {
+  for (int c = 0; c < w->num_columns; c++) {
+    char *slot = w->data[c] + (size_t)w->width[c] * w->rows;
+
+    switch (w->width[c]) {
+    case 1:
+      *(__u8 *)slot = row[c];
+      break;
+    case 2:
+      *(__u16 *)slot = row[c];
+      break;
+    case 4:
+      *(__u32 *)slot = row[c];
+      break;
+    default:
+      *(__u64 *)slot = row[c];
+      break;
+    }
+  }
+
+  w->total_rows++;
+  if (++w->rows == COLUMN_BLOCK_ROWS)
+    return write_block(w);
+  return 0;
+}
+
+int column_writer_close(struct column_writer *w) {
+  int err;
+
+  if (!w)
+    return 0;
+
+  write_block(w);
+  err = w->error;
+  if (close(w->fd) != 0 && !err)
+    err = -errno;
+  column_writer_free(w);
+  return err;
+}
+
+__u64 column_writer_rows(const struct column_writer *w) {
+  return w ? w->total_rows : 0;
+}
@@ -0,0 +1,59 @@
+// Columnar event export for the Python analysis scripts
+// File: column_file.h
+//
+// A column file is a column_file_header, num_columns column_desc entries,
+// then blocks of up to COLUMN_BLOCK_ROWS rows. Each block is a
+// column_block_hdr followed by every column's values for those rows as a
+// packed little-endian unsigned array, padded to 8 bytes. The layout lets
+// trace_columns.py turn each block into numpy arrays without parsing a
+// single row, so a 10M event trace loads in well under a second.
+
+#ifndef COLUMN_FILE_H
+#define COLUMN_FILE_H
+
+#include <linux/types.h>
+
+#define COLUMN_FILE_MAGIC "MLIOCOL"
+#define COLUMN_FILE_VERSION 1
+#define COLUMN_BLOCK_MAGIC 0x4b4c4243 // "CBLK"
+#define COLUMN_BLOCK_ROWS 65536
+#define COLUMN_NAME_LEN 24
+#define COLUMN_MAX 16
+
+struct column_file_header {
+  char magic[8];
+  __u32 version;
+  __u32 num_columns;
+  __u64 boot_offset_ns; // CLOCK_REALTIME - CLOCK_MONOTONIC at export start
+  char hostname[64];
+};
+
+struct column_desc {
+  char name[COLUMN_NAME_LEN];
+  __u32 width; // Bytes per value: 1, 2, 4 or 8
+  __u32 _pad;
+};
+
+struct column_block_hdr {
+  __u32 magic;
+  __u32 rows;
+};
+
+struct column_def {
+  const char *name;
+  __u32 width;
+};
+
+struct column_writer;
+
+struct column_writer *column_writer_open(const char *path,
+                                         const struct column_def *cols,
+                                         int num_columns);
+// row holds one value per column, in column order; each is truncated to
+// the column width
+int column_writer_append(struct column_writer *w, const __u64 *row);
+// Writes the last partial block and closes the file. Returns 0 on success.
+int column_writer_close(struct column_writer *w);
+__u64 column_writer_rows(const struct column_writer *w);
+
+#endif // COLUMN_FILE_H
@@ -14,6 +14,8 @@ import matplotlib.patches as mpatches
 from pathlib import Path
 from collections import defaultdict
 
+import trace_columns
+
 # Set publication-quality defaults
 plt.rcParams['font.family'] = 'Times New Roman'
 plt.rcParams['font.size'] = 10
@@ -56,6 +58,10 @@ class MinIOTraceAnalyzer:
     
     def parse_trace(self):
         """Parse trace and extract actual test I/O"""
+        if trace_columns.is_column_file(self.trace_file):
+            self._parse_columns()
+            return
+
         with open(self.trace_file, 'r') as f:
             lines = f.readlines()
         
@@ -81,6 +87,53 @@ class MinIOTraceAnalyzer:
             if 'DEV_BIO_COMPLETE' in line and in_test_window:
                 in_test_window = False
     
+    def _parse_columns(self):
+        """Same windowing and accounting as parse_trace(), vectorized over a
+        column file written with the tracer's -W option"""
+        df = trace_columns.load_trace(self.trace_file)
+        if len(df) == 0:
+            return
+
+        event = df['event']
+        idx = np.arange(len(df))
+
+        # A window opens at XL_META/FS_SYNC and closes after the next
+        # DEV_BIO_COMPLETE, which is itself still inside the window
+        start = event.str.contains('XL_META|FS_SYNC').to_numpy()
+        end = (event == 'DEV_BIO_COMPLETE').to_numpy()
+        last_start = np.maximum.accumulate(np.where(start, idx, -1))
+        last_end = np.maximum.accumulate(np.where(end, idx, -1))
+        prev_end = np.concatenate(([-1], last_end[:-1]))
+        in_window = last_start > prev_end
+
+        layer = df['layer'].to_numpy()[in_window]
+        event = event[in_window]
+        size = df['size'].to_numpy()[in_window]
+        aligned = trace_columns.aligned_or_size(df)[in_window]
+
+        at = {name: layer == getattr(trace_columns, f'LAYER_{name}')
+              for name in ('APPLICATION', 'STORAGE_SERVICE',
+                           'OPERATING_SYSTEM', 'FILESYSTEM', 'DEVICE')}
+        has = {key: event.str.contains(key).to_numpy()
+               for key in ('PUT', 'GET', 'WRITE', 'READ', 'META', 'SYNC',
+                           'SUBMIT')}
+
+        # Skip heartbeat operations (8 bytes at regular intervals)
+        keep = ~((size == 8) & at['APPLICATION'])
+
+        app = keep & at['APPLICATION'] & (size > 8)
+        os_io = keep & at['OPERATING_SYSTEM']
+        io = self.actual_io
+        io['app_put'] += int(size[app & has['PUT']].sum())
+        io['app_get'] += int(size[app & ~has['PUT'] & has['GET']].sum())
+        io['os_write'] += int(aligned[os_io & has['WRITE']].sum())
+        io['os_read'] += int(aligned[os_io & ~has['WRITE'] & has['READ']].sum())
+        io['metadata'] += 450 * int(
+            (keep & at['STORAGE_SERVICE'] & has['META']).sum())
+        io['journal'] += 4096 * int(
+            (keep & at['FILESYSTEM'] & has['SYNC']).sum())
+        io['device'] += int(size[keep & at['DEVICE'] & has['SUBMIT']].sum())
+
     def _process_line(self, parts):
         """Process a line within test window"""
         try:
@@ -151,7 +204,10 @@ def analyze_all_traces(results_dir):
     
     for size in sizes:
         trace_file = Path(results_dir) / f"{size}_trace.log"
-        if not trace_file.exists():
+        # Prefer a column export (multilayer_io_tracer -W) when there is one
+        if (Path(results_dir) / f"{size}_trace.cols").exists():
+            trace_file = Path(results_dir) / f"{size}_trace.cols"
+        elif not trace_file.exists():
             # Try alternative naming
             trace_files = glob.glob(f"{results_dir}/*{size}*trace*.log")
             if trace_files:
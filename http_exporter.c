@@ -0,0 +1,259 @@
+// Minimal HTTP server for Prometheus/OpenMetrics scrapes
+// File: http_exporter.c
+
+#define _GNU_SOURCE // open_memstream, accept4
+#include "http_exporter.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define REQUEST_MAX 4096
+#define POLL_INTERVAL_MS 200
+#define CLIENT_TIMEOUT_SEC 2
+
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+struct http_exporter {
+  int listen_fd;
+  pthread_t thread;
+  _Atomic bool stop;
+  _Atomic unsigned long long scrapes;
+  metrics_render_fn render;
+  void *ctx;
+};
+
+static int send_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    data += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static void send_response(int fd, const char *status, const char *type,
+                          const char *body, size_t len, bool head) {
+  char hdr[256];
+  int n;
+
+  n = snprintf(hdr, sizeof(hdr),
+               "HTTP/1.1 %s\r\n"
+               "Content-Type: %s\r\n"
+               "Content-Length: %zu\r\n"
+               "Connection: close\r\n"
+               "\r\n",
+               status, type, len);
+  if (send_all(fd, hdr, n) == 0 && !head && len > 0)
+    send_all(fd, body, len);
+}
+
+// Reads the request head. Returns its length, or -1 if the client went
+// away or sent something too large to be a scrape.
+static int read_request(int fd, char *buf, size_t size) {
+  size_t used = 0;
+
+  while (used < size - 1) {
+    ssize_t n = recv(fd, buf + used, size - 1 - used, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    used += n;
+    buf[used] = '\0';
+    if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n"))
+      return used;
+  }
+  return -1;
+}
+
+static void serve_metrics(struct http_exporter *x, int fd, bool head) {
+  char *body = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&body, &len);
+  int err;
+
+  if (!out) {
+    send_response(fd, "500 Internal Server Error", "text/plain", NULL, 0,
+                  head);
+    return;
+  }
+
+  err = x->render(out, x->ctx);
+  fclose(out);
+  if (err)
+    send_response(fd, "500 Internal Server Error", "text/plain", NULL, 0,
+                  head);
+  else
+    send_response(fd, "200 OK", METRICS_CONTENT_TYPE, body, len, head);
+  atomic_fetch_add(&x->scrapes, 1);
+  free(body);
+}
+
+static void handle_client(struct http_exporter *x, int fd) {
+  static const char index_page[] =
+      "<html><body><a href=\"/metrics\">/metrics</a></body></html>\n";
+  struct timeval tv = {.tv_sec = CLIENT_TIMEOUT_SEC};
+  char req[REQUEST_MAX];
+  char method[8], path[256];
+  bool head;
+
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  if (read_request(fd, req, sizeof(req)) < 0)
+    return;
+  if (sscanf(req, "%7s %255s", method, path) != 2) {
+    send_response(fd, "400 Bad Request", "text/plain", NULL, 0, false);
+    return;
+  }
+
+  head = strcmp(method, "HEAD") == 0;
+  if (!head && strcmp(method, "GET") != 0) {
+    send_response(fd, "405 Method Not Allowed", "text/plain", NULL, 0, false);
+    return;
+  }
+
+  // Ignore any query string, Prometheus may add one
+  path[strcspn(path, "?")] = '\0';
+  if (strcmp(path, "/metrics") == 0)
+    serve_metrics(x, fd, head);
+  else if (strcmp(path, "/") == 0)
+    send_response(fd, "200 OK", "text/html", index_page,
+                  sizeof(index_page) - 1, head);
+  else
+    send_response(fd, "404 Not Found", "text/plain", NULL, 0, head);
+}
+
+static void *exporter_thread(void *arg) {
+  struct http_exporter *x = arg;
+  struct pollfd pfd = {.fd = x->listen_fd, .events = POLLIN};
+
+  while (!atomic_load(&x->stop)) {
+    int n = poll(&pfd, 1, POLL_INTERVAL_MS);
+    if (n <= 0)
+      continue;
+
+    int fd = accept4(x->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0)
+      continue;
+    handle_client(x, fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+static int open_listener(const char *addr) {
+  struct addrinfo hints = {
+      .ai_family = AF_UNSPEC,
+      .ai_socktype = SOCK_STREAM,
+      .ai_flags = AI_PASSIVE,
+  };
+  struct addrinfo *res, *ai;
+  char buf[256], *host = buf, *port;
+  int fd = -1, one = 1, err;
+
+  snprintf(buf, sizeof(buf), "%s", addr);
+  if (buf[0] == '[') {
+    char *end = strchr(buf, ']');
+    if (!end || (end[1] != ':' && end[1] != '\0')) {
+      errno = EINVAL;
+      return -1;
+    }
+    *end = '\0';
+    host = buf + 1;
+    port = end[1] ? end + 2 : HTTP_EXPORTER_DEFAULT_PORT;
+  } else if ((port = strrchr(buf, ':')) != NULL) {
+    *port++ = '\0';
+  } else {
+    port = buf;
+    host = buf + strlen(buf); // Empty
+  }
+  if (*port == '\0')
+    port = HTTP_EXPORTER_DEFAULT_PORT;
+
+  err = getaddrinfo(*host ? host : NULL, port, &hints, &res);
+  if (err) {
+    errno = err == EAI_SYSTEM ? errno : EINVAL;
+    return -1;
+  }
+
+  for (ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0)
+      break;
+    err = errno;
+    close(fd);
+    errno = err;
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// ============================================================================
+// PUBLIC INTERFACE
+// ============================================================================
+
+struct http_exporter *http_exporter_start(const char *addr,
+                                          metrics_render_fn render, void *ctx) {
+  struct http_exporter *x;
+  int err;
+
+  x = calloc(1, sizeof(*x));
+  if (!x)
+    return NULL;
+
+  x->render = render;
+  x->ctx = ctx;
+  atomic_init(&x->stop, false);
+  atomic_init(&x->scrapes, 0);
+
+  x->listen_fd = open_listener(addr);
+  if (x->listen_fd < 0) {
+    err = errno;
+    free(x);
+    errno = err;
+    return NULL;
+  }
+
+  err = pthread_create(&x->thread, NULL, exporter_thread, x);
+  if (err) {
+    close(x->listen_fd);
+    free(x);
+    errno = err;
+    return NULL;
+  }
+  return x;
+}
+
+void http_exporter_stop(struct http_exporter *x) {
+  if (!x)
+    return;
+
+  atomic_store(&x->stop, true);
+  pthread_join(x->thread, NULL);
+  close(x->listen_fd);
+  free(x);
+}
+
+unsigned long long http_exporter_scrapes(const struct http_exporter *x) {
+  return x ? atomic_load(&x->scrapes) : 0;
+}
@@ -0,0 +1,30 @@
+// Minimal HTTP server for Prometheus/OpenMetrics scrapes
+// File: http_exporter.h
+//
+// Runs one thread that accepts connections on [ADDR]:PORT and answers
+// GET /metrics by calling a render callback into an in-memory buffer. The
+// callback runs on the exporter thread, one scrape at a time, so it must
+// only read state that is safe to read concurrently with the tracer (e.g.
+// BPF maps), never the main thread's counters.
+
+#ifndef HTTP_EXPORTER_H
+#define HTTP_EXPORTER_H
+
+#include <stdio.h>
+
+#define HTTP_EXPORTER_DEFAULT_PORT "9435"
+
+struct http_exporter;
+
+// Write the exposition text to out. Returns 0, or -1 to answer with 500.
+typedef int (*metrics_render_fn)(FILE *out, void *ctx);
+
+// addr is "PORT", ":PORT", "HOST:PORT" or "[V6ADDR]:PORT". An empty host
+// listens on all addresses. Returns NULL with errno set on failure.
+struct http_exporter *http_exporter_start(const char *addr,
+                                          metrics_render_fn render, void *ctx);
+// Stops the thread and closes the listening socket
+void http_exporter_stop(struct http_exporter *x);
+unsigned long long http_exporter_scrapes(const struct http_exporter *x);
+
+#endif // HTTP_EXPORTER_H
@@ -105,13 +105,33 @@ struct request_branch {
   u64 branch_timestamp;
 };
 
+// Latest write branch per inode (struct inode *). Writeback kworkers flush
+// the dirty pages later and on another thread, so bios find their request
+// through the page mapping instead of request_tracking.
 struct {
-  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(type, BPF_MAP_TYPE_LRU_HASH);
   __uint(max_entries, MAX_ENTRIES * 4);
   __type(key, u64);
   __type(value, struct request_branch);
 } request_branches SEC(".maps");
 
+// Branch each in-flight bio (struct bio *) was attributed to, for the
+// completion side
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_ENTRIES);
+  __type(key, u64);
+  __type(value, struct request_branch);
+} bio_branches SEC(".maps");
+
+// Per-CPU sequence for request ids, see generate_request_id()
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, 1);
+  __type(key, u32);
+  __type(value, u64);
+} request_id_seq SEC(".maps");
+
 // Helper to check if process is MinIO (but not the tracer itself)
 static __always_inline bool is_minio_process(const char *comm) {
   // Exclude the tracer itself to prevent infinite loops
@@ -157,9 +177,30 @@ static __always_inline bool is_minio_file(const char *filename) {
   return false;
 }
 
-static __always_inline u64 generate_request_id(u64 pid_tgid) {
-  u64 ts = bpf_ktime_get_ns();
-  return (pid_tgid << 32) | (ts & 0xFFFFFFFF);
+// A per-CPU sequence number tagged with the CPU: unique for the life of the
+// tracer, never 0, and independent of which thread the request runs on
+static __always_inline u64 generate_request_id(void) {
+  u32 key = 0;
+  u64 *seq = bpf_map_lookup_elem(&request_id_seq, &key);
+
+  if (!seq)
+    return 0;
+  *seq += 1;
+  return (*seq << 10) | (bpf_get_smp_processor_id() & 1023);
+}
+
+// Page cache inode behind the first segment of a bio, or NULL for bios
+// without data pages and for anonymous pages
+static __always_inline struct inode *bio_inode(struct bio *bio) {
+  struct page *page = BPF_CORE_READ(bio, bi_io_vec, bv_page);
+  if (!page)
+    return NULL;
+
+  struct address_space *mapping = BPF_CORE_READ(page, mapping);
+  if (!mapping || ((u64)mapping & 3))
+    return NULL;
+
+  return BPF_CORE_READ(mapping, host);
 }
 
 static __always_inline void init_event(struct multilayer_io_event *event) {
@@ -194,7 +235,7 @@ int trace_minio_write(struct trace_event_raw_sys_enter *ctx) {
     req_ctx.branch_count++;
   } else {
     // New request
-    req_ctx.app_request_id = generate_request_id(pid_tgid);
+    req_ctx.app_request_id = generate_request_id();
     req_ctx.parent_request_id = 0;
     req_ctx.original_size = ctx->args[2];
     req_ctx.timestamp = bpf_ktime_get_ns();
@@ -254,7 +295,7 @@ int trace_minio_read(struct trace_event_raw_sys_enter *ctx) {
     req_ctx = *existing;
     req_ctx.branch_count++;
   } else {
-    req_ctx.app_request_id = generate_request_id(pid_tgid);
+    req_ctx.app_request_id = generate_request_id();
     req_ctx.parent_request_id = 0;
     req_ctx.original_size = ctx->args[2];
     req_ctx.timestamp = bpf_ktime_get_ns();
@@ -364,19 +405,13 @@ int trace_vfs_read_correlated(struct pt_regs *ctx) {
   if (!req_ctx)
     return 0;
 
-  // Check for branching - multiple reads for same request
+  // Each read of the request is a branch. Reads are submitted by the reader
+  // itself, so unlike writes they need no entry in request_branches.
   struct request_branch branch = {};
-  u64 branch_key = pid_tgid ^ bpf_ktime_get_ns();
-
-  struct request_branch *existing_branch =
-      bpf_map_lookup_elem(&request_branches, &branch_key);
-  if (!existing_branch) {
-    branch.parent_request_id = req_ctx->app_request_id;
-    branch.branch_id = req_ctx->branch_count++;
-    branch.total_branches = 1;
-    branch.branch_timestamp = bpf_ktime_get_ns();
-    bpf_map_update_elem(&request_branches, &branch_key, &branch, BPF_ANY);
-  }
+  branch.parent_request_id = req_ctx->app_request_id;
+  branch.branch_id = req_ctx->branch_count++;
+  branch.total_branches = 1;
+  branch.branch_timestamp = bpf_ktime_get_ns();
 
   struct multilayer_io_event *event =
       bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
@@ -430,15 +465,21 @@ int trace_vfs_write_correlated(struct pt_regs *ctx) {
   if (!req_ctx)
     return 0;
 
-  // Track branching for parallel writes
+  struct inode *inode = NULL;
+  if (file)
+    inode = BPF_CORE_READ(file, f_inode);
+
+  // Track branching for parallel writes. The branch is keyed by the inode
+  // it dirties so writeback can be charged back to this request.
   struct request_branch branch = {};
-  u64 branch_key = pid_tgid ^ bpf_ktime_get_ns();
+  u64 branch_key = (u64)inode;
 
   branch.parent_request_id = req_ctx->app_request_id;
   branch.branch_id = req_ctx->branch_count++;
   branch.total_branches = 1;
   branch.branch_timestamp = bpf_ktime_get_ns();
-  bpf_map_update_elem(&request_branches, &branch_key, &branch, BPF_ANY);
+  if (branch_key)
+    bpf_map_update_elem(&request_branches, &branch_key, &branch, BPF_ANY);
 
   struct multilayer_io_event *event =
       bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
@@ -458,12 +499,8 @@ int trace_vfs_write_correlated(struct pt_regs *ctx) {
   event->branch_id = branch.branch_id;
   event->branch_count = req_ctx->branch_count;
 
-  if (file) {
-    struct inode *inode = BPF_CORE_READ(file, f_inode);
-    if (inode) {
-      event->inode = BPF_CORE_READ(inode, i_ino);
-    }
-  }
+  if (inode)
+    event->inode = BPF_CORE_READ(inode, i_ino);
 
   event->aligned_size = (count + 4095) & ~4095ULL;
 
@@ -521,23 +558,34 @@ int trace_fs_sync_correlated(struct pt_regs *ctx) {
 // Device Layer - Block I/O with correlation
 // ============================================================================
 
+// Write bios are charged to the branch that dirtied their pages, even when
+// a writeback kworker submits them. Anything else must come from MinIO.
 SEC("kprobe/submit_bio")
 int trace_bio_submit_correlated(struct pt_regs *ctx) {
   u64 pid_tgid = bpf_get_current_pid_tgid();
   u32 pid = pid_tgid >> 32;
 
+  struct bio *bio = (struct bio *)PT_REGS_PARM1(ctx);
+  if (!bio)
+    return 0;
+
+  struct request_branch *dirtied_by = NULL;
+  // op_is_write(): the odd REQ_OP_* values carry data to the device
+  if (BPF_CORE_READ(bio, bi_opf) & 1) {
+    u64 inode_key = (u64)bio_inode(bio);
+    if (inode_key)
+      dirtied_by = bpf_map_lookup_elem(&request_branches, &inode_key);
+  }
+
   char comm[MAX_COMM_LEN] = {};
   bpf_get_current_comm(comm, sizeof(comm));
 
-  if (!is_minio_process(comm))
-    return 0;
-
-  struct bio *bio = (struct bio *)PT_REGS_PARM1(ctx);
-  if (!bio)
+  if (!dirtied_by && !is_minio_process(comm))
     return 0;
 
   struct request_context *req_ctx =
       bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+  struct request_branch branch = {};
 
   struct multilayer_io_event *event =
       bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
@@ -571,7 +619,13 @@ int trace_bio_submit_correlated(struct pt_regs *ctx) {
     event->dev_minor = dev & 0xFFFFF;
   }
 
-  if (req_ctx) {
+  if (dirtied_by) {
+    branch = *dirtied_by;
+    event->request_id = branch.parent_request_id;
+    event->branch_id = branch.branch_id;
+  } else if (req_ctx) {
+    branch.parent_request_id = req_ctx->app_request_id;
+    branch.branch_id = req_ctx->branch_count;
     event->request_id = req_ctx->app_request_id;
     event->parent_request_id = req_ctx->parent_request_id;
     event->branch_id = req_ctx->branch_count;
@@ -582,8 +636,8 @@ int trace_bio_submit_correlated(struct pt_regs *ctx) {
 
   // Track bio for completion
   u64 bio_addr = (u64)bio;
-  u64 start_time = bpf_ktime_get_ns();
-  bpf_map_update_elem(&io_start_times, &bio_addr, &start_time, BPF_ANY);
+  branch.branch_timestamp = bpf_ktime_get_ns();
+  bpf_map_update_elem(&bio_branches, &bio_addr, &branch, BPF_ANY);
 
   return 0;
 }
@@ -596,16 +650,17 @@ int trace_bio_complete_correlated(struct pt_regs *ctx) {
 
   u64 bio_addr = (u64)bio;
 
-  u64 *start_time = bpf_map_lookup_elem(&io_start_times, &bio_addr);
-  if (!start_time)
+  struct request_branch *branch =
+      bpf_map_lookup_elem(&bio_branches, &bio_addr);
+  if (!branch)
     return 0;
 
-  u64 latency = bpf_ktime_get_ns() - *start_time;
+  u64 latency = bpf_ktime_get_ns() - branch->branch_timestamp;
 
   struct multilayer_io_event *event =
       bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
   if (!event) {
-    bpf_map_delete_elem(&io_start_times, &bio_addr);
+    bpf_map_delete_elem(&bio_branches, &bio_addr);
     return 0;
   }
 
@@ -615,6 +670,8 @@ int trace_bio_complete_correlated(struct pt_regs *ctx) {
   event->layer = LAYER_DEVICE;
   event->event_type = EVENT_DEV_BIO_COMPLETE;
   event->latency_ns = latency;
+  event->request_id = branch->parent_request_id;
+  event->branch_id = branch->branch_id;
 
   unsigned int bi_size = BPF_CORE_READ(bio, bi_iter.bi_size);
   event->size = bi_size;
@@ -625,7 +682,7 @@ int trace_bio_complete_correlated(struct pt_regs *ctx) {
   }
 
   bpf_ringbuf_submit(event, 0);
-  bpf_map_delete_elem(&io_start_times, &bio_addr);
+  bpf_map_delete_elem(&bio_branches, &bio_addr);
 
   return 0;
 }
@@ -17,17 +17,13 @@
 
 // Include the auto-generated skeleton
 #include "minio_tracer.skel.h"
+#include "request_table.h"
+#include "stream_writer.h"
+#include "tracer_events.h"
 
 #define MAX_COMM_LEN 16
 #define MAX_FILENAME_LEN 256
 
-// Layer definitions (must match BPF program)
-#define LAYER_APPLICATION 1
-#define LAYER_STORAGE_SERVICE 2
-#define LAYER_OPERATING_SYSTEM 3
-#define LAYER_FILESYSTEM 4
-#define LAYER_DEVICE 5
-
 // Must match the BPF program's struct exactly
 struct multilayer_io_event {
   __u64 timestamp;
@@ -90,18 +86,15 @@ struct request_flow {
   __u32 replication_factor;
 };
 
-#define MAX_REQUESTS 10000
-static struct request_flow requests[MAX_REQUESTS];
-static int request_count = 0;
-
-const char *layer_names[] = {"UNKNOWN", "APPLICATION", "STORAGE_SVC",
-                             "OS",      "FILESYSTEM",  "DEVICE"};
+static struct request_table *requests = NULL;
 
 static struct env {
   bool verbose;
   bool minio_only;
   bool show_branches;
   bool correlation_mode;
+  int max_requests;
+  int request_max_age;
   int duration;
   const char *output_file;
 } env = {
@@ -109,6 +102,8 @@ static struct env {
     .minio_only = true,
     .show_branches = true,
     .correlation_mode = true,
+    .max_requests = REQUEST_TABLE_DEFAULT_MAX,
+    .request_max_age = REQUEST_TABLE_DEFAULT_AGE_SEC,
     .duration = 0,
     .output_file = NULL,
 };
@@ -118,6 +113,10 @@ static const struct argp_option opts[] = {
     {"all", 'a', NULL, 0, "Trace all processes, not just MinIO"},
     {"no-branches", 'n', NULL, 0, "Hide branch information"},
     {"no-correlation", 'x', NULL, 0, "Disable request correlation"},
+    {"max-requests", 'R', "N", 0,
+     "Requests to keep before evicting the oldest (default: 65536)"},
+    {"request-age", 'L', "SECONDS", 0,
+     "Expire requests idle this long, 0 to disable (default: 60)"},
     {"duration", 'd', "DURATION", 0, "Trace for specified duration (seconds)"},
     {"output", 'o', "FILE", 0, "Output to file instead of stdout"},
     {},
@@ -137,6 +136,20 @@ static error_t parse_arg(int key, char *arg, struct argp_state *state) {
   case 'x':
     env.correlation_mode = false;
     break;
+  case 'R':
+    env.max_requests = atoi(arg);
+    if (env.max_requests <= 0) {
+      fprintf(stderr, "Invalid max requests: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'L':
+    env.request_max_age = atoi(arg);
+    if (env.request_max_age < 0) {
+      fprintf(stderr, "Invalid request age: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
   case 'd':
     env.duration = atoi(arg);
     break;
@@ -158,67 +171,31 @@ static const struct argp argp = {
 static volatile bool exiting = false;
 static FILE *output_fp = NULL;
 
-static void sig_handler(int sig) { exiting = true; }
+// output_fp is a view of out_stream, flushed about once a second, over the
+// file or stdout kept in raw_output_fp
+static struct stream_writer *out_stream = NULL;
+static FILE *raw_output_fp = NULL;
 
-const char *get_event_name(__u32 event_type) {
-  switch (event_type) {
-  // MinIO Application layer
-  case 110:
-    return "MINIO_OBJECT_PUT";
-  case 111:
-    return "MINIO_OBJECT_GET";
-  case 112:
-    return "MINIO_ERASURE_ENCODE";
-  case 113:
-    return "MINIO_ERASURE_DECODE";
-  case 114:
-    return "MINIO_XL_META";
-  case 115:
-    return "MINIO_REPLICATION";
-
-  // OS layer
-  case 303:
-    return "OS_VFS_READ";
-  case 304:
-    return "OS_VFS_WRITE";
-
-  // Filesystem layer
-  case 401:
-    return "FS_SYNC";
-
-  // Device layer
-  case 501:
-    return "DEV_BIO_SUBMIT";
-  case 502:
-    return "DEV_BIO_COMPLETE";
+static void sig_handler(int sig) { exiting = true; }
 
-  default:
-    return "UNKNOWN";
-  }
-}
+static struct request_flow *find_or_create_request(__u64 request_id,
+                                                   __u64 timestamp) {
+  struct request_flow *req;
+  int created;
 
-static struct request_flow *find_or_create_request(__u64 request_id) {
-  // First, search existing requests
-  for (int i = 0; i < request_count; i++) {
-    if (requests[i].request_id == request_id) {
-      return &requests[i];
-    }
-  }
+  if (!requests)
+    return NULL;
 
-  // Create new request if not found
-  if (request_count < MAX_REQUESTS) {
-    struct request_flow *req = &requests[request_count++];
-    memset(req, 0, sizeof(*req));
+  req = request_table_get_or_create(requests, request_id, timestamp, &created);
+  if (req && created) {
     req->request_id = request_id;
     req->start_time = 0;
-    return req;
   }
-
-  return NULL;
+  return req;
 }
 
 static void update_request_flow(const struct multilayer_io_event *e) {
-  struct request_flow *req = find_or_create_request(e->request_id);
+  struct request_flow *req = find_or_create_request(e->request_id, e->timestamp);
   if (!req)
     return;
 
@@ -278,9 +255,12 @@ static void update_request_flow(const struct multilayer_io_event *e) {
     break;
 
   case LAYER_DEVICE:
-    req->device_bytes += e->size;
-    if (e->event_type == 501)
+    // Completions carry the same request as their submission, so only
+    // count the bytes once
+    if (e->event_type == 501) {
+      req->device_bytes += e->size;
       req->bio_submits++;
+    }
     break;
   }
 }
@@ -346,13 +326,13 @@ static int handle_event(void *ctx, void *data, size_t data_sz) {
 
   // For completed device I/O, check if request is complete
   if (e->event_type == 502 && e->layer == LAYER_DEVICE) { // DEV_BIO_COMPLETE
-    struct request_flow *req = find_or_create_request(e->request_id);
+    struct request_flow *req =
+        find_or_create_request(e->request_id, e->timestamp);
     if (req) {
       req->completed_branches++;
     }
   }
 
-  fflush(output_fp);
   return 0;
 }
 
@@ -387,29 +367,43 @@ static void print_header() {
   }
 }
 
+static int compare_start_time(const void *a, const void *b) {
+  const struct request_flow *ra = *(const struct request_flow *const *)a;
+  const struct request_flow *rb = *(const struct request_flow *const *)b;
+
+  if (ra->start_time < rb->start_time)
+    return -1;
+  return ra->start_time > rb->start_time;
+}
+
 static void print_request_summary() {
+  size_t request_count = request_table_count(requests);
+  struct request_table_stats rt_stats;
+  struct request_flow **sorted;
+
   if (!env.correlation_mode || request_count == 0) {
     return;
   }
 
+  sorted = calloc(request_count, sizeof(*sorted));
+  if (!sorted)
+    return;
+  request_count =
+      request_table_collect(requests, (void **)sorted, request_count);
+  request_table_get_stats(requests, &rt_stats);
+
   fprintf(output_fp, "\n======================================================="
                      "=================\n");
   fprintf(output_fp, "                        REQUEST FLOW ANALYSIS\n");
   fprintf(output_fp, "========================================================="
                      "===============\n\n");
 
-  fprintf(output_fp, "Total requests tracked: %d\n\n", request_count);
+  fprintf(output_fp, "Total requests tracked: %zu\n", request_count);
+  fprintf(output_fp,
+          "Evicted requests:       %llu LRU, %llu aged out (peak %zu)\n\n",
+          rt_stats.lru_evictions, rt_stats.age_evictions, rt_stats.peak);
 
-  // Sort requests by start time (simple bubble sort for small dataset)
-  for (int i = 0; i < request_count - 1; i++) {
-    for (int j = 0; j < request_count - i - 1; j++) {
-      if (requests[j].start_time > requests[j + 1].start_time) {
-        struct request_flow temp = requests[j];
-        requests[j] = requests[j + 1];
-        requests[j + 1] = temp;
-      }
-    }
-  }
+  qsort(sorted, request_count, sizeof(*sorted), compare_start_time);
 
   // Print detailed request flow
   fprintf(output_fp, "REQUEST FLOWS (Chronological):\n");
@@ -418,9 +412,9 @@ static void print_request_summary() {
   fprintf(output_fp, "---------------------------------------------------------"
                      "---------------\n");
 
-  for (int i = 0; i < request_count && i < 50;
+  for (size_t i = 0; i < request_count && i < 50;
        i++) { // Limit to 50 for readability
-    struct request_flow *req = &requests[i];
+    struct request_flow *req = sorted[i];
 
     double amplification = 0;
     if (req->app_bytes > 0) {
@@ -472,19 +466,20 @@ static void print_request_summary() {
   __u32 total_puts = 0;
   __u32 total_branched_requests = 0;
 
-  for (int i = 0; i < request_count; i++) {
-    total_app_bytes += requests[i].app_bytes;
-    total_os_bytes += requests[i].os_bytes;
-    total_device_bytes += requests[i].device_bytes;
+  for (size_t i = 0; i < request_count; i++) {
+    total_app_bytes += sorted[i]->app_bytes;
+    total_os_bytes += sorted[i]->os_bytes;
+    total_device_bytes += sorted[i]->device_bytes;
 
-    if (requests[i].op_type == 0)
+    if (sorted[i]->op_type == 0)
       total_gets++;
     else
       total_puts++;
 
-    if (requests[i].total_branches > 1)
+    if (sorted[i]->total_branches > 1)
       total_branched_requests++;
   }
+  free(sorted);
 
   fprintf(output_fp, "Operation Summary:\n");
   fprintf(output_fp, "  Total GET operations:  %u\n", total_gets);
@@ -541,6 +536,24 @@ int main(int argc, char **argv) {
     output_fp = stdout;
   }
 
+  out_stream = stream_writer_open(fileno(output_fp), false);
+  if (!out_stream) {
+    fprintf(stderr, "Failed to allocate output buffer\n");
+    return 1;
+  }
+  raw_output_fp = output_fp;
+  output_fp = stream_writer_file(out_stream);
+
+  if (env.correlation_mode) {
+    requests = request_table_new(sizeof(struct request_flow),
+                                 env.max_requests,
+                                 env.request_max_age * 1000000000ULL);
+    if (!requests) {
+      fprintf(stderr, "Failed to allocate request table\n");
+      return 1;
+    }
+  }
+
   if (bump_memlock_rlimit()) {
     fprintf(stderr, "Failed to increase RLIMIT_MEMLOCK limit!\n");
     return 1;
@@ -575,6 +588,7 @@ int main(int argc, char **argv) {
   print_header();
 
   time_t start_time = time(NULL);
+  time_t last_flush = start_time;
   while (!exiting) {
     err = ring_buffer__poll(rb, 100);
     if (err == -EINTR) {
@@ -586,8 +600,14 @@ int main(int argc, char **argv) {
       break;
     }
 
+    time_t now = time(NULL);
+    if (now != last_flush) {
+      last_flush = now;
+      stream_writer_flush(out_stream);
+    }
+
     // Check duration limit
-    if (env.duration > 0 && (time(NULL) - start_time) >= env.duration) {
+    if (env.duration > 0 && (now - start_time) >= env.duration) {
       break;
     }
   }
@@ -600,6 +620,14 @@ cleanup:
     ring_buffer__free(rb);
   if (skel)
     minio_tracer_bpf__destroy(skel);
+  request_table_free(requests);
+
+  if (out_stream) {
+    if (stream_writer_close(out_stream) != 0)
+      fprintf(stderr, "Failed to write output: %s\n",
+              env.output_file ? env.output_file : "stdout");
+    output_fp = raw_output_fp;
+  }
 
   if (output_fp && output_fp != stdout) {
     fflush(output_fp);
@@ -0,0 +1,621 @@
+// Cluster-wide I/O amplification from multilayer_io_tracer agents
+// File: mlio_collector.c
+//
+// Accepts the per-interval frames that tracers send in agent mode (-U),
+// sums them per time window across nodes and prints one report per
+// window: the cluster's end-to-end amplification, how evenly the nodes
+// share the device traffic, and the objects that moved the most bytes
+// cluster-wide. An object is the same bucket/object name on every node,
+// so one PUT's data and parity shards add up to one line.
+//
+// Memory is fixed: a ring of WINDOW_SLOTS windows, each with room for
+// MAX_WINDOW_OBJECTS objects. A window is reported once frames for two
+// windows later arrive, or that much wall-clock time has passed, so nodes
+// may lag by up to one window.
+
+#define _GNU_SOURCE // accept4
+#include <argp.h>
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cluster_agent.h"
+
+#define MAX_NODES 64 // Also the width of the per-object node mask
+#define MAX_CLIENTS 64
+#define WINDOW_SLOTS 4
+#define MAX_WINDOW_OBJECTS 16384 // Power of two
+#define OBJECT_NAME_LEN 128
+#define POLL_INTERVAL_MS 500
+
+const char *layer_names[] = {"UNKNOWN", "APPLICATION", "STORAGE_SVC",
+                             "OS",      "FILESYSTEM",  "DEVICE"};
+
+static struct env {
+  bool verbose;
+  const char *listen_addr;
+  const char *output_file;
+  int window;
+  int top;
+} env = {
+    .listen_addr = ":" CLUSTER_DEFAULT_PORT,
+    .window = 10,
+    .top = 10,
+};
+
+static const struct argp_option opts[] = {
+    {"verbose", 'v', NULL, 0, "Verbose debug output"},
+    {"listen", 'l', "[ADDR]:PORT", 0,
+     "Accept agents on ADDR:PORT (default: :9436)"},
+    {"window", 'w', "SECONDS", 0,
+     "Sum the agents' intervals over windows this long (default: 10)"},
+    {"top", 'k', "N", 0, "Objects to list per window (default: 10)"},
+    {"output", 'o', "FILE", 0, "Output to file instead of stdout"},
+    {},
+};
+
+static error_t parse_arg(int key, char *arg, struct argp_state *state) {
+  switch (key) {
+  case 'v':
+    env.verbose = true;
+    break;
+  case 'l':
+    env.listen_addr = arg;
+    break;
+  case 'w':
+    env.window = atoi(arg);
+    if (env.window <= 0) {
+      fprintf(stderr, "Invalid window: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'k':
+    env.top = atoi(arg);
+    if (env.top < 0) {
+      fprintf(stderr, "Invalid object count: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'o':
+    env.output_file = arg;
+    break;
+  default:
+    return ARGP_ERR_UNKNOWN;
+  }
+  return 0;
+}
+
+static const struct argp argp = {
+    .options = opts,
+    .parser = parse_arg,
+    .doc = "Collects multilayer_io_tracer agent aggregates (-U) and reports "
+           "cluster-wide amplification and per-node skew.",
+};
+
+static volatile bool exiting = false;
+static FILE *output_fp = NULL;
+
+static void sig_handler(int sig) { exiting = true; }
+
+// ============================================================================
+// WINDOWS
+// ============================================================================
+
+struct node_totals {
+  struct cluster_layer layers[CLUSTER_LAYERS];
+  __u64 encoded_bytes;
+  __u64 parity_bytes;
+  __u64 frames;
+};
+
+struct window_object {
+  __u64 key; // 0 = free slot
+  __u64 app_bytes;
+  __u64 vfs_bytes;
+  __u64 device_bytes;
+  __u64 node_mask;
+  char name[OBJECT_NAME_LEN];
+};
+
+struct window {
+  __u64 id; // start / window length, 0 = unused
+  bool reported;
+  struct node_totals nodes[MAX_NODES];
+  struct window_object *objects;
+  size_t n_objects;
+  __u64 objects_dropped; // Did not fit in the table
+};
+
+static char node_names[MAX_NODES][CLUSTER_NODE_LEN];
+static int num_nodes = 0;
+static __u64 frames_rejected = 0;
+static __u64 frames_late = 0; // Only in the run total
+
+static struct window windows[WINDOW_SLOTS];
+static struct node_totals run_totals[MAX_NODES];
+
+static int node_index(const char *name) {
+  for (int i = 0; i < num_nodes; i++) {
+    if (strncmp(node_names[i], name, CLUSTER_NODE_LEN) == 0)
+      return i;
+  }
+  if (num_nodes == MAX_NODES)
+    return -1;
+  memcpy(node_names[num_nodes], name, CLUSTER_NODE_LEN);
+  node_names[num_nodes][CLUSTER_NODE_LEN - 1] = '\0';
+  if (env.verbose)
+    fprintf(stderr, "New node %s\n", node_names[num_nodes]);
+  return num_nodes++;
+}
+
+static void add_totals(struct node_totals *t,
+                       const struct cluster_frame_hdr *h) {
+  for (int l = 1; l < CLUSTER_LAYERS; l++) {
+    t->layers[l].events += h->layers[l].events;
+    t->layers[l].bytes += h->layers[l].bytes;
+    t->layers[l].aligned_bytes += h->layers[l].aligned_bytes;
+  }
+  t->encoded_bytes += h->encoded_bytes;
+  t->parity_bytes += h->parity_bytes;
+  t->frames++;
+}
+
+// Open addressing on the key, which is already a hash
+static struct window_object *window_object(struct window *w, __u64 key) {
+  size_t mask = MAX_WINDOW_OBJECTS - 1;
+
+  if (key == 0)
+    key = 1;
+  for (size_t i = 0, slot = key & mask; i < MAX_WINDOW_OBJECTS;
+       i++, slot = (slot + 1) & mask) {
+    struct window_object *o = &w->objects[slot];
+    if (o->key == key)
+      return o;
+    if (o->key == 0) {
+      // Keep a quarter free so probes stay short
+      if (w->n_objects >= MAX_WINDOW_OBJECTS * 3 / 4)
+        return NULL;
+      o->key = key;
+      w->n_objects++;
+      return o;
+    }
+  }
+  return NULL;
+}
+
+static void reset_window(struct window *w, __u64 id) {
+  struct window_object *objects = w->objects;
+
+  memset(objects, 0, MAX_WINDOW_OBJECTS * sizeof(*objects));
+  memset(w, 0, sizeof(*w));
+  w->objects = objects;
+  w->id = id;
+}
+
+// ============================================================================
+// REPORTING
+// ============================================================================
+
+static double ratio(__u64 num, __u64 den) {
+  return den > 0 ? (double)num / den : 0;
+}
+
+// What the cluster was asked to store: MinIO's erasure encode input where
+// the agents probe it (-E), else the bytes written by the applications
+static __u64 logical_bytes(const struct node_totals *t) {
+  return t->encoded_bytes ? t->encoded_bytes
+                          : t->layers[1].bytes; // LAYER_APPLICATION
+}
+
+static void print_cluster(const struct node_totals *nodes, const char *title) {
+  struct node_totals sum = {0};
+  int active = 0;
+  double mean = 0, var = 0, max = 0;
+
+  for (int i = 0; i < num_nodes; i++) {
+    if (nodes[i].frames == 0)
+      continue;
+    for (int l = 1; l < CLUSTER_LAYERS; l++) {
+      sum.layers[l].bytes += nodes[i].layers[l].bytes;
+      sum.layers[l].events += nodes[i].layers[l].events;
+    }
+    sum.encoded_bytes += nodes[i].encoded_bytes;
+    sum.parity_bytes += nodes[i].parity_bytes;
+    active++;
+  }
+  if (active == 0)
+    return;
+
+  __u64 logical = logical_bytes(&sum);
+  __u64 device = sum.layers[5].bytes; // LAYER_DEVICE
+
+  fprintf(output_fp, "\n=== %s: %d node(s) ===\n", title, active);
+  for (int l = 1; l < CLUSTER_LAYERS; l++)
+    fprintf(output_fp, "%-15s %12llu events %14llu bytes\n", layer_names[l],
+            sum.layers[l].events, sum.layers[l].bytes);
+  if (sum.encoded_bytes)
+    fprintf(output_fp, "Erasure coded:  %14llu bytes + %llu parity\n",
+            sum.encoded_bytes, sum.parity_bytes);
+  if (logical > 0)
+    fprintf(output_fp,
+            "*** CLUSTER AMPLIFICATION: %.2fx *** (%llu device bytes for "
+            "%llu %s bytes)\n",
+            ratio(device, logical), device, logical,
+            sum.encoded_bytes ? "object" : "application");
+
+  fprintf(output_fp, "%-24s %14s %14s %8s %7s\n", "NODE", "APP", "DEVICE",
+          "AMP", "SHARE%");
+  for (int i = 0; i < num_nodes; i++) {
+    const struct node_totals *t = &nodes[i];
+    if (t->frames == 0)
+      continue;
+    __u64 dev = t->layers[5].bytes;
+    fprintf(output_fp, "%-24.24s %14llu %14llu %7.2fx %7.1f\n",
+            node_names[i], t->layers[1].bytes, dev,
+            ratio(dev, t->layers[1].bytes), 100.0 * ratio(dev, device));
+    mean += dev;
+    if (dev > max)
+      max = dev;
+  }
+
+  // Skew of the device traffic: a balanced erasure set is near 1.00x / 0
+  mean /= active;
+  for (int i = 0; i < num_nodes; i++) {
+    if (nodes[i].frames == 0)
+      continue;
+    double d = nodes[i].layers[5].bytes - mean;
+    var += d * d;
+  }
+  if (mean > 0)
+    fprintf(output_fp, "Node skew: max/mean %.2fx, coefficient of variation "
+                       "%.2f\n",
+            max / mean, sqrt(var / active) / mean);
+}
+
+static int cmp_object_device_bytes(const void *a, const void *b) {
+  const struct window_object *x = *(struct window_object *const *)a;
+  const struct window_object *y = *(struct window_object *const *)b;
+
+  return (x->device_bytes < y->device_bytes) -
+         (x->device_bytes > y->device_bytes);
+}
+
+static void print_top_objects(struct window *w) {
+  struct window_object **top;
+  size_t n = 0;
+
+  if (env.top == 0 || w->n_objects == 0)
+    return;
+  top = malloc(w->n_objects * sizeof(*top));
+  if (!top)
+    return;
+  for (size_t i = 0; i < MAX_WINDOW_OBJECTS; i++) {
+    if (w->objects[i].key)
+      top[n++] = &w->objects[i];
+  }
+  qsort(top, n, sizeof(*top), cmp_object_device_bytes);
+
+  fprintf(output_fp, "Top objects (%zu seen%s):\n", w->n_objects,
+          w->objects_dropped ? ", table full" : "");
+  fprintf(output_fp, "%-48s %5s %14s %14s %8s\n", "OBJECT", "NODES", "APP",
+          "DEVICE", "AMP");
+  for (size_t i = 0; i < n && i < (size_t)env.top; i++) {
+    const struct window_object *o = top[i];
+    size_t len = strlen(o->name);
+    fprintf(output_fp, "%s%-*s %5d %14llu %14llu %7.2fx\n",
+            len > 48 ? "..." : "", len > 48 ? 45 : 48,
+            len > 48 ? o->name + len - 45 : o->name,
+            __builtin_popcountll(o->node_mask), o->app_bytes,
+            o->device_bytes, ratio(o->device_bytes, o->app_bytes));
+  }
+  free(top);
+}
+
+static void report_window(struct window *w) {
+  char title[96], when[32];
+  time_t start = w->id * env.window;
+
+  if (w->id == 0 || w->reported)
+    return;
+  w->reported = true;
+
+  strftime(when, sizeof(when), "%F %T", localtime(&start));
+  snprintf(title, sizeof(title), "Window %s +%ds", when, env.window);
+  print_cluster(w->nodes, title);
+  print_top_objects(w);
+  fflush(output_fp);
+}
+
+// Reports every window at least two windows older than newest
+static void report_closed(__u64 newest) {
+  for (int i = 0; i < WINDOW_SLOTS; i++) {
+    if (windows[i].id && windows[i].id + 2 <= newest)
+      report_window(&windows[i]);
+  }
+}
+
+static void report_all(void) {
+  // Oldest first
+  for (;;) {
+    struct window *oldest = NULL;
+    for (int i = 0; i < WINDOW_SLOTS; i++) {
+      if (windows[i].id && !windows[i].reported &&
+          (!oldest || windows[i].id < oldest->id))
+        oldest = &windows[i];
+    }
+    if (!oldest)
+      break;
+    report_window(oldest);
+  }
+}
+
+// ============================================================================
+// FRAMES
+// ============================================================================
+
+static bool valid_header(const struct cluster_frame_hdr *h) {
+  return h->magic == CLUSTER_MAGIC && h->version == CLUSTER_VERSION &&
+         h->hdr_size == sizeof(*h) && h->frame_size >= sizeof(*h) &&
+         h->frame_size <= CLUSTER_FRAME_MAX;
+}
+
+static void fold_frame(const char *buf) {
+  const struct cluster_frame_hdr *h = (const void *)buf;
+  int node = node_index(h->node);
+  __u64 id = h->start_ns / 1000000000ULL / env.window;
+
+  if (node < 0 || id == 0) {
+    frames_rejected++;
+    return;
+  }
+
+  add_totals(&run_totals[node], h);
+
+  struct window *w = &windows[id % WINDOW_SLOTS];
+  if (w->id != id) {
+    // Too late for a window already reused, or reported
+    if (w->id > id) {
+      frames_late++;
+      return;
+    }
+    report_window(w);
+    reset_window(w, id);
+  } else if (w->reported) {
+    frames_late++;
+    return;
+  }
+
+  add_totals(&w->nodes[node], h);
+
+  size_t off = sizeof(*h);
+  for (__u32 i = 0; i < h->n_objects; i++) {
+    const struct cluster_object *o = (const void *)(buf + off);
+    if (off + sizeof(*o) > h->frame_size ||
+        off + cluster_object_size(o->name_len) > h->frame_size)
+      break;
+    off += cluster_object_size(o->name_len);
+
+    struct window_object *wo = window_object(w, o->key);
+    if (!wo) {
+      w->objects_dropped++;
+      continue;
+    }
+    if (wo->name[0] == '\0') {
+      // Keep the tail, which names the object
+      const char *name = (const char *)(o + 1);
+      size_t len = o->name_len;
+      if (len >= OBJECT_NAME_LEN) {
+        name += len - (OBJECT_NAME_LEN - 1);
+        len = OBJECT_NAME_LEN - 1;
+      }
+      memcpy(wo->name, name, len);
+      wo->name[len] = '\0';
+    }
+    wo->app_bytes += o->app_bytes;
+    wo->vfs_bytes += o->vfs_bytes;
+    wo->device_bytes += o->device_bytes;
+    wo->node_mask |= 1ULL << node;
+  }
+
+  report_closed(id);
+}
+
+// ============================================================================
+// CONNECTIONS
+// ============================================================================
+
+struct client {
+  int fd;
+  char *buf;
+  size_t cap;
+  size_t used;
+};
+
+static struct client clients[MAX_CLIENTS];
+static int num_clients = 0;
+
+static int open_listener(const char *addr) {
+  struct addrinfo hints = {
+      .ai_family = AF_UNSPEC,
+      .ai_socktype = SOCK_STREAM,
+      .ai_flags = AI_PASSIVE,
+  };
+  struct addrinfo *res, *ai;
+  char buf[256], *host = buf, *port;
+  int fd = -1, one = 1;
+
+  snprintf(buf, sizeof(buf), "%s", addr);
+  if (buf[0] == '[') {
+    char *end = strchr(buf, ']');
+    if (!end || (end[1] != ':' && end[1] != '\0'))
+      return -1;
+    *end = '\0';
+    host = buf + 1;
+    port = end[1] ? end + 2 : CLUSTER_DEFAULT_PORT;
+  } else if ((port = strrchr(buf, ':')) != NULL) {
+    *port++ = '\0';
+  } else {
+    port = buf;
+    host = buf + strlen(buf); // Empty
+  }
+  if (*port == '\0')
+    port = CLUSTER_DEFAULT_PORT;
+
+  if (getaddrinfo(*host ? host : NULL, port, &hints, &res) != 0)
+    return -1;
+  for (ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+        listen(fd, MAX_CLIENTS) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+static void drop_client(int i) {
+  close(clients[i].fd);
+  free(clients[i].buf);
+  clients[i] = clients[--num_clients];
+}
+
+// Reads what is available and folds every complete frame. Returns false
+// if the client should be dropped.
+static bool read_client(struct client *c) {
+  for (;;) {
+    size_t want = sizeof(struct cluster_frame_hdr);
+    if (c->used >= want) {
+      const struct cluster_frame_hdr *h = (const void *)c->buf;
+      if (!valid_header(h)) {
+        frames_rejected++;
+        return false;
+      }
+      want = h->frame_size;
+    }
+    if (want > c->cap) {
+      char *buf = realloc(c->buf, want);
+      if (!buf)
+        return false;
+      c->buf = buf;
+      c->cap = want;
+    }
+
+    ssize_t n = recv(c->fd, c->buf + c->used, want - c->used, MSG_DONTWAIT);
+    if (n == 0)
+      return false;
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    c->used += n;
+
+    if (c->used >= sizeof(struct cluster_frame_hdr) &&
+        c->used == ((const struct cluster_frame_hdr *)c->buf)->frame_size) {
+      fold_frame(c->buf);
+      c->used = 0;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  struct pollfd fds[MAX_CLIENTS + 1];
+  int listen_fd, err = 0;
+
+  err = argp_parse(&argp, argc, argv, 0, NULL, NULL);
+  if (err)
+    return err;
+
+  output_fp = stdout;
+  if (env.output_file) {
+    output_fp = fopen(env.output_file, "w");
+    if (!output_fp) {
+      fprintf(stderr, "Failed to open %s: %s\n", env.output_file,
+              strerror(errno));
+      return 1;
+    }
+  }
+
+  for (int i = 0; i < WINDOW_SLOTS; i++) {
+    windows[i].objects =
+        calloc(MAX_WINDOW_OBJECTS, sizeof(struct window_object));
+    if (!windows[i].objects) {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+  }
+
+  listen_fd = open_listener(env.listen_addr);
+  if (listen_fd < 0) {
+    fprintf(stderr, "Failed to listen on %s: %s\n", env.listen_addr,
+            strerror(errno));
+    return 1;
+  }
+
+  signal(SIGINT, sig_handler);
+  signal(SIGTERM, sig_handler);
+  if (env.verbose)
+    fprintf(stderr, "Collecting on %s, %ds windows\n", env.listen_addr,
+            env.window);
+
+  while (!exiting) {
+    fds[0] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+    for (int i = 0; i < num_clients; i++)
+      fds[i + 1] = (struct pollfd){.fd = clients[i].fd, .events = POLLIN};
+
+    int n = poll(fds, num_clients + 1, POLL_INTERVAL_MS);
+    if (n < 0 && errno != EINTR) {
+      err = errno;
+      break;
+    }
+
+    // Windows close on the wall clock too, should all agents stop
+    report_closed(time(NULL) / env.window);
+    if (n <= 0)
+      continue;
+
+    for (int i = num_clients - 1; i >= 0; i--) {
+      if ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+          !read_client(&clients[i]))
+        drop_client(i);
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+      if (fd >= 0 && num_clients == MAX_CLIENTS) {
+        close(fd);
+      } else if (fd >= 0) {
+        clients[num_clients++] = (struct client){.fd = fd};
+      }
+    }
+  }
+
+  report_all();
+  print_cluster(run_totals, "Run total");
+  if (frames_late)
+    fprintf(output_fp, "Frames too late for their window: %llu\n",
+            frames_late);
+  if (frames_rejected)
+    fprintf(output_fp, "Frames rejected: %llu\n", frames_rejected);
+
+  while (num_clients > 0)
+    drop_client(num_clients - 1);
+  close(listen_fd);
+  for (int i = 0; i < WINDOW_SLOTS; i++)
+    free(windows[i].objects);
+  if (output_fp != stdout)
+    fclose(output_fp);
+  return err;
+}
@@ -21,9 +21,17 @@
 // Event types per layer
 #define EVENT_APP_READ 101
 #define EVENT_APP_WRITE 102
+#define EVENT_APP_COPY 106       // copy_file_range, sendfile
+#define EVENT_APP_MMAP_READ 107  // Page fault on a file mapping
 #define EVENT_OS_VFS_READ 303
 #define EVENT_OS_VFS_WRITE 304
+#define EVENT_OS_PAGE_CACHE_HIT 305
+#define EVENT_OS_PAGE_CACHE_MISS 306
 #define EVENT_FS_SYNC 401
+#define EVENT_FS_METADATA_UPDATE 402 // Journal handle / log ticket
+#define EVENT_FS_EXTENT_ALLOC 405    // Delayed allocation at writeback
+#define EVENT_FS_WRITEBACK 407
+#define EVENT_FS_JOURNAL_COMMIT 408
 #define EVENT_DEV_BIO_SUBMIT 501
 #define EVENT_DEV_BIO_COMPLETE 502
 
@@ -35,6 +43,7 @@
 #define EVENT_MINIO_BITROT_CHECK 205
 #define EVENT_MINIO_MULTIPART 206
 #define EVENT_MINIO_XL_META 207
+#define EVENT_MINIO_ERASURE_READ 208
 
 // Storage system types
 #define SYSTEM_TYPE_UNKNOWN 0
@@ -51,46 +60,104 @@
 #define MINIO_TRACE_PID 2
 #define MINIO_TRACE_ALL 3
 
-struct multilayer_io_event {
+// Event flags carried in io_event_core.flags
+#define EVENT_FLAG_METADATA (1 << 0)
+#define EVENT_FLAG_JOURNAL (1 << 1)
+#define EVENT_FLAG_CACHE_HIT (1 << 2)
+#define EVENT_FLAG_MINIO (1 << 3)
+#define EVENT_FLAG_XL_META (1 << 4)
+#define EVENT_FLAG_PARITY (1 << 5)
+#define EVENT_FLAG_SAMPLED (1 << 6) // Streamed under a sampling policy
+#define EVENT_FLAG_INHERITED (1 << 7) // request_id taken from the inode
+
+// Optional payload sections. When set, they follow the core in this order:
+// io_event_detail, bucket name (MAX_BUCKET_NAME_LEN), NUL-terminated filename.
+#define EVENT_EXT_DETAIL (1 << 8)
+#define EVENT_EXT_BUCKET (1 << 9)
+#define EVENT_EXT_FILENAME (1 << 10)
+
+// Fixed part of every ring buffer record (96 bytes). Fields that only a few
+// probes fill in live in the optional payload sections above.
+struct io_event_core {
   u64 timestamp;
-  u32 pid;
-  u32 tid;
-  u8 layer;
-  u32 event_type;
-  u32 system_type;
   u64 size;
+  u64 aligned_size;
   u64 offset;
   u64 latency_ns;
-  u32 dev_major;
-  u32 dev_minor;
-  s32 retval;
   u64 inode;
   u64 request_id;
+  u32 pid;
+  u32 tid;
+  u32 event_type;
+  u32 dev; // major << 20 | minor
+  s32 retval;
+  u16 flags;
+  u8 layer;
+  u8 system_type;
   char comm[MAX_COMM_LEN];
-  char filename[MAX_FILENAME_LEN];
-  u64 aligned_size;
+};
+
+struct io_event_detail {
   u32 replication_count;
   u32 block_count;
-  u8 is_metadata;
-  u8 is_journal;
-  u8 cache_hit;
-
-  // MinIO-specific fields
   u32 erasure_set_index;
   u32 erasure_block_index;
-  u8 is_parity_block;
-  u8 is_xl_meta;
   u32 object_part_number;
-  char bucket_name[MAX_BUCKET_NAME_LEN];
-  u8 is_minio;
+  u32 _pad;
+};
+
+// Record layouts for the probes that emit a payload
+struct detail_event {
+  struct io_event_core core;
+  struct io_event_detail detail;
 };
 
+struct filename_event {
+  struct io_event_core core;
+  char filename[MAX_FILENAME_LEN];
+};
+
+// Early task filter, checked before anything else in every task-context
+// probe. filter_mode is set before load, so with no filter configured the
+// verifier drops the check entirely.
+#define FILTER_TGID (1 << 0)
+#define FILTER_CGROUP (1 << 1)
+#define MAX_TARGET_TGIDS 4096
+#define MAX_TARGET_CGROUPS 256
+
+const volatile u8 filter_mode = 0;
+
 // Maps
 struct {
   __uint(type, BPF_MAP_TYPE_RINGBUF);
   __uint(max_entries, 1024 * 1024);
 } events SEC(".maps");
 
+// Optional sharded event stream. Userspace creates one ring per shard,
+// stores it in event_shards and maps every CPU to its shard in cpu_shard.
+#define MAX_RING_SHARDS 64
+#define MAX_CPUS 1024
+#define RING_SHARD_SIZE (512 * 1024)
+
+struct ringbuf_shard {
+  __uint(type, BPF_MAP_TYPE_RINGBUF);
+  __uint(max_entries, RING_SHARD_SIZE);
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+  __uint(max_entries, MAX_RING_SHARDS);
+  __type(key, u32);
+  __array(values, struct ringbuf_shard);
+} event_shards SEC(".maps");
+
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(max_entries, MAX_CPUS);
+  __type(key, u32);
+  __type(value, u32);
+} cpu_shard SEC(".maps");
+
 struct {
   __uint(type, BPF_MAP_TYPE_HASH);
   __uint(max_entries, MAX_ENTRIES);
@@ -98,14 +165,34 @@ struct {
   __type(value, u64);
 } io_start_times SEC(".maps");
 
-// MinIO PID tracking map
+// MinIO PID tracking map, keyed by tgid. Seeded by userspace and kept up
+// to date by the sched_process_* programs below.
+#define MAX_MINIO_PIDS 4096
+
+// Add processes named "minio" to minio_pids when they exec
+const volatile bool minio_discovery = false;
+
 struct {
   __uint(type, BPF_MAP_TYPE_HASH);
-  __uint(max_entries, 128);
+  __uint(max_entries, MAX_MINIO_PIDS);
   __type(key, u32);
   __type(value, u8);
 } minio_pids SEC(".maps");
 
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_TARGET_TGIDS);
+  __type(key, u32);
+  __type(value, u8);
+} target_tgids SEC(".maps");
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_TARGET_CGROUPS);
+  __type(key, u64);
+  __type(value, u8);
+} target_cgroups SEC(".maps");
+
 // MinIO configuration map
 struct minio_config {
   u8 trace_mode;
@@ -138,18 +225,398 @@ struct {
   __type(value, struct request_context_small);
 } request_tracking SEC(".maps");
 
-// Per-CPU array for temporary large structures
-struct temp_storage {
-  char filename[MAX_FILENAME_LEN];
-  char object_name[MAX_FILENAME_LEN];
+// Per-CPU scratch record for events whose size is only known at runtime
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, 1);
+  __type(key, u32);
+  __type(value, struct filename_event);
+} temp_storage_map SEC(".maps");
+
+// Tracer-wide configuration, independent of the MinIO filtering options.
+// Userspace may rewrite it at any time, e.g. to adapt the sampling rate.
+#define SAMPLE_LAYERS 6
+
+struct tracer_config {
+  u8 aggregate;   // Count every event in layer_aggregates
+  u8 skip_events; // Do not stream events through the ring buffer
+  u8 sharded;     // Stream through event_shards instead of events
+  u8 per_process; // Also count events per process in process_aggregates
+  u8 paused;      // Left attached between runs (-F), drop everything
+  u32 budget_per_cpu;               // Streamed events/sec per CPU, 0 = all
+  u32 sample_rate[SAMPLE_LAYERS];   // Stream 1 in N per layer, 0/1 = all
+  u32 wakeup_bytes; // Wake the consumer only past this ring fill, 0 = always
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(max_entries, 1);
+  __type(key, u32);
+  __type(value, struct tracer_config);
+} tracer_config_map SEC(".maps");
+
+// In-kernel equivalent of the userspace layer_stats, indexed by
+// (layer, event slot, system type). See agg_event_slot() for the slots.
+#define AGG_LAYERS 6
+#define AGG_EVENT_SLOTS 32
+#define AGG_SYSTEM_SLOTS 8
+#define AGG_ENTRIES (AGG_LAYERS * AGG_EVENT_SLOTS * AGG_SYSTEM_SLOTS)
+
+struct layer_agg {
+  u64 events;
+  u64 bytes;
+  u64 aligned_bytes;
+  u64 latency_ns;
+  u64 metadata_ops;
+  u64 journal_ops;
+  u64 cache_hits;
+  u64 minio_events;
+  u64 minio_bytes;
+  u64 xl_meta_ops;
+  u32 event_type;
+  u32 _pad;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, AGG_ENTRIES);
+  __type(key, u32);
+  __type(value, struct layer_agg);
+} layer_aggregates SEC(".maps");
+
+// Per-process totals for the metrics exporter, keyed by (tgid, layer).
+// LRU so short-lived processes age out instead of filling the map.
+#define MAX_TRACKED_PROCS 8192
+
+struct process_agg_key {
+  u32 tgid;
+  u32 layer;
+};
+
+struct process_agg {
+  u64 events;
+  u64 bytes;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+  __uint(max_entries, MAX_TRACKED_PROCS);
+  __type(key, struct process_agg_key);
+  __type(value, struct process_agg);
+} process_aggregates SEC(".maps");
+
+// Per-layer streaming counters, so userspace can see what sampling and a
+// full ring buffer withheld
+struct sample_counts {
+  u64 seen;
+  u64 emitted;
+  u64 ring_drops;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, SAMPLE_LAYERS);
+  __type(key, u32);
+  __type(value, struct sample_counts);
+} sample_stats SEC(".maps");
+
+// Ring reservations that failed, per event slot (see agg_event_slot()).
+// Each program emits a fixed set of event types, so this tells which probe
+// lost events.
+struct ring_drop {
+  u64 drops;
+  u32 event_type;
+  u32 _pad;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, AGG_EVENT_SLOTS);
+  __type(key, u32);
+  __type(value, struct ring_drop);
+} ring_drop_counts SEC(".maps");
+
+// Per-CPU token bucket for the events/sec budget. Tokens are scaled by
+// 1e9 so refills need no division.
+#define TOKEN_SCALE 1000000000ULL
+
+struct token_bucket {
+  u64 tokens;
+  u64 last_ns;
 };
 
 struct {
   __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
   __uint(max_entries, 1);
   __type(key, u32);
-  __type(value, struct temp_storage);
-} temp_storage_map SEC(".maps");
+  __type(value, struct token_bucket);
+} token_buckets SEC(".maps");
+
+// Latency histograms. Always maintained, independent of event streaming.
+#define LAT_SYSCALL_READ 0
+#define LAT_SYSCALL_WRITE 1
+#define LAT_VFS_READ 2
+#define LAT_VFS_WRITE 3
+#define LAT_FSYNC 4
+#define LAT_BIO 5
+#define LAT_DEVICE 6
+#define LAT_KINDS 7
+
+// Log-linear buckets: values below 4 map to themselves, then each power of
+// two is split into 4 linear sub-buckets. 160 slots cover up to ~2^40 ns.
+#define LAT_SUB_BUCKET_BITS 2
+#define LAT_SLOTS 160
+
+struct latency_hist {
+  u64 count;
+  u64 sum_ns;
+  u64 slots[LAT_SLOTS];
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, LAT_KINDS);
+  __type(key, u32);
+  __type(value, struct latency_hist);
+} latency_hists SEC(".maps");
+
+// Entry timestamps for the kretprobe side of the VFS and fsync probes
+struct lat_start_key {
+  u64 pid_tgid;
+  u32 kind;
+  u32 _pad;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_ENTRIES);
+  __type(key, struct lat_start_key);
+  __type(value, u64);
+} lat_start_times SEC(".maps");
+
+// Page cache accounting for each traced vfs_read in flight, keyed by
+// pid_tgid and only ever touched by that thread
+struct cache_acct {
+  u64 accessed;        // Folios looked up in the page cache
+  u64 miss_bytes;      // Inserted pages inside the range being read
+  u64 readahead_bytes; // Inserted for the same file, outside the range
+  u64 ino;
+  u64 first_page; // Page range of the read, end exclusive
+  u64 end_page;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_ENTRIES);
+  __type(key, u64);
+  __type(value, struct cache_acct);
+} cache_acct_map SEC(".maps");
+
+// Buffered write, readahead and writeback counters, kept in kernel only
+struct cache_stats {
+  u64 dirtied_pages;   // Dirtied by traced writes
+  u64 writeback_pages; // Written back from traced inodes
+  u64 writeback_inodes;
+  u64 readahead_pages; // Read ahead by traced reads, beyond their range
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, 1);
+  __type(key, u32);
+  __type(value, struct cache_stats);
+} cache_stats_map SEC(".maps");
+
+static __always_inline struct cache_stats *get_cache_stats(void) {
+  u32 key = 0;
+  return bpf_map_lookup_elem(&cache_stats_map, &key);
+}
+
+#define CACHE_PAGE_SIZE 4096
+
+// Block layer in-flight tracking. Sized separately from io_start_times so
+// deep device queues cannot evict syscall start times or vice versa.
+// Request ids are a per-CPU sequence number tagged with the CPU, so they
+// stay unique for the life of the tracer and are never 0
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, 1);
+  __type(key, u32);
+  __type(value, u64);
+} request_id_seq SEC(".maps");
+
+// The request a write or a bio is attributed to. Writeback kworkers and
+// io_uring workers submit bios long after, and on another thread than, the
+// write that dirtied the pages, so the dirtying request is remembered per
+// inode and found again through the bio's page mapping.
+struct request_origin {
+  u64 request_id;
+  u32 system_type;
+  u16 flags; // EVENT_FLAG_MINIO
+  u16 _pad;
+};
+
+#define MAX_TRACKED_INODES 65536
+
+struct {
+  __uint(type, BPF_MAP_TYPE_LRU_HASH);
+  __uint(max_entries, MAX_TRACKED_INODES);
+  __type(key, u64); // struct inode *
+  __type(value, struct request_origin);
+} inode_requests SEC(".maps");
+
+// Per-object amplification: the bytes each layer moved for every file,
+// summed where they happen so it needs no event stream and no userspace
+// correlation. LRU, so cold objects age out and memory stays constant.
+// Off unless userspace asks for it before load.
+#define MAX_TRACKED_OBJECTS 65536
+
+const volatile bool track_objects = false;
+
+struct object_key {
+  u64 ino;
+  u32 dev;
+  u32 _pad;
+};
+
+struct object_stats {
+  u64 app_bytes;    // Requested by read/write calls on the file
+  u64 vfs_bytes;    // The same, page aligned
+  u64 device_bytes; // Bios carrying the file's pages
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_LRU_HASH);
+  __uint(max_entries, MAX_TRACKED_OBJECTS);
+  __type(key, struct object_key);
+  __type(value, struct object_stats);
+} object_stats_map SEC(".maps");
+
+// Path of each tracked object, resolved once per inode so that events
+// and the object table only carry the inode. Userspace reads it to name
+// objects and to group them per bucket. 256-byte values, so it holds
+// fewer entries than the object table; the LRU keeps the active ones.
+#define MAX_TRACKED_PATHS 16384
+
+struct inode_path {
+  char path[MAX_FILENAME_LEN];
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_LRU_HASH);
+  __uint(max_entries, MAX_TRACKED_PATHS);
+  __type(key, struct object_key);
+  __type(value, struct inode_path);
+} inode_paths SEC(".maps");
+
+// Path an openat() was called with, until its exit knows the inode. Only
+// used where bpf_d_path() is not, see trace_openat_exit().
+const volatile bool openat_paths = false;
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_ENTRIES);
+  __type(key, u64);   // pid_tgid
+  __type(value, u64); // User pointer to the path
+} open_paths SEC(".maps");
+
+#define MAX_INFLIGHT 65536
+#define MAX_DEVICES 256
+
+struct bio_info {
+  u64 start_ns;
+  struct request_origin origin;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_INFLIGHT);
+  __type(key, u64); // struct bio *
+  __type(value, struct bio_info);
+} bio_inflight SEC(".maps");
+
+struct rq_key {
+  u64 sector;
+  u32 dev;
+  u32 _pad;
+};
+
+struct rq_info {
+  u64 issue_ns;
+  u32 bytes;
+  u16 is_write;
+  u16 requeued; // Back on the queue, no longer counted in flight
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_INFLIGHT);
+  __type(key, struct rq_key);
+  __type(value, struct rq_info);
+} rq_inflight SEC(".maps");
+
+// Per-device counters, keyed by dev (major << 20 | minor). Shared between
+// CPUs, so updated atomically.
+struct device_stats {
+  u64 issued;
+  u64 completed;
+  u64 read_bytes;
+  u64 write_bytes;
+  u64 service_ns;
+  u64 depth_sum; // Sum of queue depth seen at each issue
+  u64 back_merges;
+  u64 front_merges;
+  u64 requeues;
+  u64 errors;
+  s64 inflight;
+  u64 max_depth; // Filled in by userspace from device_max_depth
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_DEVICES);
+  __type(key, u32);
+  __type(value, struct device_stats);
+} device_stats_map SEC(".maps");
+
+// Deepest queue seen at issue, per device and CPU. A shared maximum would
+// need a compare-and-swap loop; per CPU a plain compare and store is safe
+// and userspace takes the maximum over all CPUs.
+struct {
+  __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+  __uint(max_entries, MAX_DEVICES);
+  __type(key, u32);
+  __type(value, u64);
+} device_max_depth SEC(".maps");
+
+// A task is targeted if it matches any configured filter
+static __always_inline bool task_targeted(u64 pid_tgid) {
+  if (!filter_mode)
+    return true;
+
+  if (filter_mode & FILTER_TGID) {
+    u32 tgid = pid_tgid >> 32;
+    if (bpf_map_lookup_elem(&target_tgids, &tgid))
+      return true;
+  }
+
+  if (filter_mode & FILTER_CGROUP) {
+    u64 cgid = bpf_get_current_cgroup_id();
+    if (bpf_map_lookup_elem(&target_cgroups, &cgid))
+      return true;
+  }
+
+  return false;
+}
+
+// True when no PID, cgroup or MinIO filter is active, so probes that run
+// outside the issuing task's context may report untracked I/O too
+static __always_inline bool tracing_everything(void) {
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+
+  return !filter_mode && (!config || config->trace_mode == MINIO_TRACE_OFF);
+}
 
 // Helper to check if process is MinIO
 static __always_inline bool is_minio_process(const char *comm, u32 pid) {
@@ -214,152 +681,852 @@ static __always_inline u32 detect_system_type(const char *comm) {
   return SYSTEM_TYPE_UNKNOWN;
 }
 
-static __always_inline u64 generate_request_id(u64 pid_tgid) {
-  u64 ts = bpf_ktime_get_ns();
-  return (pid_tgid << 32) | (ts & 0xFFFFFFFF);
-}
+static __always_inline u64 generate_request_id(void) {
+  u32 key = 0;
+  u64 *seq = bpf_map_lookup_elem(&request_id_seq, &key);
 
-// Helper to initialize event structure with zeros
-static __always_inline void init_event(struct multilayer_io_event *event) {
-  __builtin_memset(event, 0, sizeof(struct multilayer_io_event));
+  if (!seq)
+    return 0;
+  *seq += 1;
+  return (*seq << 10) | (bpf_get_smp_processor_id() & (MAX_CPUS - 1));
 }
 
-// ============================================================================
-// LAYER 1: APPLICATION LAYER - Using tracepoints
-// ============================================================================
-
-SEC("tracepoint/syscalls/sys_enter_write")
-int trace_app_write_enter(struct trace_event_raw_sys_enter *ctx) {
-  u64 pid_tgid = bpf_get_current_pid_tgid();
-  u32 pid = pid_tgid >> 32;
+static __always_inline void
+origin_from_request(struct request_origin *origin,
+                    const struct request_context_small *req_ctx) {
+  origin->request_id = req_ctx->app_request_id;
+  origin->system_type = req_ctx->system_type;
+  origin->flags = req_ctx->is_minio ? EVENT_FLAG_MINIO : 0;
+  origin->_pad = 0;
+}
 
-  char comm[MAX_COMM_LEN] = {};
-  bpf_get_current_comm(comm, sizeof(comm));
+// Page cache inode behind the first segment of a bio, or NULL for bios
+// without data pages (flushes) and for anonymous pages
+static __always_inline struct inode *bio_inode(struct bio *bio) {
+  struct page *page = BPF_CORE_READ(bio, bi_io_vec, bv_page);
+  if (!page)
+    return NULL;
 
-  // Check if we should trace this process
-  bool trace_this = is_minio_process(comm, pid);
+  struct address_space *mapping = BPF_CORE_READ(page, mapping);
+  // PAGE_MAPPING_ANON and PAGE_MAPPING_MOVABLE live in the low bits
+  if (!mapping || ((u64)mapping & 3))
+    return NULL;
 
-  // Get MinIO config
-  u32 key = 0;
-  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  return BPF_CORE_READ(mapping, host);
+}
 
-  // If MinIO-only mode and not MinIO, skip
-  if (config && config->trace_mode != MINIO_TRACE_OFF && !trace_this)
-    return 0;
+static __always_inline void object_key_of(struct object_key *key,
+                                          struct inode *inode) {
+  key->ino = BPF_CORE_READ(inode, i_ino);
+  key->dev = BPF_CORE_READ(inode, i_sb, s_dev);
+  key->_pad = 0;
+}
 
-  // Use smaller structure for stack
-  struct request_context_small req_ctx = {};
-  req_ctx.app_request_id = generate_request_id(pid_tgid);
-  req_ctx.original_size = ctx->args[2];
-  req_ctx.timestamp = bpf_ktime_get_ns();
-  req_ctx.system_type = detect_system_type(comm);
-  req_ctx.is_minio = trace_this;
+static __always_inline struct object_stats *object_entry(struct inode *inode) {
+  struct object_key key;
+  object_key_of(&key, inode);
+  struct object_stats *os = bpf_map_lookup_elem(&object_stats_map, &key);
 
-  bpf_map_update_elem(&request_tracking, &pid_tgid, &req_ctx, BPF_ANY);
-  bpf_map_update_elem(&io_start_times, &pid_tgid, &req_ctx.timestamp, BPF_ANY);
+  if (os)
+    return os;
 
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event)
-    return 0;
+  struct object_stats zero = {};
+  bpf_map_update_elem(&object_stats_map, &key, &zero, BPF_NOEXIST);
+  return bpf_map_lookup_elem(&object_stats_map, &key);
+}
 
-  init_event(event);
+// Entries are shared between CPUs, hence the atomic adds
+static __always_inline void account_object(struct inode *inode, u64 app,
+                                           u64 vfs, u64 device) {
+  if (!track_objects || !inode)
+    return;
+
+  struct object_stats *os = object_entry(inode);
+  if (!os)
+    return;
+
+  if (app)
+    __sync_fetch_and_add(&os->app_bytes, app);
+  if (vfs)
+    __sync_fetch_and_add(&os->vfs_bytes, vfs);
+  if (device)
+    __sync_fetch_and_add(&os->device_bytes, device);
+}
 
-  event->timestamp = req_ctx.timestamp;
-  event->pid = pid;
+// Helper to zero the fixed part of a record and fill the common fields
+static __always_inline void init_event(struct io_event_core *event,
+                                       u64 pid_tgid, u8 layer,
+                                       u32 event_type) {
+  __builtin_memset(event, 0, sizeof(struct io_event_core));
+  event->timestamp = bpf_ktime_get_ns();
+  event->pid = pid_tgid >> 32;
   event->tid = (u32)pid_tgid;
-  event->layer = LAYER_APPLICATION;
-  event->event_type = trace_this ? EVENT_MINIO_OBJECT_PUT : EVENT_APP_WRITE;
-  event->system_type = req_ctx.system_type;
-  event->size = req_ctx.original_size;
-  event->request_id = req_ctx.app_request_id;
-  event->aligned_size = req_ctx.original_size;
-  event->latency_ns = 0;
-  event->offset = 0;
-  event->is_metadata = 0;
-  event->is_journal = 0;
-  event->cache_hit = 0;
-  event->is_minio = trace_this;
+  event->layer = layer;
+  event->event_type = event_type;
   bpf_get_current_comm(event->comm, sizeof(event->comm));
+}
 
-  bpf_ringbuf_submit(event, 0);
-  return 0;
+// Dense per-layer slot for each event type emitted by this program
+static __always_inline u32 agg_event_slot(u32 event_type) {
+  switch (event_type) {
+  case EVENT_APP_READ:
+    return 1;
+  case EVENT_APP_WRITE:
+    return 2;
+  case EVENT_MINIO_OBJECT_PUT:
+    return 3;
+  case EVENT_MINIO_OBJECT_GET:
+    return 4;
+  case EVENT_MINIO_ERASURE_WRITE:
+    return 5;
+  case EVENT_MINIO_METADATA_UPDATE:
+    return 6;
+  case EVENT_MINIO_BITROT_CHECK:
+    return 7;
+  case EVENT_MINIO_MULTIPART:
+    return 8;
+  case EVENT_MINIO_XL_META:
+    return 9;
+  case EVENT_OS_VFS_READ:
+    return 10;
+  case EVENT_OS_VFS_WRITE:
+    return 11;
+  case EVENT_FS_SYNC:
+    return 12;
+  case EVENT_DEV_BIO_SUBMIT:
+    return 13;
+  case EVENT_DEV_BIO_COMPLETE:
+    return 14;
+  case EVENT_OS_PAGE_CACHE_HIT:
+    return 15;
+  case EVENT_OS_PAGE_CACHE_MISS:
+    return 16;
+  case EVENT_FS_WRITEBACK:
+    return 17;
+  case EVENT_APP_COPY:
+    return 18;
+  case EVENT_APP_MMAP_READ:
+    return 19;
+  case EVENT_MINIO_ERASURE_READ:
+    return 20;
+  case EVENT_FS_METADATA_UPDATE:
+    return 21;
+  case EVENT_FS_EXTENT_ALLOC:
+    return 22;
+  case EVENT_FS_JOURNAL_COMMIT:
+    return 23;
+  default:
+    return 0;
+  }
 }
 
-SEC("tracepoint/syscalls/sys_enter_read")
-int trace_app_read_enter(struct trace_event_raw_sys_enter *ctx) {
-  u64 pid_tgid = bpf_get_current_pid_tgid();
-  u32 pid = pid_tgid >> 32;
+static __always_inline void account_event(const struct io_event_core *e) {
+  if (e->layer >= AGG_LAYERS)
+    return;
+
+  u32 sys = e->system_type < AGG_SYSTEM_SLOTS ? e->system_type : 0;
+  u32 idx = (e->layer * AGG_EVENT_SLOTS + agg_event_slot(e->event_type)) *
+                AGG_SYSTEM_SLOTS +
+            sys;
+  struct layer_agg *agg = bpf_map_lookup_elem(&layer_aggregates, &idx);
+  if (!agg)
+    return;
+
+  // Per-CPU value, so plain increments are safe
+  agg->event_type = e->event_type;
+  agg->events++;
+  agg->bytes += e->size;
+  agg->aligned_bytes += e->aligned_size ? e->aligned_size : e->size;
+  agg->latency_ns += e->latency_ns;
+  if (e->flags & EVENT_FLAG_METADATA)
+    agg->metadata_ops++;
+  if (e->flags & EVENT_FLAG_JOURNAL)
+    agg->journal_ops++;
+  if (e->flags & EVENT_FLAG_CACHE_HIT)
+    agg->cache_hits++;
+  if (e->flags & EVENT_FLAG_MINIO) {
+    agg->minio_events++;
+    agg->minio_bytes += e->size;
+    if (e->flags & EVENT_FLAG_XL_META)
+      agg->xl_meta_ops++;
+  }
+}
 
-  char comm[MAX_COMM_LEN] = {};
-  bpf_get_current_comm(comm, sizeof(comm));
+static __always_inline void account_process(const struct io_event_core *e) {
+  struct process_agg_key key = {.tgid = e->pid, .layer = e->layer};
+  struct process_agg *agg = bpf_map_lookup_elem(&process_aggregates, &key);
 
-  bool trace_this = is_minio_process(comm, pid);
+  if (!agg) {
+    struct process_agg zero = {};
+    bpf_map_update_elem(&process_aggregates, &key, &zero, BPF_NOEXIST);
+    agg = bpf_map_lookup_elem(&process_aggregates, &key);
+    if (!agg)
+      return;
+  }
 
-  u32 key = 0;
-  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  // Per-CPU value, so plain increments are safe
+  agg->events++;
+  agg->bytes += e->size;
+}
 
-  if (config && config->trace_mode != MINIO_TRACE_OFF && !trace_this)
-    return 0;
+static __always_inline u32 log2_u64(u64 v) {
+  u32 r = 0, shift;
+
+  shift = (v > 0xFFFFFFFF) << 5;
+  v >>= shift;
+  r |= shift;
+  shift = (v > 0xFFFF) << 4;
+  v >>= shift;
+  r |= shift;
+  shift = (v > 0xFF) << 3;
+  v >>= shift;
+  r |= shift;
+  shift = (v > 0xF) << 2;
+  v >>= shift;
+  r |= shift;
+  shift = (v > 0x3) << 1;
+  v >>= shift;
+  r |= shift;
+  r |= (v >> 1);
+  return r;
+}
 
-  struct request_context_small req_ctx = {};
-  req_ctx.app_request_id = generate_request_id(pid_tgid);
-  req_ctx.original_size = ctx->args[2];
-  req_ctx.timestamp = bpf_ktime_get_ns();
-  req_ctx.system_type = detect_system_type(comm);
-  req_ctx.is_minio = trace_this;
+static __always_inline u32 latency_slot(u64 ns) {
+  if (ns < (1 << LAT_SUB_BUCKET_BITS))
+    return ns;
 
-  bpf_map_update_elem(&request_tracking, &pid_tgid, &req_ctx, BPF_ANY);
-  bpf_map_update_elem(&io_start_times, &pid_tgid, &req_ctx.timestamp, BPF_ANY);
+  u32 lg = log2_u64(ns);
+  u32 sub = (ns >> (lg - LAT_SUB_BUCKET_BITS)) &
+            ((1 << LAT_SUB_BUCKET_BITS) - 1);
+  u32 slot = ((lg - 1) << LAT_SUB_BUCKET_BITS) + sub;
 
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event)
-    return 0;
+  return slot < LAT_SLOTS ? slot : LAT_SLOTS - 1;
+}
 
-  init_event(event);
+static __always_inline void record_latency(u32 kind, u64 ns) {
+  struct latency_hist *h = bpf_map_lookup_elem(&latency_hists, &kind);
+  if (!h)
+    return;
 
-  event->timestamp = req_ctx.timestamp;
-  event->pid = pid;
-  event->tid = (u32)pid_tgid;
-  event->layer = LAYER_APPLICATION;
-  event->event_type = trace_this ? EVENT_MINIO_OBJECT_GET : EVENT_APP_READ;
-  event->system_type = req_ctx.system_type;
-  event->size = req_ctx.original_size;
-  event->request_id = req_ctx.app_request_id;
-  event->aligned_size = req_ctx.original_size;
-  event->latency_ns = 0;
-  event->is_minio = trace_this;
-  bpf_get_current_comm(event->comm, sizeof(event->comm));
+  u32 slot = latency_slot(ns);
+  if (slot >= LAT_SLOTS)
+    return;
 
-  bpf_ringbuf_submit(event, 0);
-  return 0;
+  // Per-CPU value, so plain increments are safe
+  h->count++;
+  h->sum_ns += ns;
+  h->slots[slot]++;
 }
 
-// ============================================================================
-// MinIO-specific tracing for open/openat to capture file patterns
+static __always_inline void lat_start(u64 pid_tgid, u32 kind) {
+  struct lat_start_key key = {.pid_tgid = pid_tgid, .kind = kind};
+  u64 ts = bpf_ktime_get_ns();
+
+  bpf_map_update_elem(&lat_start_times, &key, &ts, BPF_ANY);
+}
+
+static __always_inline void lat_end(u32 kind) {
+  struct lat_start_key key = {.pid_tgid = bpf_get_current_pid_tgid(),
+                              .kind = kind};
+  u64 *ts = bpf_map_lookup_elem(&lat_start_times, &key);
+  if (!ts)
+    return;
+
+  record_latency(kind, bpf_ktime_get_ns() - *ts);
+  bpf_map_delete_elem(&lat_start_times, &key);
+}
+
+// Syscall exit side: the enter probes stored their start time in
+// io_start_times under pid_tgid
+static __always_inline void syscall_end(u32 kind) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+  u64 *ts = bpf_map_lookup_elem(&io_start_times, &pid_tgid);
+  if (!ts)
+    return;
+
+  record_latency(kind, bpf_ktime_get_ns() - *ts);
+  bpf_map_delete_elem(&io_start_times, &pid_tgid);
+}
+
+static __always_inline bool take_token(u32 rate) {
+  u32 key = 0;
+  struct token_bucket *tb = bpf_map_lookup_elem(&token_buckets, &key);
+  if (!tb)
+    return true;
+
+  u64 now = bpf_ktime_get_ns();
+  u64 elapsed = now - tb->last_ns;
+  u64 burst = (u64)rate * TOKEN_SCALE; // One second worth
+
+  // Cap the refill interval so the multiply below cannot overflow
+  if (elapsed > TOKEN_SCALE)
+    elapsed = TOKEN_SCALE;
+  tb->last_ns = now;
+  tb->tokens += elapsed * rate;
+  if (tb->tokens > burst)
+    tb->tokens = burst;
+
+  if (tb->tokens < TOKEN_SCALE)
+    return false;
+  tb->tokens -= TOKEN_SCALE;
+  return true;
+}
+
+// 1-in-N sampling keyed on request_id keeps or drops a request on every
+// layer together, so sampled requests still correlate end to end
+static __always_inline bool sample_event(struct tracer_config *cfg, u32 layer,
+                                         u64 request_id) {
+  u32 rate = cfg->sample_rate[layer];
+
+  if (rate > 1) {
+    u32 h = request_id ? (u32)((request_id * 0x9E3779B97F4A7C15ULL) >> 32)
+                       : bpf_get_prandom_u32();
+    if (h % rate)
+      return false;
+  }
+
+  if (cfg->budget_per_cpu)
+    return take_token(cfg->budget_per_cpu);
+  return true;
+}
+
+static __always_inline void count_ring_drop(struct sample_counts *sc,
+                                            u32 event_type) {
+  u32 slot = agg_event_slot(event_type);
+  struct ring_drop *d = bpf_map_lookup_elem(&ring_drop_counts, &slot);
+
+  if (sc)
+    sc->ring_drops++;
+  if (d) {
+    d->drops++;
+    d->event_type = event_type;
+  }
+}
+
+// With batched wakeups the consumer is only woken once wakeup_bytes are
+// waiting; below that it finds the records on its next timed poll
+static __always_inline u64 ring_flags(void *ring, struct tracer_config *cfg) {
+  if (!cfg || !cfg->wakeup_bytes)
+    return 0;
+  return bpf_ringbuf_query(ring, BPF_RB_AVAIL_DATA) >= cfg->wakeup_bytes
+             ? BPF_RB_FORCE_WAKEUP
+             : BPF_RB_NO_WAKEUP;
+}
+
+// Single exit point for all probes: account the event in kernel if asked
+// to, then stream it unless running in aggregation-only mode or sampled out
+static __always_inline void emit_event(void *rec, u64 rec_size) {
+  struct io_event_core *e = rec;
+  u32 key = 0;
+  struct tracer_config *cfg = bpf_map_lookup_elem(&tracer_config_map, &key);
+  u32 layer = e->layer < SAMPLE_LAYERS ? e->layer : 0;
+  struct sample_counts *sc;
+
+  if (cfg && cfg->paused)
+    return;
+  sc = bpf_map_lookup_elem(&sample_stats, &layer);
+  if (cfg && cfg->aggregate) {
+    account_event(rec);
+    if (cfg->per_process)
+      account_process(rec);
+  }
+  if (cfg && cfg->skip_events)
+    return;
+
+  if (sc)
+    sc->seen++;
+  if (cfg && (cfg->sample_rate[layer] > 1 || cfg->budget_per_cpu)) {
+    if (!sample_event(cfg, layer, e->request_id))
+      return;
+    e->flags |= EVENT_FLAG_SAMPLED;
+  }
+  if (sc)
+    sc->emitted++;
+
+  if (cfg && cfg->sharded) {
+    u32 cpu = bpf_get_smp_processor_id();
+    u32 *shard = bpf_map_lookup_elem(&cpu_shard, &cpu);
+    void *ring = shard ? bpf_map_lookup_elem(&event_shards, shard) : NULL;
+    if (ring) {
+      if (bpf_ringbuf_output(ring, rec, rec_size, ring_flags(ring, cfg)) != 0)
+        count_ring_drop(sc, e->event_type);
+      return;
+    }
+  }
+
+  if (bpf_ringbuf_output(&events, rec, rec_size, ring_flags(&events, cfg)) !=
+      0)
+    count_ring_drop(sc, e->event_type);
+}
+
+// ============================================================================
+// LAYER 1: APPLICATION LAYER - Using tracepoints
+// ============================================================================
+
+// Shared entry side of every read- and write-like syscall. Starts a new
+// request for the thread and emits its application record with the
+// requested size.
+static __always_inline int app_io_enter(u64 size, u32 event_type,
+                                        u32 minio_event_type) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
+  u32 pid = pid_tgid >> 32;
+
+  char comm[MAX_COMM_LEN] = {};
+  bpf_get_current_comm(comm, sizeof(comm));
+
+  // Check if we should trace this process
+  bool trace_this = is_minio_process(comm, pid);
+
+  // Get MinIO config
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+
+  // If MinIO-only mode and not MinIO, skip
+  if (config && config->trace_mode != MINIO_TRACE_OFF && !trace_this)
+    return 0;
+
+  // Use smaller structure for stack
+  struct request_context_small req_ctx = {};
+  req_ctx.app_request_id = generate_request_id();
+  req_ctx.original_size = size;
+  req_ctx.timestamp = bpf_ktime_get_ns();
+  req_ctx.system_type = detect_system_type(comm);
+  req_ctx.is_minio = trace_this;
+
+  bpf_map_update_elem(&request_tracking, &pid_tgid, &req_ctx, BPF_ANY);
+  bpf_map_update_elem(&io_start_times, &pid_tgid, &req_ctx.timestamp, BPF_ANY);
+
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
+
+  init_event(event, pid_tgid, LAYER_APPLICATION,
+             trace_this ? minio_event_type : event_type);
+
+  event->timestamp = req_ctx.timestamp;
+  event->system_type = req_ctx.system_type;
+  event->size = req_ctx.original_size;
+  event->request_id = req_ctx.app_request_id;
+  event->aligned_size = req_ctx.original_size;
+  if (trace_this)
+    event->flags |= EVENT_FLAG_MINIO;
+
+  emit_event(event, sizeof(*event));
+  return 0;
+}
+
+static __always_inline int app_write_enter(u64 size) {
+  return app_io_enter(size, EVENT_APP_WRITE, EVENT_MINIO_OBJECT_PUT);
+}
+
+static __always_inline int app_read_enter(u64 size) {
+  return app_io_enter(size, EVENT_APP_READ, EVENT_MINIO_OBJECT_GET);
+}
+
+// Requested size of a readv/writev family call. Only the first
+// MAX_IOV_SUM vectors are read from user memory.
+#define MAX_IOV_SUM 16
+
+static __always_inline u64 iov_total(const struct iovec *iov, u64 iovcnt) {
+  u64 total = 0;
+
+#pragma unroll
+  for (int i = 0; i < MAX_IOV_SUM; i++) {
+    struct iovec v;
+
+    if (i >= iovcnt)
+      break;
+    if (bpf_probe_read_user(&v, sizeof(v), &iov[i]) != 0)
+      break;
+    total += v.iov_len;
+  }
+  return total;
+}
+
+SEC("tracepoint/syscalls/sys_enter_write")
+int trace_app_write_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_write_enter(ctx->args[2]);
+}
+
+SEC("tracepoint/syscalls/sys_enter_read")
+int trace_app_read_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_read_enter(ctx->args[2]);
+}
+
+SEC("tracepoint/syscalls/sys_enter_pwrite64")
+int trace_app_pwrite_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_write_enter(ctx->args[2]);
+}
+
+SEC("tracepoint/syscalls/sys_enter_pread64")
+int trace_app_pread_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_read_enter(ctx->args[2]);
+}
+
+SEC("tracepoint/syscalls/sys_enter_writev")
+int trace_app_writev_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_write_enter(
+      iov_total((const struct iovec *)ctx->args[1], ctx->args[2]));
+}
+
+SEC("tracepoint/syscalls/sys_enter_readv")
+int trace_app_readv_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_read_enter(
+      iov_total((const struct iovec *)ctx->args[1], ctx->args[2]));
+}
+
+SEC("tracepoint/syscalls/sys_enter_pwritev")
+int trace_app_pwritev_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_write_enter(
+      iov_total((const struct iovec *)ctx->args[1], ctx->args[2]));
+}
+
+SEC("tracepoint/syscalls/sys_enter_preadv")
+int trace_app_preadv_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_read_enter(
+      iov_total((const struct iovec *)ctx->args[1], ctx->args[2]));
+}
+
+SEC("tracepoint/syscalls/sys_enter_pwritev2")
+int trace_app_pwritev2_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_write_enter(
+      iov_total((const struct iovec *)ctx->args[1], ctx->args[2]));
+}
+
+SEC("tracepoint/syscalls/sys_enter_preadv2")
+int trace_app_preadv2_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_read_enter(
+      iov_total((const struct iovec *)ctx->args[1], ctx->args[2]));
+}
+
+// In-kernel copies: the application asks for len bytes to be moved once
+SEC("tracepoint/syscalls/sys_enter_copy_file_range")
+int trace_app_copy_range_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_io_enter(ctx->args[4], EVENT_APP_COPY, EVENT_APP_COPY);
+}
+
+SEC("tracepoint/syscalls/sys_enter_sendfile64")
+int trace_app_sendfile_enter(struct trace_event_raw_sys_enter *ctx) {
+  return app_io_enter(ctx->args[3], EVENT_APP_COPY, EVENT_APP_COPY);
+}
+
+SEC("tracepoint/syscalls/sys_exit_write")
+int trace_app_write_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_WRITE);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_read")
+int trace_app_read_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_READ);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_pwrite64")
+int trace_app_pwrite_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_WRITE);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_pread64")
+int trace_app_pread_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_READ);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_writev")
+int trace_app_writev_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_WRITE);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_readv")
+int trace_app_readv_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_READ);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_pwritev")
+int trace_app_pwritev_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_WRITE);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_preadv")
+int trace_app_preadv_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_READ);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_pwritev2")
+int trace_app_pwritev2_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_WRITE);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_preadv2")
+int trace_app_preadv2_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_READ);
+  return 0;
+}
+
+// Copies are timed as writes to their destination
+SEC("tracepoint/syscalls/sys_exit_copy_file_range")
+int trace_app_copy_range_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_WRITE);
+  return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_sendfile64")
+int trace_app_sendfile_exit(struct trace_event_raw_sys_exit *ctx) {
+  syscall_end(LAT_SYSCALL_WRITE);
+  return 0;
+}
+
+// ============================================================================
+// LAYER 1: APPLICATION LAYER - io_uring and mmap
+// ============================================================================
+
+// io_uring opcodes that move file data (include/uapi/linux/io_uring.h)
+#define IORING_OP_READV 1
+#define IORING_OP_WRITEV 2
+#define IORING_OP_READ_FIXED 4
+#define IORING_OP_WRITE_FIXED 5
+#define IORING_OP_READ 22
+#define IORING_OP_WRITE 23
+
+// Submissions waiting for their completion, keyed the way both
+// tracepoints can see them
+struct uring_key {
+  u64 ctx;
+  u64 user_data;
+};
+
+struct uring_info {
+  u64 submit_ns;
+  u64 pid_tgid;
+  u64 request_id;
+  u32 system_type;
+  u8 is_write;
+  u8 is_minio;
+  u16 _pad;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_HASH);
+  __uint(max_entries, MAX_INFLIGHT);
+  __type(key, struct uring_key);
+  __type(value, struct uring_info);
+} uring_inflight SEC(".maps");
+
+// The submit tracepoint was io_uring_submit_sqe before 6.0 and is
+// io_uring_submit_req since, and a vmlinux.h only has the struct of its own
+// kernel. Both are read through local flavours, so the program builds
+// against either; userspace autoloads the one this kernel has.
+struct trace_event_raw_io_uring_submit_req___new {
+  void *ctx;
+  u64 user_data;
+  u8 opcode;
+} __attribute__((preserve_access_index));
+
+struct trace_event_raw_io_uring_submit_sqe___old {
+  void *ctx;
+  u64 user_data;
+  u8 opcode;
+} __attribute__((preserve_access_index));
+
+// The SQE length is not part of the tracepoint, so the submission only
+// opens the request and the completion emits the single APPLICATION
+// record with the bytes. Work issued inline by the submitting thread still
+// finds the request in request_tracking.
+static __always_inline int uring_submit(u64 ring, u64 user_data, u8 op) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
+  bool is_write = op == IORING_OP_WRITEV || op == IORING_OP_WRITE_FIXED ||
+                  op == IORING_OP_WRITE;
+  if (!is_write && op != IORING_OP_READV && op != IORING_OP_READ_FIXED &&
+      op != IORING_OP_READ)
+    return 0;
+
+  u32 pid = pid_tgid >> 32;
+  char comm[MAX_COMM_LEN] = {};
+  bpf_get_current_comm(comm, sizeof(comm));
+
+  bool trace_this = is_minio_process(comm, pid);
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  if (config && config->trace_mode != MINIO_TRACE_OFF && !trace_this)
+    return 0;
+
+  struct request_context_small req_ctx = {};
+  req_ctx.app_request_id = generate_request_id();
+  req_ctx.timestamp = bpf_ktime_get_ns();
+  req_ctx.system_type = detect_system_type(comm);
+  req_ctx.is_minio = trace_this;
+  bpf_map_update_elem(&request_tracking, &pid_tgid, &req_ctx, BPF_ANY);
+
+  struct uring_key ukey = {.ctx = ring, .user_data = user_data};
+  struct uring_info info = {
+      .submit_ns = req_ctx.timestamp,
+      .pid_tgid = pid_tgid,
+      .request_id = req_ctx.app_request_id,
+      .system_type = req_ctx.system_type,
+      .is_write = is_write,
+      .is_minio = trace_this,
+  };
+  bpf_map_update_elem(&uring_inflight, &ukey, &info, BPF_ANY);
+  return 0;
+}
+
+SEC("tracepoint/io_uring/io_uring_submit_req")
+int trace_uring_submit(void *ctx) {
+  struct trace_event_raw_io_uring_submit_req___new *tp = ctx;
+
+  return uring_submit((u64)BPF_CORE_READ(tp, ctx),
+                      BPF_CORE_READ(tp, user_data), BPF_CORE_READ(tp, opcode));
+}
+
+SEC("tracepoint/io_uring/io_uring_submit_sqe")
+int trace_uring_submit_sqe(void *ctx) {
+  struct trace_event_raw_io_uring_submit_sqe___old *tp = ctx;
+
+  return uring_submit((u64)BPF_CORE_READ(tp, ctx),
+                      BPF_CORE_READ(tp, user_data), BPF_CORE_READ(tp, opcode));
+}
+
+// May run in an io-wq worker or in interrupt context, so the task is taken
+// from the submission
+SEC("tracepoint/io_uring/io_uring_complete")
+int trace_uring_complete(struct trace_event_raw_io_uring_complete *ctx) {
+  struct uring_key ukey = {.ctx = (u64)ctx->ctx, .user_data = ctx->user_data};
+  struct uring_info *found = bpf_map_lookup_elem(&uring_inflight, &ukey);
+  if (!found)
+    return 0;
+
+  struct uring_info info = *found;
+  bpf_map_delete_elem(&uring_inflight, &ukey);
+
+  int res = ctx->res;
+  if (res <= 0)
+    return 0;
+
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
+  u32 type;
+
+  if (info.is_minio)
+    type = info.is_write ? EVENT_MINIO_OBJECT_PUT : EVENT_MINIO_OBJECT_GET;
+  else
+    type = info.is_write ? EVENT_APP_WRITE : EVENT_APP_READ;
+
+  // Stamped at submission, like syscall records are at entry
+  init_event(event, info.pid_tgid, LAYER_APPLICATION, type);
+  event->latency_ns = event->timestamp - info.submit_ns;
+  event->timestamp = info.submit_ns;
+  event->system_type = info.system_type;
+  event->size = res;
+  event->aligned_size = res;
+  event->request_id = info.request_id;
+  if (info.is_minio)
+    event->flags |= EVENT_FLAG_MINIO;
+
+  emit_event(event, sizeof(*event));
+  return 0;
+}
+
+#define VM_EXEC 0x00000004 // include/linux/mm.h
+
+// Reads through a file mapping never make a syscall; each major or minor
+// fault on a file-backed data VMA maps one page for the application.
+// Executable mappings are program text and shared libraries, not data the
+// application asked for, so they are skipped. Pages mapped by fault-around
+// never fault and are not seen, so this is a lower bound, and userspace
+// keeps it apart from the syscall bytes used as the amplification baseline.
+SEC("kprobe/filemap_fault")
+int trace_mmap_fault(struct pt_regs *ctx) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
+  u32 pid = pid_tgid >> 32;
+  struct vm_fault *vmf = (struct vm_fault *)PT_REGS_PARM1(ctx);
+  unsigned long vm_flags = BPF_CORE_READ(vmf, vma, vm_flags);
+  if (vm_flags & VM_EXEC)
+    return 0;
+
+  char comm[MAX_COMM_LEN] = {};
+  bpf_get_current_comm(comm, sizeof(comm));
+
+  bool trace_this = is_minio_process(comm, pid);
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  if (config && config->trace_mode != MINIO_TRACE_OFF && !trace_this)
+    return 0;
+
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
+
+  init_event(event, pid_tgid, LAYER_APPLICATION, EVENT_APP_MMAP_READ);
+  event->system_type = detect_system_type(comm);
+  event->size = CACHE_PAGE_SIZE;
+  event->aligned_size = CACHE_PAGE_SIZE;
+
+  struct file *file = BPF_CORE_READ(vmf, vma, vm_file);
+  if (file)
+    event->inode = BPF_CORE_READ(file, f_inode, i_ino);
+  if (trace_this)
+    event->flags |= EVENT_FLAG_MINIO;
+
+  emit_event(event, sizeof(*event));
+  return 0;
+}
+
+// ============================================================================
+// MinIO-specific tracing for open/openat to capture file patterns
 // ============================================================================
 
 SEC("tracepoint/syscalls/sys_enter_openat")
 int trace_minio_openat(struct trace_event_raw_sys_enter *ctx) {
   u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
   u32 pid = pid_tgid >> 32;
 
+  // The exit names the object the returned fd refers to
+  if (openat_paths) {
+    u64 path = ctx->args[1];
+    bpf_map_update_elem(&open_paths, &pid_tgid, &path, BPF_ANY);
+  }
+
   char comm[MAX_COMM_LEN] = {};
   bpf_get_current_comm(comm, sizeof(comm));
 
   if (!is_minio_process(comm, pid))
     return 0;
 
-  // Get temp storage for filename
+  // The record is assembled in per-CPU scratch space so that only the
+  // filename bytes actually read are copied into the ring buffer
   u32 temp_key = 0;
-  struct temp_storage *temp = bpf_map_lookup_elem(&temp_storage_map, &temp_key);
+  struct filename_event *temp =
+      bpf_map_lookup_elem(&temp_storage_map, &temp_key);
   if (!temp)
     return 0;
 
   // Try to read filename
   const char *filename_ptr = (const char *)ctx->args[1];
-  bpf_probe_read_user_str(temp->filename, sizeof(temp->filename), filename_ptr);
+  long name_len = bpf_probe_read_user_str(temp->filename,
+                                          sizeof(temp->filename), filename_ptr);
+  if (name_len <= 0)
+    return 0;
 
   // Check if it's a MinIO-specific file
   bool is_xl_meta = false;
@@ -386,239 +1553,935 @@ int trace_minio_openat(struct trace_event_raw_sys_enter *ctx) {
     }
   }
 
-  if (is_xl_meta || is_part_file) {
-    struct multilayer_io_event *event =
-        bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-    if (!event)
-      return 0;
+  if (is_xl_meta || is_part_file) {
+    struct io_event_core *event = &temp->core;
+
+    init_event(event, pid_tgid, LAYER_STORAGE_SERVICE,
+               is_xl_meta ? EVENT_MINIO_XL_META : EVENT_MINIO_ERASURE_WRITE);
+
+    event->system_type = SYSTEM_TYPE_MINIO;
+    event->flags = EVENT_FLAG_MINIO | EVENT_EXT_FILENAME;
+    if (is_xl_meta)
+      event->flags |= EVENT_FLAG_XL_META | EVENT_FLAG_METADATA;
+
+    // name_len includes the terminating NUL
+    u32 payload = name_len;
+    if (payload > MAX_FILENAME_LEN)
+      payload = MAX_FILENAME_LEN;
+    emit_event(temp, sizeof(struct io_event_core) + payload);
+  }
+
+  return 0;
+}
+
+// Paths are resolved once per inode. bpf_d_path() gives the absolute
+// path but is only allowed in a few hooks: the file open and permission
+// LSM hooks cover files opened before and after the tracer started. Both
+// need trampolines; on kprobe-only kernels trace_openat_exit() records the
+// path openat() was given instead.
+static __always_inline void resolve_path(struct file *file) {
+  struct inode *inode = BPF_CORE_READ(file, f_inode);
+  struct object_key key;
+
+  if (!inode)
+    return;
+  object_key_of(&key, inode);
+  if (bpf_map_lookup_elem(&inode_paths, &key))
+    return;
+
+  u32 temp_key = 0;
+  struct filename_event *temp =
+      bpf_map_lookup_elem(&temp_storage_map, &temp_key);
+  if (!temp)
+    return;
+
+  if (bpf_d_path(&file->f_path, temp->filename, sizeof(temp->filename)) < 0)
+    return;
+  bpf_map_update_elem(&inode_paths, &key, temp->filename, BPF_NOEXIST);
+}
+
+SEC("fentry/security_file_open")
+int BPF_PROG(fentry_path_open, struct file *file) {
+  if (task_targeted(bpf_get_current_pid_tgid()))
+    resolve_path(file);
+  return 0;
+}
+
+// rw_verify_area() on every read and write; a hash lookup once the path
+// is known
+SEC("fentry/security_file_permission")
+int BPF_PROG(fentry_path_access, struct file *file, int mask) {
+  if (task_targeted(bpf_get_current_pid_tgid()))
+    resolve_path(file);
+  return 0;
+}
+
+// The path as the caller passed it to openat(), which is still in its
+// memory at exit. Relative paths stay relative.
+SEC("tracepoint/syscalls/sys_exit_openat")
+int trace_openat_exit(struct trace_event_raw_sys_exit *ctx) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+  u64 *path = bpf_map_lookup_elem(&open_paths, &pid_tgid);
+
+  if (!path)
+    return 0;
+
+  u64 user_path = *path;
+  bpf_map_delete_elem(&open_paths, &pid_tgid);
+
+  long fd = ctx->ret;
+  if (fd < 0)
+    return 0;
+
+  struct task_struct *task = (struct task_struct *)bpf_get_current_task();
+  struct file **fds = BPF_CORE_READ(task, files, fdt, fd);
+  struct file *file = NULL;
+  if (!fds || bpf_probe_read_kernel(&file, sizeof(file), &fds[fd]) || !file)
+    return 0;
+
+  struct inode *inode = BPF_CORE_READ(file, f_inode);
+  if (!inode)
+    return 0;
+
+  struct object_key key;
+  object_key_of(&key, inode);
+  if (bpf_map_lookup_elem(&inode_paths, &key))
+    return 0;
+
+  u32 temp_key = 0;
+  struct filename_event *temp =
+      bpf_map_lookup_elem(&temp_storage_map, &temp_key);
+  if (!temp)
+    return 0;
+
+  if (bpf_probe_read_user_str(temp->filename, sizeof(temp->filename),
+                              (const char *)user_path) <= 0)
+    return 0;
+  bpf_map_update_elem(&inode_paths, &key, temp->filename, BPF_NOEXIST);
+  return 0;
+}
+
+// ============================================================================
+// LAYER 3: OPERATING SYSTEM LAYER - VFS operations
+// ============================================================================
+
+// The VFS, splice and bio probes exist twice: as kprobes, and as
+// fentry/fexit programs where BPF trampolines are available. Both call the
+// same bodies below; userspace loads one set, see configure_attach_mode().
+
+static __always_inline int vfs_read_enter(struct file *file, size_t count,
+                                          loff_t *ppos) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
+  u32 pid = pid_tgid >> 32;
+
+  char comm[MAX_COMM_LEN] = {};
+  bpf_get_current_comm(comm, sizeof(comm));
+
+  // Check MinIO filtering
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  if (config && config->trace_mode != MINIO_TRACE_OFF) {
+    if (!is_minio_process(comm, pid))
+      return 0;
+  }
+
+  struct request_context_small *req_ctx =
+      bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
+
+  init_event(event, pid_tgid, LAYER_OPERATING_SYSTEM, EVENT_OS_VFS_READ);
+  event->size = count;
+
+  // Calculate aligned size (round up to 4KB page)
+  event->aligned_size = (count + 4095) & ~4095ULL;
+
+  // Try to get inode safely
+  if (file) {
+    struct inode *inode = BPF_CORE_READ(file, f_inode);
+    if (inode) {
+      event->inode = BPF_CORE_READ(inode, i_ino);
+      account_object(inode, count, event->aligned_size, 0);
+    }
+  }
+
+  if (req_ctx) {
+    event->request_id = req_ctx->app_request_id;
+    event->system_type = req_ctx->system_type;
+    if (req_ctx->is_minio)
+      event->flags |= EVENT_FLAG_MINIO;
+  }
+
+  emit_event(event, sizeof(*event));
+  lat_start(pid_tgid, LAT_VFS_READ);
+
+  // Without a file position every insertion counts as part of the read
+  struct cache_acct acct = {.ino = event->inode, .end_page = ~0ULL};
+  loff_t pos;
+  if (ppos && bpf_probe_read_kernel(&pos, sizeof(pos), ppos) == 0 &&
+      pos >= 0) {
+    acct.first_page = pos / CACHE_PAGE_SIZE;
+    acct.end_page = (pos + count + CACHE_PAGE_SIZE - 1) / CACHE_PAGE_SIZE;
+  }
+  bpf_map_update_elem(&cache_acct_map, &pid_tgid, &acct, BPF_ANY);
+  return 0;
+}
+
+// One page cache record per buffered read: size is what the read
+// returned, aligned_size what had to be brought into the cache for the
+// range it read. A read that inserted nothing inside its range was served
+// from the cache, even if it started readahead beyond it; readahead is
+// counted in cache_stats instead.
+static __always_inline void cache_read_end(long ret) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+  struct cache_acct *acct = bpf_map_lookup_elem(&cache_acct_map, &pid_tgid);
+  if (!acct)
+    return;
+
+  struct cache_acct a = *acct;
+  bpf_map_delete_elem(&cache_acct_map, &pid_tgid);
+
+  if (a.readahead_bytes) {
+    struct cache_stats *cs = get_cache_stats();
+    if (cs)
+      cs->readahead_pages += a.readahead_bytes / CACHE_PAGE_SIZE;
+  }
+
+  // O_DIRECT, pipes and sockets never touch the page cache
+  if (ret <= 0 ||
+      (a.accessed == 0 && a.miss_bytes == 0 && a.readahead_bytes == 0))
+    return;
+
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
+
+  init_event(event, pid_tgid, LAYER_OPERATING_SYSTEM,
+             a.miss_bytes ? EVENT_OS_PAGE_CACHE_MISS
+                          : EVENT_OS_PAGE_CACHE_HIT);
+  event->size = ret;
+  event->aligned_size = a.miss_bytes;
+  event->inode = a.ino;
+  if (!a.miss_bytes)
+    event->flags |= EVENT_FLAG_CACHE_HIT;
+
+  struct request_context_small *req_ctx =
+      bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+  if (req_ctx) {
+    event->request_id = req_ctx->app_request_id;
+    event->system_type = req_ctx->system_type;
+    if (req_ctx->is_minio)
+      event->flags |= EVENT_FLAG_MINIO;
+  }
+
+  emit_event(event, sizeof(*event));
+}
+
+SEC("kprobe/vfs_read")
+int trace_vfs_read(struct pt_regs *ctx) {
+  return vfs_read_enter((struct file *)PT_REGS_PARM1(ctx), PT_REGS_PARM3(ctx),
+                        (loff_t *)PT_REGS_PARM4(ctx));
+}
+
+SEC("kretprobe/vfs_read")
+int trace_vfs_read_ret(struct pt_regs *ctx) {
+  cache_read_end(PT_REGS_RC(ctx));
+  lat_end(LAT_VFS_READ);
+  return 0;
+}
+
+SEC("fentry/vfs_read")
+int BPF_PROG(fentry_vfs_read, struct file *file, char *buf, size_t count,
+             loff_t *pos) {
+  return vfs_read_enter(file, count, pos);
+}
+
+SEC("fexit/vfs_read")
+int BPF_PROG(fexit_vfs_read, struct file *file, char *buf, size_t count,
+             loff_t *pos, ssize_t ret) {
+  cache_read_end(ret);
+  lat_end(LAT_VFS_READ);
+  return 0;
+}
+
+static __always_inline int vfs_write_enter(struct file *file, size_t count) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
+  u32 pid = pid_tgid >> 32;
+
+  char comm[MAX_COMM_LEN] = {};
+  bpf_get_current_comm(comm, sizeof(comm));
+
+  // Check MinIO filtering
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  if (config && config->trace_mode != MINIO_TRACE_OFF) {
+    if (!is_minio_process(comm, pid))
+      return 0;
+  }
+
+  struct request_context_small *req_ctx =
+      bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+
+  // The record size depends on whether the detail payload is present
+  struct detail_event rec;
+  struct io_event_core *event = &rec.core;
+  u64 rec_size = sizeof(struct io_event_core);
+
+  init_event(event, pid_tgid, LAYER_OPERATING_SYSTEM, EVENT_OS_VFS_WRITE);
+  __builtin_memset(&rec.detail, 0, sizeof(rec.detail));
+  event->size = count;
+
+  // Calculate aligned size
+  event->aligned_size = (count + 4095) & ~4095ULL;
+
+  u64 inode_key = 0;
+  if (file) {
+    struct inode *inode = BPF_CORE_READ(file, f_inode);
+    if (inode) {
+      event->inode = BPF_CORE_READ(inode, i_ino);
+      inode_key = (u64)inode;
+      account_object(inode, count, event->aligned_size, 0);
+    }
+  }
+
+  if (!req_ctx && inode_key) {
+    // No syscall on this thread, e.g. an io_uring worker: carry on the
+    // request that last dirtied the inode
+    struct request_origin *origin =
+        bpf_map_lookup_elem(&inode_requests, &inode_key);
+    if (origin) {
+      event->request_id = origin->request_id;
+      event->system_type = origin->system_type;
+      event->flags |= origin->flags | EVENT_FLAG_INHERITED;
+    }
+  }
+
+  if (req_ctx) {
+    event->request_id = req_ctx->app_request_id;
+    event->system_type = req_ctx->system_type;
+    if (req_ctx->is_minio)
+      event->flags |= EVENT_FLAG_MINIO;
+
+    // The pages dirtied here may be written back from any thread
+    if (inode_key) {
+      struct request_origin origin;
+      origin_from_request(&origin, req_ctx);
+      bpf_map_update_elem(&inode_requests, &inode_key, &origin, BPF_ANY);
+    }
+
+    // For MinIO, track erasure coding amplification
+    if (req_ctx->is_minio && req_ctx->erasure_blocks > 0) {
+      rec.detail.erasure_set_index = req_ctx->erasure_blocks;
+      event->flags |= EVENT_EXT_DETAIL;
+      rec_size = sizeof(rec);
+    }
+  }
+
+  emit_event(&rec, rec_size);
+  lat_start(pid_tgid, LAT_VFS_WRITE);
+  return 0;
+}
+
+SEC("kprobe/vfs_write")
+int trace_vfs_write(struct pt_regs *ctx) {
+  return vfs_write_enter((struct file *)PT_REGS_PARM1(ctx),
+                         PT_REGS_PARM3(ctx));
+}
+
+SEC("kretprobe/vfs_write")
+int trace_vfs_write_ret(struct pt_regs *ctx) {
+  lat_end(LAT_VFS_WRITE);
+  return 0;
+}
+
+SEC("fentry/vfs_write")
+int BPF_PROG(fentry_vfs_write, struct file *file, const char *buf,
+             size_t count, loff_t *pos) {
+  return vfs_write_enter(file, count);
+}
+
+SEC("fexit/vfs_write")
+int BPF_PROG(fexit_vfs_write, struct file *file, const char *buf,
+             size_t count, loff_t *pos, ssize_t ret) {
+  lat_end(LAT_VFS_WRITE);
+  return 0;
+}
+
+// ============================================================================
+// LAYER 4: FILESYSTEM LAYER - Track sync operations
+// ============================================================================
+
+static __always_inline int fs_sync_enter(void) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
+  u32 pid = pid_tgid >> 32;
+
+  char comm[MAX_COMM_LEN] = {};
+  bpf_get_current_comm(comm, sizeof(comm));
+
+  // Check MinIO filtering
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  if (config && config->trace_mode != MINIO_TRACE_OFF) {
+    if (!is_minio_process(comm, pid))
+      return 0;
+  }
+
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
+
+  init_event(event, pid_tgid, LAYER_FILESYSTEM, EVENT_FS_SYNC);
+  event->flags = EVENT_FLAG_METADATA; // Sync is metadata operation
+  if (is_minio_process(comm, pid))
+    event->flags |= EVENT_FLAG_MINIO;
+
+  emit_event(event, sizeof(*event));
+  lat_start(pid_tgid, LAT_FSYNC);
+  return 0;
+}
+
+SEC("kprobe/vfs_fsync_range")
+int trace_fs_sync(struct pt_regs *ctx) {
+  return fs_sync_enter();
+}
+
+SEC("kretprobe/vfs_fsync_range")
+int trace_fs_sync_ret(struct pt_regs *ctx) {
+  lat_end(LAT_FSYNC);
+  return 0;
+}
+
+SEC("fentry/vfs_fsync_range")
+int BPF_PROG(fentry_fs_sync, struct file *file, loff_t start, loff_t end,
+             int datasync) {
+  return fs_sync_enter();
+}
+
+SEC("fexit/vfs_fsync_range")
+int BPF_PROG(fexit_fs_sync, struct file *file, loff_t start, loff_t end,
+             int datasync, int ret) {
+  lat_end(LAT_FSYNC);
+  return 0;
+}
+
+// ============================================================================
+// LAYER 4: FILESYSTEM LAYER - Journal and metadata blocks
+// ============================================================================
+
+// Both journals account in blocks of the filesystem, which the tracepoints
+// do not report; 4K is what ext4 and XFS pick on any disk worth tracing.
+#define JOURNAL_BLOCK_SIZE 4096
+
+// The jbd2 and xfs tracepoint structs are only in a vmlinux.h built with
+// the filesystems in-tree. Local flavours keep the program building either
+// way, CO-RE finds the fields in module BTF, and userspace autoloads only
+// the probes whose tracepoints this kernel has.
+struct trace_event_raw_jbd2_handle_stats___mlio {
+  u32 dev;
+  u32 tid;
+  int dirtied_blocks;
+} __attribute__((preserve_access_index));
+
+struct trace_event_raw_jbd2_run_stats___mlio {
+  u32 dev;
+  u32 tid;
+  u32 blocks_logged;
+} __attribute__((preserve_access_index));
+
+struct trace_event_raw_xfs_loggrant_class___mlio {
+  u32 dev;
+  int curr_res;
+  int unit_res;
+} __attribute__((preserve_access_index));
+
+// A jbd2 commit runs in the journal kthread and covers every handle of
+// its transaction, so the handles remember the last request that joined
+// each transaction and the commit is charged to it, like writeback.
+struct journal_txn_key {
+  u32 dev;
+  u32 tid;
+};
+
+struct {
+  __uint(type, BPF_MAP_TYPE_LRU_HASH);
+  __uint(max_entries, 1024);
+  __type(key, struct journal_txn_key);
+  __type(value, struct request_origin);
+} journal_txns SEC(".maps");
+
+// Metadata a request put in the journal, emitted from the task that made
+// the change. Returns false if the task is not traced; otherwise origin is
+// the request it belongs to, zero outside of a syscall.
+static __always_inline bool fs_metadata_emit(u32 dev, u64 bytes, u32 blocks,
+                                             struct request_origin *origin) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return false;
+
+  u32 pid = pid_tgid >> 32;
+
+  char comm[MAX_COMM_LEN] = {};
+  bpf_get_current_comm(comm, sizeof(comm));
+
+  // Check MinIO filtering
+  u32 key = 0;
+  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
+  if (config && config->trace_mode != MINIO_TRACE_OFF) {
+    if (!is_minio_process(comm, pid))
+      return false;
+  }
+
+  struct request_context_small *req_ctx =
+      bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+
+  struct detail_event rec;
+  struct io_event_core *event = &rec.core;
+
+  init_event(event, pid_tgid, LAYER_FILESYSTEM, EVENT_FS_METADATA_UPDATE);
+  __builtin_memset(&rec.detail, 0, sizeof(rec.detail));
+  event->size = bytes;
+  event->aligned_size = (bytes + JOURNAL_BLOCK_SIZE - 1) &
+                        ~(u64)(JOURNAL_BLOCK_SIZE - 1);
+  event->dev = dev;
+  event->flags = EVENT_FLAG_METADATA | EVENT_FLAG_JOURNAL | EVENT_EXT_DETAIL;
+  rec.detail.block_count = blocks;
+
+  __builtin_memset(origin, 0, sizeof(*origin));
+  if (req_ctx) {
+    origin_from_request(origin, req_ctx);
+    event->request_id = origin->request_id;
+    event->system_type = origin->system_type;
+    event->flags |= origin->flags;
+  }
+
+  emit_event(&rec, sizeof(rec));
+  return true;
+}
+
+// jbd2_journal_stop(), in the task that held the handle. dirtied_blocks
+// are the metadata blocks it added to the running transaction.
+SEC("tracepoint/jbd2/jbd2_handle_stats")
+int trace_jbd2_handle(void *ctx) {
+  struct trace_event_raw_jbd2_handle_stats___mlio *hctx = ctx;
+  int blocks = BPF_CORE_READ(hctx, dirtied_blocks);
+
+  if (blocks <= 0)
+    return 0;
+
+  struct journal_txn_key txn = {.dev = BPF_CORE_READ(hctx, dev),
+                                .tid = BPF_CORE_READ(hctx, tid)};
+  struct request_origin origin;
+  if (!fs_metadata_emit(txn.dev, (u64)blocks * JOURNAL_BLOCK_SIZE, blocks,
+                        &origin))
+    return 0;
+
+  bpf_map_update_elem(&journal_txns, &txn, &origin, BPF_ANY);
+  return 0;
+}
+
+// End of a jbd2 commit. blocks_logged is what went to the journal
+// area: the metadata blocks plus descriptor and commit blocks.
+SEC("tracepoint/jbd2/jbd2_run_stats")
+int trace_jbd2_commit(void *ctx) {
+  struct trace_event_raw_jbd2_run_stats___mlio *rctx = ctx;
+  struct journal_txn_key txn = {.dev = BPF_CORE_READ(rctx, dev),
+                                .tid = BPF_CORE_READ(rctx, tid)};
+  struct request_origin *origin = bpf_map_lookup_elem(&journal_txns, &txn);
+
+  // Transactions no traced task joined belong to someone else
+  if (!origin && !tracing_everything())
+    return 0;
+
+  struct detail_event rec;
+  struct io_event_core *event = &rec.core;
+  u32 blocks = BPF_CORE_READ(rctx, blocks_logged);
+
+  init_event(event, bpf_get_current_pid_tgid(), LAYER_FILESYSTEM,
+             EVENT_FS_JOURNAL_COMMIT);
+  __builtin_memset(&rec.detail, 0, sizeof(rec.detail));
+  event->size = (u64)blocks * JOURNAL_BLOCK_SIZE;
+  event->aligned_size = event->size;
+  event->dev = txn.dev;
+  event->flags = EVENT_FLAG_JOURNAL | EVENT_EXT_DETAIL;
+  rec.detail.block_count = blocks;
+
+  if (origin) {
+    event->request_id = origin->request_id;
+    event->system_type = origin->system_type;
+    event->flags |= origin->flags | EVENT_FLAG_INHERITED;
+    bpf_map_delete_elem(&journal_txns, &txn);
+  }
+
+  emit_event(&rec, sizeof(rec));
+  return 0;
+}
+
+// XFS charges each transaction to a log ticket; what the commit used of
+// its unit reservation is what it logged into the CIL. Permanent
+// transactions regrant on every roll, the last part ungrants.
+static __always_inline int xfs_log_ticket_done(void *ctx) {
+  struct trace_event_raw_xfs_loggrant_class___mlio *tctx = ctx;
+  int unit = BPF_CORE_READ(tctx, unit_res);
+  int left = BPF_CORE_READ(tctx, curr_res);
+
+  if (unit <= left || left < 0)
+    return 0;
+
+  u64 bytes = unit - left;
+  struct request_origin origin;
+  fs_metadata_emit(BPF_CORE_READ(tctx, dev), bytes,
+                   (bytes + JOURNAL_BLOCK_SIZE - 1) / JOURNAL_BLOCK_SIZE,
+                   &origin);
+  return 0;
+}
+
+SEC("tracepoint/xfs/xfs_log_ticket_ungrant")
+int trace_xfs_log_ungrant(void *ctx) {
+  return xfs_log_ticket_done(ctx);
+}
+
+SEC("tracepoint/xfs/xfs_log_ticket_regrant")
+int trace_xfs_log_regrant(void *ctx) {
+  return xfs_log_ticket_done(ctx);
+}
 
-    init_event(event);
+// ext4 allocates delayed extents when the flusher writes the pages back,
+// which changes the extent tree and the free-space bitmaps of the inode a
+// request dirtied. Counted as one metadata operation; the journal blocks
+// show up in its jbd2 handle.
+SEC("tp_btf/ext4_da_write_pages")
+int BPF_PROG(trace_ext4_da_write_pages, struct inode *inode) {
+  u64 inode_key = (u64)inode;
+  struct request_origin *origin =
+      bpf_map_lookup_elem(&inode_requests, &inode_key);
+  if (!origin && !tracing_everything())
+    return 0;
 
-    event->timestamp = bpf_ktime_get_ns();
-    event->pid = pid;
-    event->tid = (u32)pid_tgid;
-    event->layer = LAYER_STORAGE_SERVICE;
-    event->event_type =
-        is_xl_meta ? EVENT_MINIO_XL_META : EVENT_MINIO_ERASURE_WRITE;
-    event->system_type = SYSTEM_TYPE_MINIO;
-    event->is_minio = 1;
-    event->is_xl_meta = is_xl_meta;
-    event->is_metadata = is_xl_meta;
-    bpf_get_current_comm(event->comm, sizeof(event->comm));
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
 
-// Copy filename to event
-#pragma unroll
-    for (int i = 0; i < MAX_FILENAME_LEN && i < sizeof(event->filename); i++) {
-      event->filename[i] = temp->filename[i];
-    }
+  init_event(event, bpf_get_current_pid_tgid(), LAYER_FILESYSTEM,
+             EVENT_FS_EXTENT_ALLOC);
+  event->flags = EVENT_FLAG_METADATA;
+  event->inode = BPF_CORE_READ(inode, i_ino);
+  event->dev = BPF_CORE_READ(inode, i_sb, s_dev);
 
-    bpf_ringbuf_submit(event, 0);
+  if (origin) {
+    event->request_id = origin->request_id;
+    event->system_type = origin->system_type;
+    event->flags |= origin->flags | EVENT_FLAG_INHERITED;
   }
 
+  emit_event(event, sizeof(*event));
   return 0;
 }
 
 // ============================================================================
-// LAYER 3: OPERATING SYSTEM LAYER - VFS operations
+// OS LAYER: PAGE CACHE - lookups, insertions and writeback
 // ============================================================================
 
-SEC("kprobe/vfs_read")
-int trace_vfs_read(struct pt_regs *ctx) {
-  u64 pid_tgid = bpf_get_current_pid_tgid();
-  u32 pid = pid_tgid >> 32;
-  struct file *file = (struct file *)PT_REGS_PARM1(ctx);
-  size_t count = PT_REGS_PARM3(ctx);
+// Only one of each folio/page pair is loaded, depending on the kernel. On
+// folio kernels mark_page_accessed() is a wrapper, so loading both would
+// count twice.
 
-  char comm[MAX_COMM_LEN] = {};
-  bpf_get_current_comm(comm, sizeof(comm));
+static __always_inline void count_cache_access(void) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+  struct cache_acct *acct = bpf_map_lookup_elem(&cache_acct_map, &pid_tgid);
 
-  // Check MinIO filtering
-  u32 key = 0;
-  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
-  if (config && config->trace_mode != MINIO_TRACE_OFF) {
-    if (!is_minio_process(comm, pid))
-      return 0;
-  }
+  if (acct)
+    acct->accessed++;
+}
 
-  struct request_context_small *req_ctx =
-      bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+SEC("kprobe/folio_mark_accessed")
+int trace_cache_access_folio(struct pt_regs *ctx) {
+  count_cache_access();
+  return 0;
+}
 
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event)
-    return 0;
+SEC("kprobe/mark_page_accessed")
+int trace_cache_access_page(struct pt_regs *ctx) {
+  count_cache_access();
+  return 0;
+}
 
-  init_event(event);
+// Large folios report their order on newer kernels only. Reading it
+// through this flavour keeps the program building against an older
+// vmlinux.h; CO-RE relocates it where the field exists.
+struct trace_event_raw_mm_filemap_op_page_cache___order {
+  unsigned char order;
+} __attribute__((preserve_access_index));
 
-  event->timestamp = bpf_ktime_get_ns();
-  event->pid = pid;
-  event->tid = (u32)pid_tgid;
-  event->layer = LAYER_OPERATING_SYSTEM;
-  event->event_type = EVENT_OS_VFS_READ;
-  event->size = count;
+// Fires for every folio added by add_to_page_cache_lru()/filemap_add_folio()
+SEC("tracepoint/filemap/mm_filemap_add_to_page_cache")
+int trace_cache_insert(struct trace_event_raw_mm_filemap_op_page_cache *ctx) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
+  struct cache_acct *acct = bpf_map_lookup_elem(&cache_acct_map, &pid_tgid);
+  if (!acct)
+    return 0;
 
-  // Try to get inode safely
-  if (file) {
-    struct inode *inode = BPF_CORE_READ(file, f_inode);
-    if (inode) {
-      event->inode = BPF_CORE_READ(inode, i_ino);
-    }
-  }
+  // Other files filled meanwhile, e.g. by a page fault, are not this read
+  if (acct->ino && ctx->i_ino != acct->ino)
+    return 0;
 
-  if (req_ctx) {
-    event->request_id = req_ctx->app_request_id;
-    event->system_type = req_ctx->system_type;
-    event->is_minio = req_ctx->is_minio;
+  struct trace_event_raw_mm_filemap_op_page_cache___order *octx =
+      (void *)ctx;
+  u64 pages = 1;
+  if (bpf_core_field_exists(octx->order)) {
+    u32 order = BPF_CORE_READ(octx, order);
+    if (order < 16)
+      pages <<= order;
   }
 
-  // Calculate aligned size (round up to 4KB page)
-  event->aligned_size = (count + 4095) & ~4095ULL;
+  u64 first = ctx->index, end = first + pages;
+  u64 lo = first > acct->first_page ? first : acct->first_page;
+  u64 hi = end < acct->end_page ? end : acct->end_page;
+  u64 inside = hi > lo ? hi - lo : 0;
 
-  bpf_get_current_comm(event->comm, sizeof(event->comm));
-  bpf_ringbuf_submit(event, 0);
+  acct->miss_bytes += inside * CACHE_PAGE_SIZE;
+  acct->readahead_bytes += (pages - inside) * CACHE_PAGE_SIZE;
   return 0;
 }
 
-SEC("kprobe/vfs_write")
-int trace_vfs_write(struct pt_regs *ctx) {
-  u64 pid_tgid = bpf_get_current_pid_tgid();
-  u32 pid = pid_tgid >> 32;
-  struct file *file = (struct file *)PT_REGS_PARM1(ctx);
-  size_t count = PT_REGS_PARM3(ctx);
+static __always_inline void count_dirtied(void) {
+  struct lat_start_key key = {.pid_tgid = bpf_get_current_pid_tgid(),
+                              .kind = LAT_VFS_WRITE};
 
-  char comm[MAX_COMM_LEN] = {};
-  bpf_get_current_comm(comm, sizeof(comm));
+  // Only pages dirtied from inside a traced vfs_write
+  if (!bpf_map_lookup_elem(&lat_start_times, &key))
+    return;
 
-  // Check MinIO filtering
-  u32 key = 0;
-  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
-  if (config && config->trace_mode != MINIO_TRACE_OFF) {
-    if (!is_minio_process(comm, pid))
-      return 0;
-  }
+  struct cache_stats *cs = get_cache_stats();
+  if (cs)
+    cs->dirtied_pages++;
+}
 
-  struct request_context_small *req_ctx =
-      bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+SEC("tracepoint/writeback/writeback_dirty_folio")
+int trace_dirty_folio(void *ctx) {
+  count_dirtied();
+  return 0;
+}
 
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event)
-    return 0;
+SEC("tracepoint/writeback/writeback_dirty_page")
+int trace_dirty_page(void *ctx) {
+  count_dirtied();
+  return 0;
+}
 
-  init_event(event);
+// Deferred writeback, usually from a flusher kworker. Charged to the
+// request that last dirtied the inode; see inode_requests.
+SEC("tp_btf/writeback_single_inode")
+int BPF_PROG(trace_writeback_inode, struct inode *inode,
+             struct writeback_control *wbc, unsigned long nr_to_write) {
+  long left = BPF_CORE_READ(wbc, nr_to_write);
 
-  event->timestamp = bpf_ktime_get_ns();
-  event->pid = pid;
-  event->tid = (u32)pid_tgid;
-  event->layer = LAYER_OPERATING_SYSTEM;
-  event->event_type = EVENT_OS_VFS_WRITE;
-  event->size = count;
+  if (left < 0 || (unsigned long)left >= nr_to_write)
+    return 0;
 
-  if (file) {
-    struct inode *inode = BPF_CORE_READ(file, f_inode);
-    if (inode) {
-      event->inode = BPF_CORE_READ(inode, i_ino);
-    }
+  u64 inode_key = (u64)inode;
+  struct request_origin *origin =
+      bpf_map_lookup_elem(&inode_requests, &inode_key);
+  if (!origin && !tracing_everything())
+    return 0;
+
+  u64 pages = nr_to_write - left;
+  struct cache_stats *cs = get_cache_stats();
+  if (cs) {
+    cs->writeback_pages += pages;
+    cs->writeback_inodes++;
   }
 
-  if (req_ctx) {
-    event->request_id = req_ctx->app_request_id;
-    event->system_type = req_ctx->system_type;
-    event->is_minio = req_ctx->is_minio;
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
 
-    // For MinIO, track erasure coding amplification
-    if (req_ctx->is_minio && req_ctx->erasure_blocks > 0) {
-      event->erasure_set_index = req_ctx->erasure_blocks;
-    }
-  }
+  init_event(event, bpf_get_current_pid_tgid(), LAYER_FILESYSTEM,
+             EVENT_FS_WRITEBACK);
+  event->size = pages * CACHE_PAGE_SIZE;
+  event->aligned_size = event->size;
+  event->inode = BPF_CORE_READ(inode, i_ino);
+  event->dev = BPF_CORE_READ(inode, i_sb, s_dev);
 
-  // Calculate aligned size
-  event->aligned_size = (count + 4095) & ~4095ULL;
+  if (origin) {
+    event->request_id = origin->request_id;
+    event->system_type = origin->system_type;
+    event->flags |= origin->flags | EVENT_FLAG_INHERITED;
+  }
 
-  bpf_get_current_comm(event->comm, sizeof(event->comm));
-  bpf_ringbuf_submit(event, 0);
+  emit_event(event, sizeof(*event));
   return 0;
 }
 
 // ============================================================================
-// LAYER 4: FILESYSTEM LAYER - Track sync operations
+// MinIO-specific splice tracking (for multipart uploads)
 // ============================================================================
 
-SEC("kprobe/vfs_fsync_range")
-int trace_fs_sync(struct pt_regs *ctx) {
+static __always_inline int minio_splice(size_t len) {
   u64 pid_tgid = bpf_get_current_pid_tgid();
+
+  if (!task_targeted(pid_tgid))
+    return 0;
+
   u32 pid = pid_tgid >> 32;
 
   char comm[MAX_COMM_LEN] = {};
   bpf_get_current_comm(comm, sizeof(comm));
 
-  // Check MinIO filtering
-  u32 key = 0;
-  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
-  if (config && config->trace_mode != MINIO_TRACE_OFF) {
-    if (!is_minio_process(comm, pid))
-      return 0;
-  }
-
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event)
+  if (!is_minio_process(comm, pid))
     return 0;
 
-  init_event(event);
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
 
-  event->timestamp = bpf_ktime_get_ns();
-  event->pid = pid;
-  event->tid = (u32)pid_tgid;
-  event->layer = LAYER_FILESYSTEM;
-  event->event_type = EVENT_FS_SYNC;
-  event->size = 0;
-  event->aligned_size = 0;
-  event->is_metadata = 1; // Sync is metadata operation
-  event->is_journal = 0;
-  event->is_minio = is_minio_process(comm, pid);
+  init_event(event, pid_tgid, LAYER_STORAGE_SERVICE, EVENT_MINIO_MULTIPART);
+  event->system_type = SYSTEM_TYPE_MINIO;
+  event->size = len;
+  event->flags = EVENT_FLAG_MINIO;
+
+  emit_event(event, sizeof(*event));
 
-  bpf_get_current_comm(event->comm, sizeof(event->comm));
-  bpf_ringbuf_submit(event, 0);
   return 0;
 }
 
-// ============================================================================
-// MinIO-specific splice tracking (for multipart uploads)
-// ============================================================================
-
+// do_splice_direct(in, ppos, out, opos, len, flags)
 SEC("kprobe/do_splice_direct")
 int trace_minio_splice(struct pt_regs *ctx) {
-  u64 pid_tgid = bpf_get_current_pid_tgid();
-  u32 pid = pid_tgid >> 32;
+  return minio_splice(PT_REGS_PARM5(ctx));
+}
 
-  char comm[MAX_COMM_LEN] = {};
-  bpf_get_current_comm(comm, sizeof(comm));
+SEC("fentry/do_splice_direct")
+int BPF_PROG(fentry_minio_splice, struct file *in, loff_t *ppos,
+             struct file *out, loff_t *opos, size_t len) {
+  return minio_splice(len);
+}
 
-  if (!is_minio_process(comm, pid))
-    return 0;
+// ============================================================================
+// LAYER 2: STORAGE SERVICE LAYER - MinIO Go uprobes
+// ============================================================================
 
-  loff_t len = PT_REGS_PARM3(ctx);
+// Attached by userspace (-E/-T) to functions in the MinIO binary, one link
+// per function. The BPF cookie says what to emit:
+//   bits 0-15   event type
+//   bits 16-23  Go argument register holding the byte count
+//   bits 24-31  Go argument register holding an *Erasure
+// Go >= 1.17 passes integer arguments in the registers below, in order.
+// Only entry probes: uretprobes break when a goroutine stack is moved.
+#define GO_ARG_NONE 0xff
+
+static __always_inline u64 go_arg(struct pt_regs *ctx, u32 n) {
+#if defined(__TARGET_ARCH_x86)
+  switch (n) {
+  case 0:
+    return ctx->ax;
+  case 1:
+    return ctx->bx;
+  case 2:
+    return ctx->cx;
+  case 3:
+    return ctx->di;
+  case 4:
+    return ctx->si;
+  case 5:
+    return ctx->r8;
+  case 6:
+    return ctx->r9;
+  case 7:
+    return ctx->r10;
+  case 8:
+    return ctx->r11;
+  }
+#elif defined(__TARGET_ARCH_arm64)
+  struct user_pt_regs *regs = (struct user_pt_regs *)ctx;
+  switch (n) {
+  case 0:
+    return regs->regs[0];
+  case 1:
+    return regs->regs[1];
+  case 2:
+    return regs->regs[2];
+  case 3:
+    return regs->regs[3];
+  case 4:
+    return regs->regs[4];
+  case 5:
+    return regs->regs[5];
+  case 6:
+    return regs->regs[6];
+  case 7:
+    return regs->regs[7];
+  case 8:
+    return regs->regs[8];
+  }
+#endif
+  return 0;
+}
+
+// cmd.Erasure in MinIO's erasure-coding.go
+struct go_erasure {
+  u64 encoder; // func() reedsolomon.Encoder
+  s64 data_blocks;
+  s64 parity_blocks;
+  s64 block_size;
+};
+
+SEC("uprobe")
+int trace_minio_go(struct pt_regs *ctx) {
+  u64 pid_tgid = bpf_get_current_pid_tgid();
 
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event)
+  if (!task_targeted(pid_tgid))
     return 0;
 
-  init_event(event);
+  u64 cookie = bpf_get_attach_cookie(ctx);
+  u32 event_type = cookie & 0xffff;
+  u32 size_reg = (cookie >> 16) & 0xff;
+  u32 erasure_reg = (cookie >> 24) & 0xff;
 
-  event->timestamp = bpf_ktime_get_ns();
-  event->pid = pid;
-  event->tid = (u32)pid_tgid;
-  event->layer = LAYER_STORAGE_SERVICE;
-  event->event_type = EVENT_MINIO_MULTIPART;
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
+
+  init_event(event, pid_tgid, LAYER_STORAGE_SERVICE, event_type);
   event->system_type = SYSTEM_TYPE_MINIO;
-  event->size = len;
-  event->is_minio = 1;
+  event->flags = EVENT_FLAG_MINIO;
+  if (size_reg != GO_ARG_NONE)
+    event->size = go_arg(ctx, size_reg);
+
+  struct go_erasure er = {};
+  void *erasure =
+      erasure_reg != GO_ARG_NONE ? (void *)go_arg(ctx, erasure_reg) : NULL;
+  if (erasure && bpf_probe_read_user(&er, sizeof(er), erasure) == 0 &&
+      er.data_blocks > 0 && er.parity_blocks >= 0) {
+    // Decoding reports no length, it works one block at a time
+    if (size_reg == GO_ARG_NONE)
+      event->size = er.block_size;
+    // Encoding turns the data into data + parity shards of equal size
+    if (event_type == EVENT_MINIO_ERASURE_WRITE && er.parity_blocks > 0) {
+      event->aligned_size = event->size *
+                            (u64)(er.data_blocks + er.parity_blocks) /
+                            (u64)er.data_blocks;
+      event->flags |= EVENT_FLAG_PARITY;
+    }
+  }
+  if (event_type == EVENT_MINIO_METADATA_UPDATE)
+    event->flags |= EVENT_FLAG_METADATA;
 
-  bpf_get_current_comm(event->comm, sizeof(event->comm));
-  bpf_ringbuf_submit(event, 0);
+  // Goroutines migrate between threads, so this is the request of the
+  // last syscall on this thread: right for synchronous handlers only
+  struct request_context_small *req_ctx =
+      bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+  if (req_ctx)
+    event->request_id = req_ctx->app_request_id;
 
+  emit_event(event, sizeof(*event));
   return 0;
 }
 
@@ -626,41 +2489,54 @@ int trace_minio_splice(struct pt_regs *ctx) {
 // LAYER 5: DEVICE LAYER - Block I/O
 // ============================================================================
 
-SEC("kprobe/submit_bio")
-int trace_bio_submit(struct pt_regs *ctx) {
+// Writes are attributed to the request that dirtied the pages, whichever
+// thread submits them. Reads are submitted synchronously by the reader, so
+// they keep the submitting thread's request.
+static __always_inline int bio_submit(struct bio *bio) {
   u64 pid_tgid = bpf_get_current_pid_tgid();
   u32 pid = pid_tgid >> 32;
-  struct bio *bio = (struct bio *)PT_REGS_PARM1(ctx);
 
   if (!bio)
     return 0;
 
-  char comm[MAX_COMM_LEN] = {};
-  bpf_get_current_comm(comm, sizeof(comm));
+  // op_is_write(): the odd REQ_OP_* values carry data to the device
+  bool is_write = BPF_CORE_READ(bio, bi_opf) & 1;
+  struct inode *inode = NULL;
+  if (is_write || track_objects)
+    inode = bio_inode(bio);
 
-  // Check MinIO filtering
-  u32 key = 0;
-  struct minio_config *config = bpf_map_lookup_elem(&minio_config_map, &key);
-  if (config && config->trace_mode != MINIO_TRACE_OFF) {
-    if (!is_minio_process(comm, pid))
+  struct request_origin *dirtied_by = NULL;
+  if (is_write && inode) {
+    u64 inode_key = (u64)inode;
+    dirtied_by = bpf_map_lookup_elem(&inode_requests, &inode_key);
+  }
+
+  // A tracked inode already passed the filters when it was dirtied
+  if (!dirtied_by) {
+    if (!task_targeted(pid_tgid))
       return 0;
+
+    char comm[MAX_COMM_LEN] = {};
+    bpf_get_current_comm(comm, sizeof(comm));
+
+    // Check MinIO filtering
+    u32 key = 0;
+    struct minio_config *config =
+        bpf_map_lookup_elem(&minio_config_map, &key);
+    if (config && config->trace_mode != MINIO_TRACE_OFF) {
+      if (!is_minio_process(comm, pid))
+        return 0;
+    }
   }
 
   struct request_context_small *req_ctx =
       bpf_map_lookup_elem(&request_tracking, &pid_tgid);
+  struct bio_info info = {};
 
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event)
-    return 0;
-
-  init_event(event);
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
 
-  event->timestamp = bpf_ktime_get_ns();
-  event->pid = pid;
-  event->tid = (u32)pid_tgid;
-  event->layer = LAYER_DEVICE;
-  event->event_type = EVENT_DEV_BIO_SUBMIT;
+  init_event(event, pid_tgid, LAYER_DEVICE, EVENT_DEV_BIO_SUBMIT);
 
   // Safely read bio fields
   unsigned int bi_size = BPF_CORE_READ(bio, bi_iter.bi_size);
@@ -669,68 +2545,280 @@ int trace_bio_submit(struct pt_regs *ctx) {
   event->size = bi_size;
   event->aligned_size = bi_size;   // Block I/O is already aligned
   event->offset = bi_sector * 512; // Convert sectors to bytes
+  account_object(inode, 0, 0, bi_size);
 
   // Get device info
   struct block_device *bdev = BPF_CORE_READ(bio, bi_bdev);
   if (bdev) {
-    dev_t dev = BPF_CORE_READ(bdev, bd_dev);
-    event->dev_major = dev >> 20;
-    event->dev_minor = dev & 0xFFFFF;
+    event->dev = BPF_CORE_READ(bdev, bd_dev);
   }
 
-  if (req_ctx) {
-    event->request_id = req_ctx->app_request_id;
-    event->system_type = req_ctx->system_type;
-    event->is_minio = req_ctx->is_minio;
+  if (dirtied_by) {
+    info.origin = *dirtied_by;
+    if (!req_ctx || req_ctx->app_request_id != dirtied_by->request_id)
+      info.origin.flags |= EVENT_FLAG_INHERITED;
+  } else if (req_ctx) {
+    origin_from_request(&info.origin, req_ctx);
   }
 
-  bpf_get_current_comm(event->comm, sizeof(event->comm));
-  bpf_ringbuf_submit(event, 0);
+  event->request_id = info.origin.request_id;
+  event->system_type = info.origin.system_type;
+  event->flags |= info.origin.flags;
+
+  emit_event(event, sizeof(*event));
 
   // Track bio for completion
   u64 bio_addr = (u64)bio;
-  u64 start_time = bpf_ktime_get_ns();
-  bpf_map_update_elem(&io_start_times, &bio_addr, &start_time, BPF_ANY);
+  info.start_ns = bpf_ktime_get_ns();
+  bpf_map_update_elem(&bio_inflight, &bio_addr, &info, BPF_ANY);
 
   return 0;
 }
 
-SEC("kprobe/bio_endio")
-int trace_bio_complete(struct pt_regs *ctx) {
-  struct bio *bio = (struct bio *)PT_REGS_PARM1(ctx);
+SEC("kprobe/submit_bio")
+int trace_bio_submit(struct pt_regs *ctx) {
+  return bio_submit((struct bio *)PT_REGS_PARM1(ctx));
+}
+
+SEC("fentry/submit_bio")
+int BPF_PROG(fentry_bio_submit, struct bio *bio) {
+  return bio_submit(bio);
+}
 
+static __always_inline int bio_complete(struct bio *bio) {
   if (!bio)
     return 0;
 
   u64 bio_addr = (u64)bio;
 
-  u64 *start_time = bpf_map_lookup_elem(&io_start_times, &bio_addr);
-  if (!start_time)
+  struct bio_info *info = bpf_map_lookup_elem(&bio_inflight, &bio_addr);
+  if (!info)
     return 0;
 
-  u64 latency = bpf_ktime_get_ns() - *start_time;
-
-  struct multilayer_io_event *event =
-      bpf_ringbuf_reserve(&events, sizeof(struct multilayer_io_event), 0);
-  if (!event) {
-    bpf_map_delete_elem(&io_start_times, &bio_addr);
-    return 0;
-  }
+  u64 latency = bpf_ktime_get_ns() - info->start_ns;
 
-  init_event(event);
+  struct io_event_core rec;
+  struct io_event_core *event = &rec;
 
+  // Completions run in interrupt context, so the task fields are not
+  // meaningful here
+  __builtin_memset(event, 0, sizeof(struct io_event_core));
   event->timestamp = bpf_ktime_get_ns();
   event->layer = LAYER_DEVICE;
   event->event_type = EVENT_DEV_BIO_COMPLETE;
   event->latency_ns = latency;
+  event->request_id = info->origin.request_id;
+  event->system_type = info->origin.system_type;
+  event->flags = info->origin.flags;
+  record_latency(LAT_BIO, latency);
 
   unsigned int bi_size = BPF_CORE_READ(bio, bi_iter.bi_size);
   event->size = bi_size;
   event->aligned_size = bi_size;
 
-  bpf_ringbuf_submit(event, 0);
-  bpf_map_delete_elem(&io_start_times, &bio_addr);
+  emit_event(event, sizeof(*event));
+  bpf_map_delete_elem(&bio_inflight, &bio_addr);
+
+  return 0;
+}
+
+SEC("kprobe/bio_endio")
+int trace_bio_complete(struct pt_regs *ctx) {
+  return bio_complete((struct bio *)PT_REGS_PARM1(ctx));
+}
+
+SEC("fentry/bio_endio")
+int BPF_PROG(fentry_bio_complete, struct bio *bio) {
+  return bio_complete(bio);
+}
+
+// ============================================================================
+// LAYER 5: DEVICE LAYER - Request queue (block_rq tracepoints)
+// ============================================================================
+
+static __always_inline struct device_stats *get_device_stats(u32 dev) {
+  struct device_stats *ds = bpf_map_lookup_elem(&device_stats_map, &dev);
+  if (ds)
+    return ds;
+
+  struct device_stats zero = {};
+  bpf_map_update_elem(&device_stats_map, &dev, &zero, BPF_NOEXIST);
+  return bpf_map_lookup_elem(&device_stats_map, &dev);
+}
+
+// rwbs is the blktrace operation string, e.g. "WS" or "R"
+static __always_inline u32 rwbs_is_write(const char *rwbs) {
+  return rwbs[0] == 'W' || (rwbs[0] == 'F' && rwbs[1] == 'W');
+}
+
+SEC("tracepoint/block/block_rq_issue")
+int trace_rq_issue(struct trace_event_raw_block_rq *ctx) {
+  struct rq_key key = {.sector = ctx->sector, .dev = ctx->dev};
+  struct rq_info info = {};
+
+  info.issue_ns = bpf_ktime_get_ns();
+  info.bytes = ctx->bytes;
+  info.is_write = rwbs_is_write(ctx->rwbs);
+
+  // A re-issue of a request already known, whether after a requeue or not,
+  // is the same I/O: it only goes back in flight if it had been requeued
+  struct rq_info *prev = bpf_map_lookup_elem(&rq_inflight, &key);
+  bool reissue = prev != NULL;
+  bool requeued = prev && prev->requeued;
+  if (bpf_map_update_elem(&rq_inflight, &key, &info, BPF_ANY) != 0)
+    return 0;
+
+  struct device_stats *ds = get_device_stats(ctx->dev);
+  if (!ds)
+    return 0;
+
+  if (requeued)
+    __sync_fetch_and_add(&ds->inflight, 1);
+  if (reissue)
+    return 0;
+
+  s64 depth = __sync_fetch_and_add(&ds->inflight, 1) + 1;
+  __sync_fetch_and_add(&ds->issued, 1);
+  __sync_fetch_and_add(&ds->depth_sum, depth);
+
+  u64 *max = bpf_map_lookup_elem(&device_max_depth, &key.dev);
+  if (!max) {
+    u64 zero = 0;
+    bpf_map_update_elem(&device_max_depth, &key.dev, &zero, BPF_NOEXIST);
+    max = bpf_map_lookup_elem(&device_max_depth, &key.dev);
+  }
+  if (max && depth > 0 && (u64)depth > *max)
+    *max = depth;
+  return 0;
+}
+
+SEC("tracepoint/block/block_rq_complete")
+int trace_rq_complete(struct trace_event_raw_block_rq_completion *ctx) {
+  struct rq_key key = {.sector = ctx->sector, .dev = ctx->dev};
+  struct rq_info *info = bpf_map_lookup_elem(&rq_inflight, &key);
+
+  // Requests issued before the tracer started have no entry
+  if (!info)
+    return 0;
+
+  u64 service = bpf_ktime_get_ns() - info->issue_ns;
+  u32 bytes = info->bytes;
+  u32 is_write = info->is_write;
+  bool requeued = info->requeued;
+  bpf_map_delete_elem(&rq_inflight, &key);
+
+  record_latency(LAT_DEVICE, service);
+
+  struct device_stats *ds = get_device_stats(ctx->dev);
+  if (!ds)
+    return 0;
+
+  if (!requeued)
+    __sync_fetch_and_add(&ds->inflight, -1);
+  __sync_fetch_and_add(&ds->completed, 1);
+  __sync_fetch_and_add(&ds->service_ns, service);
+  if (is_write)
+    __sync_fetch_and_add(&ds->write_bytes, bytes);
+  else
+    __sync_fetch_and_add(&ds->read_bytes, bytes);
+  if (ctx->error)
+    __sync_fetch_and_add(&ds->errors, 1);
+  return 0;
+}
+
+SEC("tracepoint/block/block_rq_requeue")
+int trace_rq_requeue(struct trace_event_raw_block_rq *ctx) {
+  struct rq_key key = {.sector = ctx->sector, .dev = ctx->dev};
+  struct rq_info *info = bpf_map_lookup_elem(&rq_inflight, &key);
+
+  // Kept, so the coming re-issue is recognised and not counted again
+  if (!info || info->requeued)
+    return 0;
+  info->requeued = 1;
+
+  struct device_stats *ds = get_device_stats(ctx->dev);
+  if (!ds)
+    return 0;
+
+  __sync_fetch_and_add(&ds->inflight, -1);
+  __sync_fetch_and_add(&ds->requeues, 1);
+  return 0;
+}
+
+SEC("tracepoint/block/block_bio_backmerge")
+int trace_bio_backmerge(struct trace_event_raw_block_bio_merge *ctx) {
+  struct device_stats *ds = get_device_stats(ctx->dev);
+  if (ds)
+    __sync_fetch_and_add(&ds->back_merges, 1);
+  return 0;
+}
+
+SEC("tracepoint/block/block_bio_frontmerge")
+int trace_bio_frontmerge(struct trace_event_raw_block_bio_merge *ctx) {
+  struct device_stats *ds = get_device_stats(ctx->dev);
+  if (ds)
+    __sync_fetch_and_add(&ds->front_merges, 1);
+  return 0;
+}
+
+// ============================================================================
+// MinIO process discovery - sched_process tracepoints
+// ============================================================================
+
+// Only loaded in PID mode (-A or -p). Children of a tracked process are
+// tracked too, so MinIO workers and helpers are covered from their first
+// I/O without userspace having to rescan.
+
+static __always_inline bool is_minio_comm(const char *comm) {
+  return comm[0] == 'm' && comm[1] == 'i' && comm[2] == 'n' &&
+         comm[3] == 'i' && comm[4] == 'o' && comm[5] == '\0';
+}
+
+SEC("tp_btf/sched_process_exec")
+int BPF_PROG(trace_minio_exec, struct task_struct *p, pid_t old_pid,
+             struct linux_binprm *bprm) {
+  char comm[MAX_COMM_LEN];
+  u32 tgid;
+  u8 one = 1;
+
+  if (!minio_discovery)
+    return 0;
+
+  // comm already holds the new image name here
+  BPF_CORE_READ_STR_INTO(&comm, p, comm);
+  if (!is_minio_comm(comm))
+    return 0;
+
+  tgid = BPF_CORE_READ(p, tgid);
+  bpf_map_update_elem(&minio_pids, &tgid, &one, BPF_ANY);
+  return 0;
+}
+
+SEC("tp_btf/sched_process_fork")
+int BPF_PROG(trace_minio_fork, struct task_struct *parent,
+             struct task_struct *child) {
+  u32 parent_tgid = BPF_CORE_READ(parent, tgid);
+  u32 child_tgid = BPF_CORE_READ(child, tgid);
+  u8 one = 1;
+
+  // New threads share the parent's tgid and are already covered
+  if (parent_tgid == child_tgid)
+    return 0;
+
+  if (bpf_map_lookup_elem(&minio_pids, &parent_tgid))
+    bpf_map_update_elem(&minio_pids, &child_tgid, &one, BPF_ANY);
+  return 0;
+}
+
+SEC("tp_btf/sched_process_exit")
+int BPF_PROG(trace_minio_exit, struct task_struct *p) {
+  u32 tgid = BPF_CORE_READ(p, tgid);
+
+  // Fires once per thread; the entry goes with the group leader
+  if (BPF_CORE_READ(p, pid) != tgid)
+    return 0;
 
+  bpf_map_delete_elem(&minio_pids, &tgid);
   return 0;
 }
 
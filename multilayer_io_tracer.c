@@ -1,74 +1,99 @@
 // Enhanced Multi-Layer I/O Tracer with MinIO-specific tracking - Userspace
 // program File: multilayer_io_tracer.c
 
+#define _GNU_SOURCE // pthread_setaffinity_np, CPU_SET
 #include <argp.h>
 #include <bpf/bpf.h>
 #include <bpf/libbpf.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 // Include the auto-generated skeleton
+#include "cluster_agent.h"
+#include "column_file.h"
+#include "http_exporter.h"
 #include "multilayer_io_tracer.skel.h"
+#include "request_table.h"
+#include "spsc_queue.h"
+#include "stream_writer.h"
+#include "trace_file.h"
+#include "tracer_events.h"
 
 #define MAX_COMM_LEN 16
 #define MAX_FILENAME_LEN 256
 #define MAX_BUCKET_NAME_LEN 64
 
-// Layer definitions (must match BPF program)
-#define LAYER_APPLICATION 1
-#define LAYER_STORAGE_SERVICE 2
-#define LAYER_OPERATING_SYSTEM 3
-#define LAYER_FILESYSTEM 4
-#define LAYER_DEVICE 5
-
 // MinIO tracking modes
 #define MINIO_TRACE_OFF 0
 #define MINIO_TRACE_NAME 1
 #define MINIO_TRACE_PID 2
 #define MINIO_TRACE_ALL 3
 
-// Must match the BPF program's struct exactly
-struct multilayer_io_event {
+// Event flags (must match BPF program)
+#define EVENT_FLAG_METADATA (1 << 0)
+#define EVENT_FLAG_JOURNAL (1 << 1)
+#define EVENT_FLAG_CACHE_HIT (1 << 2)
+#define EVENT_FLAG_MINIO (1 << 3)
+#define EVENT_FLAG_XL_META (1 << 4)
+#define EVENT_FLAG_PARITY (1 << 5)
+#define EVENT_FLAG_INHERITED (1 << 7) // request_id taken from the inode
+
+// Optional payload sections, in the order they follow the core
+#define EVENT_EXT_DETAIL (1 << 8)
+#define EVENT_EXT_BUCKET (1 << 9)
+#define EVENT_EXT_FILENAME (1 << 10)
+
+// Must match the BPF program's structs exactly
+struct io_event_core {
   __u64 timestamp;
-  __u32 pid;
-  __u32 tid;
-  __u8 layer;
-  __u32 event_type;
-  __u32 system_type;
   __u64 size;
+  __u64 aligned_size;
   __u64 offset;
   __u64 latency_ns;
-  __u32 dev_major;
-  __u32 dev_minor;
-  __s32 retval;
   __u64 inode;
   __u64 request_id;
+  __u32 pid;
+  __u32 tid;
+  __u32 event_type;
+  __u32 dev;
+  __s32 retval;
+  __u16 flags;
+  __u8 layer;
+  __u8 system_type;
   char comm[MAX_COMM_LEN];
-  char filename[MAX_FILENAME_LEN];
-  __u64 aligned_size;
+};
+
+struct io_event_detail {
   __u32 replication_count;
   __u32 block_count;
-  __u8 is_metadata;
-  __u8 is_journal;
-  __u8 cache_hit;
-
-  // MinIO-specific fields
   __u32 erasure_set_index;
   __u32 erasure_block_index;
-  __u8 is_parity_block;
-  __u8 is_xl_meta;
   __u32 object_part_number;
-  char bucket_name[MAX_BUCKET_NAME_LEN];
-  __u8 is_minio;
+  __u32 _pad;
+};
+
+// Decoded view of one variable-length ring buffer record. Absent payload
+// sections point at zeroed/empty defaults so callers need no NULL checks.
+struct event_view {
+  const struct io_event_core *core;
+  const struct io_event_detail *detail;
+  const char *bucket_name;
+  const char *filename;
 };
 
 struct minio_config {
@@ -78,12 +103,164 @@ struct minio_config {
   __u8 verbose;
 };
 
-// Storage system types
-const char *system_names[] = {"Unknown",    "MinIO",     "Ceph",       "etcd",
-                              "PostgreSQL", "GlusterFS", "Application"};
+#define SAMPLE_LAYERS 6
+#define EVENT_FLAG_SAMPLED (1 << 6)
+
+struct tracer_config {
+  __u8 aggregate;
+  __u8 skip_events;
+  __u8 sharded;
+  __u8 per_process;
+  __u8 paused;
+  __u32 budget_per_cpu;
+  __u32 sample_rate[SAMPLE_LAYERS];
+  __u32 wakeup_bytes;
+};
+
+struct sample_counts {
+  __u64 seen;
+  __u64 emitted;
+  __u64 ring_drops;
+};
+
+// Failed ring reservations per event slot (must match BPF program)
+struct ring_drop {
+  __u64 drops;
+  __u32 event_type;
+  __u32 _pad;
+};
+
+// Sharded event stream layout (must match BPF program)
+#define MAX_RING_SHARDS 64
+#define MAX_CPUS 1024
+#define RING_SHARD_SIZE (512 * 1024)
+
+// Early task filter (must match BPF program)
+#define FILTER_TGID (1 << 0)
+#define FILTER_CGROUP (1 << 1)
+#define MAX_FILTER_TARGETS 64
+
+#define SHARD_NONE 0
+#define SHARD_PER_CPU 1
+#define SHARD_PER_NODE 2
+
+// Extra ring_buffer__consume passes a drain thread makes after a wakeup
+#define DRAIN_CONSUME_PASSES 4
+
+// Output thread backoff while the queues are empty
+#define IDLE_SLEEP_MIN_US 50
+#define IDLE_SLEEP_MAX_US 1000
+
+// In-kernel aggregation layout (must match BPF program)
+#define AGG_LAYERS 6
+#define AGG_EVENT_SLOTS 32
+#define AGG_SYSTEM_SLOTS 8
+#define AGG_ENTRIES (AGG_LAYERS * AGG_EVENT_SLOTS * AGG_SYSTEM_SLOTS)
+
+struct layer_agg {
+  __u64 events;
+  __u64 bytes;
+  __u64 aligned_bytes;
+  __u64 latency_ns;
+  __u64 metadata_ops;
+  __u64 journal_ops;
+  __u64 cache_hits;
+  __u64 minio_events;
+  __u64 minio_bytes;
+  __u64 xl_meta_ops;
+  __u32 event_type;
+  __u32 _pad;
+};
+
+// Per-process exporter totals (must match BPF program)
+#define MAX_TRACKED_PROCS 8192
+
+struct process_agg_key {
+  __u32 tgid;
+  __u32 layer;
+};
+
+struct process_agg {
+  __u64 events;
+  __u64 bytes;
+};
+
+// Per-object amplification table (must match BPF program)
+#define MAX_TRACKED_OBJECTS 65536
+#define MAX_TOP_OBJECTS 1000
+
+struct object_key {
+  __u64 ino;
+  __u32 dev;
+  __u32 _pad;
+};
+
+struct object_stats {
+  __u64 app_bytes;
+  __u64 vfs_bytes;
+  __u64 device_bytes;
+};
+
+// Object paths, resolved once per inode (must match BPF program)
+struct inode_path {
+  char path[MAX_FILENAME_LEN];
+};
+
+// Latency histogram kinds and layout (must match BPF program)
+#define LAT_SYSCALL_READ 0
+#define LAT_SYSCALL_WRITE 1
+#define LAT_VFS_READ 2
+#define LAT_VFS_WRITE 3
+#define LAT_FSYNC 4
+#define LAT_BIO 5
+#define LAT_DEVICE 6
+#define LAT_KINDS 7
+
+#define LAT_SUB_BUCKET_BITS 2
+#define LAT_SLOTS 160
+
+struct latency_hist {
+  __u64 count;
+  __u64 sum_ns;
+  __u64 slots[LAT_SLOTS];
+};
+
+const char *latency_names[LAT_KINDS] = {
+    "read(2)", "write(2)", "vfs_read", "vfs_write", "fsync", "bio", "device"};
+
+// Same kinds as exported metric label values
+const char *latency_labels[LAT_KINDS] = {
+    "syscall_read", "syscall_write", "vfs_read", "vfs_write",
+    "fsync",        "bio",           "device"};
+
+// Per-device block request counters (must match BPF program)
+#define MAX_DEVICES 256
+
+struct device_stats {
+  __u64 issued;
+  __u64 completed;
+  __u64 read_bytes;
+  __u64 write_bytes;
+  __u64 service_ns;
+  __u64 depth_sum;
+  __u64 back_merges;
+  __u64 front_merges;
+  __u64 requeues;
+  __u64 errors;
+  __s64 inflight;
+  __u64 max_depth; // From device_max_depth, see read_device_stats()
+};
+
+// Buffered write, readahead and writeback counters (must match BPF
+// program)
+struct cache_stats {
+  __u64 dirtied_pages;
+  __u64 writeback_pages;
+  __u64 writeback_inodes;
+  __u64 readahead_pages;
+};
 
-const char *layer_names[] = {"UNKNOWN", "APPLICATION", "STORAGE_SVC",
-                             "OS",      "FILESYSTEM",  "DEVICE"};
+#define CACHE_PAGE_SIZE 4096
 
 // Per-layer statistics
 struct layer_stats {
@@ -92,8 +269,13 @@ struct layer_stats {
   __u64 aligned_bytes;
   __u64 metadata_ops;
   __u64 journal_ops;
-  __u64 cache_hits;
-  __u64 cache_misses;
+  __u64 cache_hits;   // Buffered reads served from the page cache
+  __u64 cache_misses; // Buffered reads that filled the page cache
+  __u64 cache_read_bytes;
+  __u64 cache_fill_bytes;
+  __u64 writeback_bytes;
+  __u64 journal_bytes; // Written to the jbd2 journal by its commits
+  __u64 mmap_bytes; // Data pages faulted in through file mappings
   __u64 total_latency;
   double amplification_factor;
 
@@ -115,6 +297,10 @@ struct minio_stats {
   __u64 total_erasure_amplification;
   __u64 metadata_bytes;
   __u64 data_bytes;
+  __u64 encoded_bytes; // Erasure encode input, from the -E uprobes
+  __u64 parity_bytes;
+  __u64 decoded_bytes;
+  __u64 bitrot_bytes; // Shard bytes hashed, kept out of the layer totals
   double erasure_overhead_factor;
 };
 
@@ -126,6 +312,10 @@ struct request_stats {
   __u64 os_size;
   __u64 fs_size;
   __u64 device_size;
+  __u64 async_device_size; // Submitted off the requesting thread
+  __u64 cache_read_bytes;
+  __u64 cache_fill_bytes;
+  __u64 writeback_bytes;
   __u32 replication_factor;
   __u32 journal_blocks;
   __u64 total_amplification;
@@ -138,10 +328,39 @@ static struct minio_stats minio_stats = {0};
 static struct env {
   bool verbose;
   bool json_output;
+  bool compress;
   bool realtime;
   bool correlation_mode;
+  bool aggregate;
+  bool live;
+  int interval;
+  int max_requests;
+  int request_max_age;
+  int queue_mb;
+  int shard_mode;
+  int sample_rate[SAMPLE_LAYERS]; // 1 in N per layer, 0 = not sampled
+  int budget;                     // Streamed events/sec, 0 = unlimited
+  bool adaptive;
+  int wakeup_kb; // Wake the drain threads per KB pending, 0 = every event
+  int wakeup_ms; // Poll period bounding the delay of batched events
+  bool force_kprobes;
+  unsigned int layers; // Bit 1 << layer per layer to load probes for, 0 = all
+  const char *pin_dir;
+  int top_objects;     // Objects to report, 0 = no per-object table
+  bool objects_by_amp; // Rank by device/app ratio instead of device bytes
+
+  // Early task filter
+  __u32 target_tgids[MAX_FILTER_TARGETS];
+  int num_target_tgids;
+  const char *target_cgroups[MAX_FILTER_TARGETS];
+  int num_target_cgroups;
   int duration;
   const char *output_file;
+  const char *capture_file;
+  const char *columns_file;
+  const char *replay_file;
+  const char *exporter_addr;
+  const char *agent_addr;
   const char *trace_system;
 
   // MinIO-specific options
@@ -152,13 +371,26 @@ static struct env {
   bool trace_erasure;
   bool trace_metadata;
   int minio_port;
+  const char *minio_binary;
 } env = {
     .verbose = false,
     .json_output = false,
+    .compress = false,
     .realtime = true,
     .correlation_mode = false,
+    .aggregate = false,
+    .interval = 1,
+    .max_requests = REQUEST_TABLE_DEFAULT_MAX,
+    .request_max_age = REQUEST_TABLE_DEFAULT_AGE_SEC,
+    .queue_mb = 64,
+    .shard_mode = SHARD_NONE,
+    .wakeup_ms = 10,
     .duration = 0,
     .output_file = NULL,
+    .capture_file = NULL,
+    .columns_file = NULL,
+    .replay_file = NULL,
+    .exporter_addr = NULL,
     .trace_system = NULL,
     .minio_only = false,
     .auto_detect_minio = false,
@@ -174,8 +406,65 @@ static const struct argp_option opts[] = {
     {"json", 'j', NULL, 0, "Output in JSON format"},
     {"duration", 'd', "DURATION", 0, "Trace for specified duration (seconds)"},
     {"output", 'o', "FILE", 0, "Output to file instead of stdout"},
+    {"gzip", 'z', NULL, 0, "Gzip-compress the output (use with -o)"},
+    {"write", 'w', "FILE", 0,
+     "Capture raw events to a binary file (implies -q)"},
+    {"replay", 'r', "FILE", 0,
+     "Replay a capture file written with -w instead of tracing"},
+    {"columns", 'W', "FILE", 0,
+     "Export events as columns for the Python analysis scripts (implies -q, "
+     "works with -r)"},
     {"quiet", 'q', NULL, 0, "Disable real-time output, only show summary"},
     {"correlate", 'c', NULL, 0, "Enable request correlation mode"},
+    {"aggregate", 'a', NULL, 0,
+     "Aggregate per-layer statistics in kernel, do not stream events"},
+    {"live", 'V', NULL, 0,
+     "Show amplification, layer throughput and latency percentiles over "
+     "the last 1, 10 and 60 seconds every interval (implies -a)"},
+    {"interval", 'i', "SECONDS", 0,
+     "Aggregation read interval (default: 1 second)"},
+    {"exporter", 'X', "[ADDR]:PORT", 0,
+     "Serve Prometheus metrics from the in-kernel totals on ADDR:PORT, "
+     "e.g. :9435 (implies -a)"},
+    {"agent", 'U', "HOST[:PORT]", 0,
+     "Send per-interval layer and object aggregates to mlio_collector, "
+     "default port 9436 (implies -a)"},
+    {"max-requests", 'R', "N", 0,
+     "Correlated requests to keep before evicting the oldest (default: 65536)"},
+    {"request-age", 'L', "SECONDS", 0,
+     "Expire correlated requests idle this long, 0 to disable (default: 60)"},
+    {"queue-size", 'Q', "MB", 0,
+     "Buffer between ring draining and output threads (default: 64 MB)"},
+    {"pid", 't', "PID[,PID...]", 0,
+     "Only trace these processes; checked first in every probe"},
+    {"cgroup", 'C', "PATH", 0,
+     "Only trace tasks in this cgroup v2 (repeatable), e.g. a container's "
+     "system.slice/docker-<id>.scope"},
+    {"sample", 'n', "N|LAYER=N,...", 0,
+     "Stream 1 in N events, optionally per layer (app, storage, os, fs, "
+     "dev); totals stay exact"},
+    {"budget", 'b', "EVENTS", 0,
+     "Stream at most EVENTS per second (token bucket); totals stay exact"},
+    {"adaptive", 'G', NULL, 0,
+     "Raise the sampling rate while events are being dropped"},
+    {"batch-wakeup", 'N', "KB[,MS]", 0,
+     "Wake the drain threads only once KB of events are pending, picking "
+     "up the rest every MS milliseconds (default: 10)"},
+    {"shard", 'S', "MODE", 0,
+     "Split the event ring per 'cpu' or per NUMA 'node', drained by one "
+     "thread per node"},
+    {"objects", 'O', "K[,amp]", 0,
+     "Keep per-object byte counts in kernel and report the top K objects "
+     "by device bytes, or by amplification with ',amp'"},
+    {"kprobes", 'K', NULL, 0,
+     "Attach the VFS and block probes as kprobes even where fentry/fexit "
+     "is available"},
+    {"layers", 'l', "LAYER[,LAYER...]", 0,
+     "Only load and attach the probes of these layers (app, storage, os, "
+     "fs, dev)"},
+    {"pin", 'F', "DIR", 0,
+     "Leave the programs attached and paused under DIR (in /sys/fs/bpf) at "
+     "exit, and reuse them on the next run with the same options"},
     {"system", 's', "SYSTEM", 0,
      "Trace specific storage system (minio/ceph/etcd/postgres/gluster)"},
 
@@ -183,16 +472,62 @@ static const struct argp_option opts[] = {
     {0, 0, 0, 0, "MinIO-specific options:"},
     {"minio-only", 'M', NULL, 0, "Trace only MinIO processes"},
     {"auto-detect-minio", 'A', NULL, 0,
-     "Auto-detect and trace all MinIO processes"},
-    {"minio-pid", 'p', "PID", 0, "Trace specific MinIO PID"},
+     "Trace all MinIO processes, including ones started later and their "
+     "children"},
+    {"minio-pid", 'p', "PID", 0, "Trace specific MinIO PID and its children"},
     {"minio-data-dir", 'D', "DIR", 0, "MinIO data directory to monitor"},
     {"trace-erasure", 'E', NULL, 0, "Trace MinIO erasure coding operations"},
     {"trace-metadata", 'T', NULL, 0,
      "Trace MinIO metadata operations (xl.meta)"},
     {"minio-port", 'P', "PORT", 0, "MinIO port (default: 9000)"},
+    {"minio-binary", 'B', "PATH", 0,
+     "MinIO executable for the -E/-T uprobes (default: that of the traced "
+     "MinIO process)"},
     {},
 };
 
+// Layer names for -n and -l, or -1
+static int layer_by_name(const char *name) {
+  static const char *names[SAMPLE_LAYERS] = {NULL, "app", "storage",
+                                             "os",  "fs",  "dev"};
+
+  for (int i = 1; i < SAMPLE_LAYERS; i++) {
+    if (strcasecmp(name, names[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+// Parse "N" or a comma-separated list of layer=N for -n
+static int parse_sample_rates(const char *arg) {
+  char buf[128];
+  char *tok, *save = NULL;
+
+  if (strchr(arg, '=') == NULL) {
+    int n = atoi(arg);
+    if (n <= 0)
+      return -1;
+    for (int i = 1; i < SAMPLE_LAYERS; i++)
+      env.sample_rate[i] = n;
+    return 0;
+  }
+
+  snprintf(buf, sizeof(buf), "%s", arg);
+  for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+    char *eq = strchr(tok, '=');
+    int layer;
+
+    if (!eq)
+      return -1;
+    *eq = '\0';
+    layer = layer_by_name(tok);
+    if (layer < 0 || atoi(eq + 1) <= 0)
+      return -1;
+    env.sample_rate[layer] = atoi(eq + 1);
+  }
+  return 0;
+}
+
 static error_t parse_arg(int key, char *arg, struct argp_state *state) {
   switch (key) {
   case 'v':
@@ -207,12 +542,144 @@ static error_t parse_arg(int key, char *arg, struct argp_state *state) {
   case 'o':
     env.output_file = arg;
     break;
+  case 'z':
+    env.compress = true;
+    break;
+  case 'Q':
+    env.queue_mb = atoi(arg);
+    if (env.queue_mb <= 0) {
+      fprintf(stderr, "Invalid queue size: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 't': {
+    char buf[256], *tok, *save = NULL;
+    snprintf(buf, sizeof(buf), "%s", arg);
+    for (tok = strtok_r(buf, ",", &save); tok;
+         tok = strtok_r(NULL, ",", &save)) {
+      int pid = atoi(tok);
+      if (pid <= 0 || env.num_target_tgids == MAX_FILTER_TARGETS) {
+        fprintf(stderr, "Invalid or too many PIDs: %s\n", arg);
+        argp_usage(state);
+      }
+      env.target_tgids[env.num_target_tgids++] = pid;
+    }
+    break;
+  }
+  case 'C':
+    if (env.num_target_cgroups == MAX_FILTER_TARGETS) {
+      fprintf(stderr, "Too many cgroups\n");
+      argp_usage(state);
+    }
+    env.target_cgroups[env.num_target_cgroups++] = arg;
+    break;
+  case 'n':
+    if (parse_sample_rates(arg) != 0) {
+      fprintf(stderr, "Invalid sample rate: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'l': {
+    char buf[128], *tok, *save = NULL;
+    snprintf(buf, sizeof(buf), "%s", arg);
+    for (tok = strtok_r(buf, ",", &save); tok;
+         tok = strtok_r(NULL, ",", &save)) {
+      int layer = layer_by_name(tok);
+      if (layer < 0) {
+        fprintf(stderr, "Invalid layer: %s\n", tok);
+        argp_usage(state);
+      }
+      env.layers |= 1u << layer;
+    }
+    break;
+  }
+  case 'F':
+    env.pin_dir = arg;
+    break;
+  case 'b':
+    env.budget = atoi(arg);
+    if (env.budget <= 0) {
+      fprintf(stderr, "Invalid event budget: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'G':
+    env.adaptive = true;
+    break;
+  case 'N': {
+    const char *ms = strchr(arg, ',');
+    env.wakeup_kb = atoi(arg);
+    if (ms)
+      env.wakeup_ms = atoi(ms + 1);
+    if (env.wakeup_kb <= 0 || env.wakeup_ms <= 0) {
+      fprintf(stderr, "Invalid wakeup batch: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  }
+  case 'S':
+    if (strcasecmp(arg, "cpu") == 0) {
+      env.shard_mode = SHARD_PER_CPU;
+    } else if (strcasecmp(arg, "node") == 0) {
+      env.shard_mode = SHARD_PER_NODE;
+    } else {
+      fprintf(stderr, "Invalid shard mode: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'w':
+    env.capture_file = arg;
+    env.realtime = false;
+    break;
+  case 'r':
+    env.replay_file = arg;
+    break;
+  case 'W':
+    env.columns_file = arg;
+    env.realtime = false;
+    break;
   case 'q':
     env.realtime = false;
     break;
   case 'c':
     env.correlation_mode = true;
     break;
+  case 'a':
+    env.aggregate = true;
+    break;
+  case 'V':
+    env.live = true;
+    env.aggregate = true;
+    break;
+  case 'X':
+    env.exporter_addr = arg;
+    env.aggregate = true;
+    break;
+  case 'U':
+    env.agent_addr = arg;
+    env.aggregate = true;
+    break;
+  case 'i':
+    env.interval = atoi(arg);
+    if (env.interval <= 0) {
+      fprintf(stderr, "Invalid interval: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'O': {
+    const char *order = strchr(arg, ',');
+    env.top_objects = atoi(arg);
+    env.objects_by_amp = order && strcmp(order + 1, "amp") == 0;
+    if (env.top_objects <= 0 || env.top_objects > MAX_TOP_OBJECTS ||
+        (order && !env.objects_by_amp && strcmp(order + 1, "device") != 0)) {
+      fprintf(stderr, "Invalid object count: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  }
+  case 'K':
+    env.force_kprobes = true;
+    break;
   case 's':
     env.trace_system = arg;
     if (strcasecmp(arg, "minio") == 0) {
@@ -239,9 +706,26 @@ static error_t parse_arg(int key, char *arg, struct argp_state *state) {
   case 'T':
     env.trace_metadata = true;
     break;
+  case 'B':
+    env.minio_binary = arg;
+    break;
   case 'P':
     env.minio_port = atoi(arg);
     break;
+  case 'R':
+    env.max_requests = atoi(arg);
+    if (env.max_requests <= 0) {
+      fprintf(stderr, "Invalid max requests: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
+  case 'L':
+    env.request_max_age = atoi(arg);
+    if (env.request_max_age < 0) {
+      fprintf(stderr, "Invalid request age: %s\n", arg);
+      argp_usage(state);
+    }
+    break;
   default:
     return ARGP_ERR_UNKNOWN;
   }
@@ -263,145 +747,273 @@ static const struct argp argp = {
            "  sudo ./multilayer_io_tracer -p $(pgrep minio) -c -E -T\n"
            "\n"
            "  # Trace MinIO with erasure coding and metadata tracking:\n"
-           "  sudo ./multilayer_io_tracer -M -E -T -o minio_trace.log\n",
+           "  sudo ./multilayer_io_tracer -M -E -T -o minio_trace.log\n"
+           "\n"
+           "  # Long-running per-layer totals with near-zero overhead:\n"
+           "  sudo ./multilayer_io_tracer -a -i 10 -q\n"
+           "\n"
+           "  # Watch amplification over the last 1/10/60 seconds:\n"
+           "  sudo ./multilayer_io_tracer -V -M\n"
+           "\n"
+           "  # Run as a daemon and let Prometheus scrape it:\n"
+           "  sudo ./multilayer_io_tracer -X :9435 -q\n"
+           "\n"
+           "  # Trace one container by cgroup:\n"
+           "  sudo ./multilayer_io_tracer -C system.slice/docker-<id>.scope\n"
+           "\n"
+           "  # Stream 1 in 100 VFS events, everything else in full:\n"
+           "  sudo ./multilayer_io_tracer -M -c -n os=100 -G\n"
+           "\n"
+           "  # Capture now, analyze later:\n"
+           "  sudo ./multilayer_io_tracer -M -c -w minio.bin -d 60\n"
+           "  ./multilayer_io_tracer -M -c -r minio.bin\n"
+           "\n"
+           "  # Columns for the Python scripts, live or from a capture:\n"
+           "  sudo ./multilayer_io_tracer -M -W minio.cols -d 60\n"
+           "  ./multilayer_io_tracer -r minio.bin -W minio.cols\n",
 };
 
 static volatile bool exiting = false;
 static FILE *output_fp = NULL;
 
+// With -j or -z, output_fp is a view of out_stream and the file or stdout
+// underneath it is kept in raw_output_fp
+static struct stream_writer *out_stream = NULL;
+static FILE *raw_output_fp = NULL;
+
 // Request correlation tracking
-#define MAX_REQUESTS 10000
-static struct request_stats requests[MAX_REQUESTS];
-static int request_count = 0;
+static struct request_table *requests = NULL;
+
+// Sampling state. sample_scale multiplies the configured rates and is
+// raised/lowered at runtime by the adaptive controller.
+static __u32 sample_scale = 1;
+static int sample_stats_fd = -1;
+
+static bool sampling_enabled(void) {
+  for (int i = 1; i < SAMPLE_LAYERS; i++) {
+    if (env.sample_rate[i] > 1)
+      return true;
+  }
+  return env.budget > 0 || env.adaptive;
+}
+
+// Totals come from layer_aggregates rather than from streamed events. A
+// replay has no kernel side and always counts the recorded events.
+static bool kernel_totals(void) {
+  return !env.replay_file && (env.aggregate || sampling_enabled());
+}
+
+// Binary capture output for -w
+static struct trace_writer *capture = NULL;
+
+// Columnar export for -W. Loaded by name in trace_columns.py.
+static struct column_writer *columns = NULL;
+
+static const struct column_def event_columns[] = {
+    {"timestamp", 8},
+    {"layer", 1},
+    {"event_type", 4},
+    {"size", 8},
+    {"aligned_size", 8},
+    {"latency_ns", 8},
+    {"dev", 4},
+    {"pid", 4},
+    {"request_id", 8},
+    {"flags", 2},
+    {"system_type", 1},
+};
+
+static void export_columns(const struct io_event_core *e) {
+  __u64 row[] = {e->timestamp,    e->layer,      e->event_type, e->size,
+                 e->aligned_size, e->latency_ns, e->dev,        e->pid,
+                 e->request_id,   e->flags,      e->system_type};
+
+  column_writer_append(columns, row);
+}
+
+// Ring draining runs on separate threads that hand records to the main
+// thread through one queue each, so slow output never stalls the kernel
+// ring buffer. Without sharding there is a single drainer for `events`;
+// with -S there is one per NUMA node, owning that node's shard rings.
+#define MAX_DRAINERS MAX_RING_SHARDS
+
+struct drainer {
+  pthread_t thread;
+  struct ring_buffer *rb;
+  struct spsc_queue queue;
+  cpu_set_t cpus;
+  bool pin;
+  bool started;
+  int node;
+  int rings;
+  // Every record committed before this CLOCK_MONOTONIC time is already in
+  // queue; ULLONG_MAX once the thread has exited. Only kept up to date
+  // while merging, see process_queue().
+  _Atomic __u64 watermark;
+};
+
+static struct drainer drainers[MAX_DRAINERS];
+static int num_drainers = 0;
+static _Atomic int drainers_done = 0;
+static int drain_err = 0;
+static int shard_fds[MAX_RING_SHARDS];
+static int num_shards = 0;
+
+// Set once the skeleton is loaded so the summary can read the kernel maps
+static int latency_hists_fd = -1;
+static int device_stats_fd = -1;
+static int device_max_depth_fd = -1;
+static int cache_stats_fd = -1;
+static int layer_aggregates_fd = -1;
+static int process_aggregates_fd = -1;
+static int object_stats_fd = -1;
+static int inode_paths_fd = -1;
+static struct http_exporter *exporter = NULL;
+
+// Layout of the traced storage system, from -s or -M
+static const struct system_decoder *decoder = NULL;
+
+// Self-instrumentation. bpf_stats_fd keeps BPF_STATS_RUN_TIME enabled for
+// as long as it is open; the rest is measured on the main thread.
+static int bpf_stats_fd = -1;
+static int ring_drop_counts_fd = -1;
+static double ring_fill_peak = 0; // Percent of the ring size
+static __u64 handled_events = 0;
+static __u64 handler_ns = 0;
 
 // Forward declarations
 static void print_amplification_summary(void);
+static void print_latency_summary(void);
+static void print_device_summary(void);
+static void print_cache_summary(void);
+static void print_sampling_summary(void);
 static void print_minio_summary(void);
 static int find_minio_processes(struct multilayer_io_tracer_bpf *skel);
 static int add_minio_pid(struct multilayer_io_tracer_bpf *skel, __u32 pid);
 
-// Modified signal handler that prints summary before exiting
+// Only flags the main loop, which prints the summary once it has stopped
+// the drainers. The summaries allocate, read BPF maps and walk state that
+// handle_event() may be in the middle of updating, none of which is safe
+// from a signal handler.
+static volatile sig_atomic_t interrupted = 0;
+
 static void sig_handler(int sig) {
-  if (!exiting) {
-    exiting = true;
+  interrupted = 1;
+  exiting = true;
+}
 
-    // Print summary when interrupted
-    if (output_fp) {
-      fprintf(output_fp, "\n=== Tracer interrupted, generating summary ===\n");
-      print_amplification_summary();
-      if (env.minio_only) {
-        print_minio_summary();
-      }
-      fflush(output_fp);
-    }
-  }
-}
-
-const char *get_event_name(__u32 event_type) {
-  switch (event_type) {
-  // Application layer
-  case 101:
-    return "APP_READ";
-  case 102:
-    return "APP_WRITE";
-  case 103:
-    return "APP_OPEN";
-  case 104:
-    return "APP_CLOSE";
-  case 105:
-    return "APP_FSYNC";
-
-  // MinIO-specific events
-  case 201:
-    return "MINIO_OBJECT_PUT";
-  case 202:
-    return "MINIO_OBJECT_GET";
-  case 203:
-    return "MINIO_ERASURE_WRITE";
-  case 204:
-    return "MINIO_METADATA_UPDATE";
-  case 205:
-    return "MINIO_BITROT_CHECK";
-  case 206:
-    return "MINIO_MULTIPART";
-  case 207:
-    return "MINIO_XL_META";
-
-  // OS layer
-  case 301:
-    return "OS_SYSCALL_ENTER";
-  case 302:
-    return "OS_SYSCALL_EXIT";
-  case 303:
-    return "OS_VFS_READ";
-  case 304:
-    return "OS_VFS_WRITE";
-  case 305:
-    return "OS_PAGE_CACHE_HIT";
-  case 306:
-    return "OS_PAGE_CACHE_MISS";
-  case 307:
-    return "OS_CONTEXT_SWITCH";
-
-  // Filesystem layer
-  case 401:
-    return "FS_SYNC";
-  case 402:
-    return "FS_METADATA_UPDATE";
-  case 403:
-    return "FS_DATA_WRITE";
-  case 404:
-    return "FS_INODE_UPDATE";
-  case 405:
-    return "FS_EXTENT_ALLOC";
-  case 406:
-    return "FS_BLOCK_ALLOC";
-
-  // Device layer
-  case 501:
-    return "DEV_BIO_SUBMIT";
-  case 502:
-    return "DEV_BIO_COMPLETE";
-  case 503:
-    return "DEV_REQUEST_QUEUE";
-  case 504:
-    return "DEV_REQUEST_COMPLETE";
-  case 505:
-    return "DEV_FTL_WRITE";
-  case 506:
-    return "DEV_TRIM";
+static const struct io_event_detail empty_detail;
 
-  default:
-    return "UNKNOWN";
+// Split a ring buffer record into its core and optional payload sections
+static bool decode_event(const void *data, size_t data_sz,
+                         struct event_view *v) {
+  const char *p = data;
+  size_t off = sizeof(struct io_event_core);
+
+  if (data_sz < off)
+    return false;
+
+  v->core = data;
+  v->detail = &empty_detail;
+  v->bucket_name = "";
+  v->filename = "";
+
+  if (v->core->flags & EVENT_EXT_DETAIL) {
+    if (data_sz < off + sizeof(struct io_event_detail))
+      return false;
+    v->detail = (const struct io_event_detail *)(p + off);
+    off += sizeof(struct io_event_detail);
+  }
+
+  if (v->core->flags & EVENT_EXT_BUCKET) {
+    if (data_sz < off + MAX_BUCKET_NAME_LEN)
+      return false;
+    if (memchr(p + off, '\0', MAX_BUCKET_NAME_LEN))
+      v->bucket_name = p + off;
+    off += MAX_BUCKET_NAME_LEN;
   }
+
+  // The filename is the tail of the record and carries its own NUL
+  if ((v->core->flags & EVENT_EXT_FILENAME) && off < data_sz &&
+      memchr(p + off, '\0', data_sz - off))
+    v->filename = p + off;
+
+  return true;
 }
 
-static void update_stats(const struct multilayer_io_event *e) {
-  if (e->layer > 5)
-    return;
+static bool is_cache_lookup(__u32 event_type) {
+  return event_type == 305 || event_type == 306; // OS_PAGE_CACHE_HIT/MISS
+}
+
+// size is what the reads returned, fill_bytes what they brought into the
+// page cache for the ranges they read (readahead is in cache_stats)
+static void count_cache_lookup(struct layer_stats *s, __u32 event_type,
+                               __u64 reads, __u64 bytes, __u64 fill_bytes) {
+  if (event_type == 305)
+    s->cache_hits += reads;
+  else
+    s->cache_misses += reads;
+  s->cache_read_bytes += bytes;
+  s->cache_fill_bytes += fill_bytes;
+}
+
+static void update_layer_stats(const struct io_event_core *e) {
+  bool is_minio = e->flags & EVENT_FLAG_MINIO;
+  bool is_journal = e->flags & EVENT_FLAG_JOURNAL;
 
   struct layer_stats *s = &stats[e->layer];
   s->total_events++;
+
+  // Page cache records describe a read already counted at vfs_read, so
+  // their bytes stay out of the layer totals
+  if (is_cache_lookup(e->event_type)) {
+    count_cache_lookup(s, e->event_type, 1, e->size, e->aligned_size);
+    return;
+  }
+
+  // Writeback flushes pages whose writes were already counted when they
+  // were dirtied, so it has its own counter and stays out of the totals
+  if (e->event_type == 407) { // FS_WRITEBACK
+    s->writeback_bytes += e->size;
+    return;
+  }
+
+  // A commit logs the blocks its handles already counted as metadata
+  // updates, plus the journal's own descriptor and commit blocks
+  if (e->event_type == 408) { // FS_JOURNAL_COMMIT
+    s->journal_bytes += e->size;
+    return;
+  }
+
+  // Faults are a lower bound that misses fault-around pages, so they are
+  // kept out of the application bytes every amplification is relative to
+  if (e->event_type == 107) { // APP_MMAP_READ
+    s->mmap_bytes += e->size;
+    return;
+  }
+
+  // Bitrot hashing sees the same shards the encode record already counted
+  // as data + parity
+  if (e->event_type == 205) { // MINIO_BITROT_CHECK
+    minio_stats.bitrot_bytes += e->size;
+    return;
+  }
+
   s->total_bytes += e->size;
   s->aligned_bytes += e->aligned_size ? e->aligned_size : e->size;
 
-  if (e->is_metadata)
+  if (e->flags & EVENT_FLAG_METADATA)
     s->metadata_ops++;
-  if (e->is_journal)
+  if (is_journal)
     s->journal_ops++;
-  if (e->cache_hit)
-    s->cache_hits++;
-  if (e->event_type == 306)
-    s->cache_misses++;
-
   s->total_latency += e->latency_ns;
 
   // Update MinIO-specific stats
-  if (e->is_minio) {
+  if (is_minio) {
     s->minio_events++;
     s->minio_bytes += e->size;
 
-    if (e->is_xl_meta) {
+    if (e->flags & EVENT_FLAG_XL_META) {
       s->xl_meta_ops++;
       minio_stats.xl_meta_operations++;
       minio_stats.metadata_bytes += e->size;
@@ -410,8 +1022,18 @@ static void update_stats(const struct multilayer_io_event *e) {
     if (e->event_type == 203) { // MINIO_ERASURE_WRITE
       s->erasure_writes++;
       minio_stats.erasure_blocks_written++;
+      // Encode records carry the parity as aligned_size beyond size
+      minio_stats.encoded_bytes += e->size;
+      if (e->aligned_size > e->size)
+        minio_stats.parity_bytes += e->aligned_size - e->size;
     }
 
+    if (e->event_type == 208) // MINIO_ERASURE_READ
+      minio_stats.decoded_bytes += e->size;
+
+    if (e->event_type == 204) // MINIO_METADATA_UPDATE, xl.meta writes
+      minio_stats.metadata_bytes += e->size;
+
     if (e->event_type == 206) { // MINIO_MULTIPART
       s->multipart_ops++;
       minio_stats.multipart_uploads++;
@@ -426,113 +1048,211 @@ static void update_stats(const struct multilayer_io_event *e) {
       minio_stats.total_objects_read++;
     }
   }
+}
+
+static void update_stats(const struct event_view *v) {
+  const struct io_event_core *e = v->core;
+
+  if (e->layer > 5)
+    return;
+
+  bool is_minio = e->flags & EVENT_FLAG_MINIO;
+  bool is_journal = e->flags & EVENT_FLAG_JOURNAL;
+
+  // When totals are kept in the kernel, streamed events only feed
+  // correlation; counting them here would double-count or, when sampled,
+  // undercount
+  if (!kernel_totals())
+    update_layer_stats(e);
 
   // Update request correlation if enabled
-  if (env.correlation_mode && e->request_id != 0) {
-    for (int i = 0; i < request_count; i++) {
-      if (requests[i].request_id == e->request_id) {
-        switch (e->layer) {
-        case LAYER_APPLICATION:
-          requests[i].app_size += e->size;
-          requests[i].is_minio = e->is_minio;
-          break;
-        case LAYER_STORAGE_SERVICE:
-          requests[i].storage_service_size += e->size;
-          if (e->replication_count > 0)
-            requests[i].replication_factor = e->replication_count;
-          break;
-        case LAYER_OPERATING_SYSTEM:
-          requests[i].os_size += e->aligned_size ? e->aligned_size : e->size;
-          break;
-        case LAYER_FILESYSTEM:
-          requests[i].fs_size += e->size;
-          if (e->is_journal)
-            requests[i].journal_blocks += e->block_count;
-          break;
-        case LAYER_DEVICE:
-          requests[i].device_size += e->size;
-          break;
-        }
-        return;
-      }
-    }
+  if (env.correlation_mode && requests && e->request_id != 0) {
+    // The application record is not always first: an io_uring completion
+    // arrives after the work its submission did inline
+    int created = 0;
+    struct request_stats *r = request_table_get_or_create(
+        requests, e->request_id, e->timestamp, &created);
+    if (!r)
+      return;
+    if (created)
+      r->request_id = e->request_id;
 
-    // New request
-    if (request_count < MAX_REQUESTS && e->layer == LAYER_APPLICATION) {
-      requests[request_count].request_id = e->request_id;
-      requests[request_count].app_size = e->size;
-      requests[request_count].is_minio = e->is_minio;
-      if (e->filename[0] != '\0') {
-        strncpy(requests[request_count].object_name, e->filename,
-                MAX_FILENAME_LEN - 1);
+    switch (e->layer) {
+    case LAYER_APPLICATION:
+      if (e->event_type == 107) // APP_MMAP_READ, see update_layer_stats()
+        break;
+      r->app_size += e->size;
+      r->is_minio = is_minio;
+      if (v->filename[0] != '\0' && r->object_name[0] == '\0')
+        strncpy(r->object_name, v->filename, MAX_FILENAME_LEN - 1);
+      break;
+    case LAYER_STORAGE_SERVICE:
+      r->storage_service_size += e->size;
+      if (v->detail->replication_count > 0)
+        r->replication_factor = v->detail->replication_count;
+      break;
+    case LAYER_OPERATING_SYSTEM:
+      if (is_cache_lookup(e->event_type)) {
+        r->cache_read_bytes += e->size;
+        r->cache_fill_bytes += e->aligned_size;
+        break;
+      }
+      r->os_size += e->aligned_size ? e->aligned_size : e->size;
+      break;
+    case LAYER_FILESYSTEM:
+      if (e->event_type == 407) { // FS_WRITEBACK
+        r->writeback_bytes += e->size;
+        break;
       }
-      request_count++;
+      if (e->event_type == 408) // FS_JOURNAL_COMMIT, charged to one handle
+        break;
+      r->fs_size += e->size;
+      if (is_journal)
+        r->journal_blocks += v->detail->block_count;
+      break;
+    case LAYER_DEVICE:
+      // Completions repeat the bytes of their submission
+      if (e->event_type != 501)
+        break;
+      r->device_size += e->size;
+      if (e->flags & EVENT_FLAG_INHERITED)
+        r->async_device_size += e->size;
+      break;
     }
   }
 }
 
+// HH:MM:SS of an event timestamp, reformatted only when the second changes
+static const char *clock_string(__u64 timestamp_ns) {
+  static time_t cached = -1;
+  static char buf[16];
+  time_t t = timestamp_ns / 1000000000;
+
+  if (t != cached) {
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    strftime(buf, sizeof(buf), "%H:%M:%S", &tm);
+    cached = t;
+  }
+  return buf;
+}
+
+// "%.2f" of ns / 1000.0. Exact halves depend on how printf rounds the
+// double, so those (and values too large for a double) go through it.
+static char *put_latency_us(char *p, __u64 ns) {
+  __u64 hundredths;
+
+  if (ns % 10 == 5 || ns >= (1ULL << 53))
+    return p + snprintf(p, 32, "%.2f", ns / 1000.0);
+
+  hundredths = ns / 10 + (ns % 10 > 5);
+  p = put_u64(p, hundredths / 100);
+  p = put_char(p, '.');
+  return put_u64_pad(p, hundredths % 100, 2);
+}
+
+// Upper bound on one JSON line, including a full-length filename
+#define JSON_EVENT_MAX 1024
+
+// One NDJSON line per event, formatted straight into the output buffer.
+// Byte-for-byte the same as the printf format this replaced.
+static void write_json_event(const struct event_view *v) {
+  const struct io_event_core *e = v->core;
+  char *p = stream_writer_reserve(out_stream, JSON_EVENT_MAX);
+
+  if (!p)
+    return;
+
+  p = put_lit(p, "{\"timestamp\":\"");
+  p = put_str(p, clock_string(e->timestamp), 16);
+  p = put_char(p, '.');
+  p = put_u64_pad(p, e->timestamp % 1000000000, 9);
+  p = put_lit(p, "\",\"layer\":\"");
+  p = put_str(p, layer_names[e->layer], 32);
+  p = put_lit(p, "\",\"event\":\"");
+  p = put_str(p, get_event_name(e->event_type), 32);
+  p = put_lit(p, "\",\"pid\":");
+  p = put_u64(p, e->pid);
+  p = put_lit(p, ",\"comm\":\"");
+  p = put_str(p, e->comm, MAX_COMM_LEN);
+  p = put_lit(p, "\",\"system\":\"");
+  p = put_str(p, system_names[e->system_type], 32);
+  p = put_lit(p, "\",\"size\":");
+  p = put_u64(p, e->size);
+  p = put_lit(p, ",\"aligned_size\":");
+  p = put_u64(p, e->aligned_size);
+  p = put_lit(p, ",\"latency_us\":");
+  p = put_latency_us(p, e->latency_ns);
+  p = put_lit(p, ",\"request_id\":\"");
+  p = put_hex64(p, e->request_id);
+  p = put_lit(p, "\",\"is_metadata\":");
+  p = put_char(p, e->flags & EVENT_FLAG_METADATA ? '1' : '0');
+  p = put_lit(p, ",\"is_journal\":");
+  p = put_char(p, e->flags & EVENT_FLAG_JOURNAL ? '1' : '0');
+  p = put_lit(p, ",\"cache_hit\":");
+  p = put_char(p, e->flags & EVENT_FLAG_CACHE_HIT ? '1' : '0');
+  p = put_lit(p, ",\"is_minio\":");
+  p = put_char(p, e->flags & EVENT_FLAG_MINIO ? '1' : '0');
+  p = put_lit(p, ",\"is_xl_meta\":");
+  p = put_char(p, e->flags & EVENT_FLAG_XL_META ? '1' : '0');
+  p = put_lit(p, ",\"filename\":\"");
+  p = put_str(p, v->filename, MAX_FILENAME_LEN);
+  p = put_lit(p, "\"}\n");
+  stream_writer_commit(out_stream, p);
+}
+
 static int handle_event(void *ctx, void *data, size_t data_sz) {
-  const struct multilayer_io_event *e = data;
-  struct tm *tm;
-  char ts[32];
-  time_t t;
+  struct event_view v;
+  const char *ts;
+
+  if (!decode_event(data, data_sz, &v))
+    return 0;
+
+  if (capture)
+    trace_writer_append(capture, data, data_sz);
+  if (columns)
+    export_columns(v.core);
+
+  const struct io_event_core *e = v.core;
+  int is_metadata = !!(e->flags & EVENT_FLAG_METADATA);
+  int is_journal = !!(e->flags & EVENT_FLAG_JOURNAL);
+  int cache_hit = !!(e->flags & EVENT_FLAG_CACHE_HIT);
+  int is_minio = !!(e->flags & EVENT_FLAG_MINIO);
+  int is_xl_meta = !!(e->flags & EVENT_FLAG_XL_META);
 
-  update_stats(e);
+  update_stats(&v);
 
   if (!env.realtime)
     return 0;
 
-  t = e->timestamp / 1000000000;
-  tm = localtime(&t);
-  strftime(ts, sizeof(ts), "%H:%M:%S", tm);
-
   if (env.json_output) {
-    fprintf(output_fp,
-            "{\"timestamp\":\"%s.%09llu\","
-            "\"layer\":\"%s\","
-            "\"event\":\"%s\","
-            "\"pid\":%u,"
-            "\"comm\":\"%s\","
-            "\"system\":\"%s\","
-            "\"size\":%llu,"
-            "\"aligned_size\":%llu,"
-            "\"latency_us\":%.2f,"
-            "\"request_id\":\"%016llx\","
-            "\"is_metadata\":%d,"
-            "\"is_journal\":%d,"
-            "\"cache_hit\":%d,"
-            "\"is_minio\":%d,"
-            "\"is_xl_meta\":%d,"
-            "\"filename\":\"%s\"}\n",
-            ts, e->timestamp % 1000000000, layer_names[e->layer],
-            get_event_name(e->event_type), e->pid, e->comm,
-            system_names[e->system_type], e->size, e->aligned_size,
-            e->latency_ns / 1000.0, e->request_id, e->is_metadata,
-            e->is_journal, e->cache_hit, e->is_minio, e->is_xl_meta,
-            e->filename);
-  } else {
-    // Color coding for MinIO events
-    const char *color_start = "";
-    const char *color_end = "";
-    if (e->is_minio && isatty(fileno(output_fp))) {
-      color_start = "\033[1;36m"; // Cyan for MinIO
-      color_end = "\033[0m";
-    }
+    write_json_event(&v);
+    return 0;
+  }
 
-    fprintf(output_fp,
-            "%s%s.%03llu %-12s %-25s %7llu %7llu %8.2f %-15s %s%s%s%s%s%s\n",
-            color_start, ts, (e->timestamp % 1000000000) / 1000000,
-            layer_names[e->layer], get_event_name(e->event_type), e->size,
-            e->aligned_size ? e->aligned_size : e->size, e->latency_ns / 1000.0,
-            e->comm, e->is_metadata ? "[META]" : "",
-            e->is_journal ? "[JRNL]" : "", e->cache_hit ? "[HIT]" : "",
-            e->is_minio ? "[MINIO]" : "", e->is_xl_meta ? "[XL.META]" : "",
-            color_end);
+  ts = clock_string(e->timestamp);
 
-    // Print filename if present and verbose
-    if (env.verbose && e->filename[0] != '\0') {
-      fprintf(output_fp, "    └─> File: %s\n", e->filename);
-    }
+  // Color coding for MinIO events
+  const char *color_start = "";
+  const char *color_end = "";
+  if (is_minio && isatty(fileno(output_fp))) {
+    color_start = "\033[1;36m"; // Cyan for MinIO
+    color_end = "\033[0m";
+  }
+
+  fprintf(output_fp,
+          "%s%s.%03llu %-12s %-25s %7llu %7llu %8.2f %-15s %s%s%s%s%s%s\n",
+          color_start, ts, (e->timestamp % 1000000000) / 1000000,
+          layer_names[e->layer], get_event_name(e->event_type), e->size,
+          e->aligned_size ? e->aligned_size : e->size, e->latency_ns / 1000.0,
+          e->comm, is_metadata ? "[META]" : "", is_journal ? "[JRNL]" : "",
+          cache_hit ? "[HIT]" : "", is_minio ? "[MINIO]" : "",
+          is_xl_meta ? "[XL.META]" : "", color_end);
+
+  // Print filename if present and verbose
+  if (env.verbose && v.filename[0] != '\0') {
+    fprintf(output_fp, "    └─> File: %s\n", v.filename);
   }
 
   fflush(output_fp);
@@ -556,6 +1276,15 @@ static void print_header() {
   }
 }
 
+// Share of read bytes that did not have to be brought into the page cache
+static double cache_hit_ratio(__u64 read_bytes, __u64 fill_bytes) {
+  if (read_bytes == 0)
+    return 0;
+  if (fill_bytes >= read_bytes)
+    return 0;
+  return (double)(read_bytes - fill_bytes) / read_bytes;
+}
+
 static void print_amplification_summary() {
   fprintf(output_fp, "\n========================================\n");
   fprintf(output_fp, "    I/O AMPLIFICATION ANALYSIS\n");
@@ -616,14 +1345,15 @@ static void print_amplification_summary() {
           (double)stats[LAYER_OPERATING_SYSTEM].aligned_bytes / app_bytes);
     }
 
-    if (stats[LAYER_FILESYSTEM].total_bytes > 0) {
+    if (stats[LAYER_FILESYSTEM].total_bytes > 0 ||
+        stats[LAYER_FILESYSTEM].journal_bytes > 0) {
       __u64 fs_total = stats[LAYER_FILESYSTEM].aligned_bytes;
       fprintf(
           output_fp,
           "After filesystem layer:       %10llu bytes (%.2fx amplification)\n",
           fs_total, (double)fs_total / app_bytes);
       fprintf(output_fp, "  - Journal writes:           %10llu bytes\n",
-              stats[LAYER_FILESYSTEM].journal_ops * 4096);
+              stats[LAYER_FILESYSTEM].journal_bytes);
       fprintf(output_fp, "  - Metadata updates:         %10llu operations\n",
               stats[LAYER_FILESYSTEM].metadata_ops);
     }
@@ -652,32 +1382,269 @@ static void print_amplification_summary() {
   }
 
   // Per-request analysis if correlation mode is enabled
+  size_t request_count = request_table_count(requests);
   if (env.correlation_mode && request_count > 0) {
+    struct request_table_stats rt_stats;
+    // Requests only seen below the application layer, e.g. writeback of
+    // one already evicted, have nothing to amplify and are not shown
+    struct request_stats *top[256];
+    size_t collected = request_table_collect(requests, (void **)top, 256);
+    size_t display_count = 0;
+
+    for (size_t i = 0; i < collected && display_count < 10; i++) {
+      if (top[i]->app_size > 0)
+        top[display_count++] = top[i];
+    }
+
+    request_table_get_stats(requests, &rt_stats);
+
     fprintf(output_fp, "\n\nPer-Request Amplification (Top 10):\n");
-    fprintf(output_fp, "%-16s %8s %8s %8s %8s %8s %8s %6s %7s\n", "REQUEST_ID",
-            "APP", "STORAGE", "OS", "FS", "DEVICE", "TOTAL", "AMP", "MinIO");
+    fprintf(output_fp,
+            "Requests tracked: %zu (peak %zu of %zu), evicted: %llu LRU, "
+            "%llu aged out\n",
+            rt_stats.count, rt_stats.peak, rt_stats.max_entries,
+            rt_stats.lru_evictions, rt_stats.age_evictions);
+    fprintf(output_fp,
+            "%-16s %8s %8s %8s %8s %8s %8s %8s %8s %6s %6s %7s\n",
+            "REQUEST_ID", "APP", "STORAGE", "OS", "FS", "WB", "DEVICE",
+            "ASYNC", "TOTAL", "AMP", "HIT%", "MinIO");
     fprintf(output_fp, "-------------------------------------------------------"
-                       "----------------------\n");
+                       "-----------------------------------------------\n");
 
-    int display_count = request_count > 10 ? 10 : request_count;
-    for (int i = 0; i < display_count; i++) {
-      struct request_stats *r = &requests[i];
+    for (size_t i = 0; i < display_count; i++) {
+      struct request_stats *r = top[i];
       __u64 total = r->device_size ? r->device_size : r->fs_size;
       if (total == 0)
         total = r->os_size;
 
       double amp = r->app_size > 0 ? (double)total / r->app_size : 0;
+      char hit[8] = "-";
+      if (r->cache_read_bytes > 0)
+        snprintf(hit, sizeof(hit), "%.0f",
+                 100.0 * cache_hit_ratio(r->cache_read_bytes,
+                                         r->cache_fill_bytes));
 
       fprintf(
-          output_fp, "%016llx %8llu %8llu %8llu %8llu %8llu %8llu %6.2fx %7s\n",
+          output_fp,
+          "%016llx %8llu %8llu %8llu %8llu %8llu %8llu %8llu %8llu %6.2fx %6s "
+          "%7s\n",
           r->request_id, r->app_size, r->storage_service_size, r->os_size,
-          r->fs_size, r->device_size, total, amp, r->is_minio ? "Yes" : "No");
+          r->fs_size, r->writeback_bytes, r->device_size, r->async_device_size,
+          total, amp, hit, r->is_minio ? "Yes" : "No");
     }
   }
 }
 
-static void print_minio_summary() {
-  fprintf(output_fp, "\n========================================\n");
+// Upper bound in ns of a log-linear histogram slot
+static __u64 latency_slot_upper(int slot) {
+  int sub_buckets = 1 << LAT_SUB_BUCKET_BITS;
+
+  if (slot < sub_buckets)
+    return slot + 1;
+
+  int lg = slot / sub_buckets + 1;
+  int sub = slot % sub_buckets;
+  return (__u64)(sub_buckets + sub + 1) << (lg - LAT_SUB_BUCKET_BITS);
+}
+
+static __u64 latency_percentile(const struct latency_hist *h, double pct) {
+  __u64 target = (__u64)(h->count * pct / 100.0);
+  __u64 seen = 0;
+
+  if (target == 0)
+    target = 1;
+  for (int i = 0; i < LAT_SLOTS; i++) {
+    seen += h->slots[i];
+    if (seen >= target)
+      return latency_slot_upper(i);
+  }
+  return latency_slot_upper(LAT_SLOTS - 1);
+}
+
+// Sum one latency_hists entry over all CPUs into sum, using values as
+// scratch space for ncpus entries
+static int read_latency_hist(__u32 kind, struct latency_hist *values,
+                             int ncpus, struct latency_hist *sum) {
+  memset(sum, 0, sizeof(*sum));
+  if (bpf_map_lookup_elem(latency_hists_fd, &kind, values) != 0)
+    return -1;
+
+  for (int cpu = 0; cpu < ncpus; cpu++) {
+    sum->count += values[cpu].count;
+    sum->sum_ns += values[cpu].sum_ns;
+    for (int i = 0; i < LAT_SLOTS; i++)
+      sum->slots[i] += values[cpu].slots[i];
+  }
+  return 0;
+}
+
+static void print_latency_summary() {
+  int ncpus = libbpf_num_possible_cpus();
+  struct latency_hist *values;
+  bool header = false;
+
+  if (latency_hists_fd < 0 || ncpus <= 0)
+    return;
+
+  values = calloc(ncpus, sizeof(*values));
+  if (!values)
+    return;
+
+  for (__u32 kind = 0; kind < LAT_KINDS; kind++) {
+    struct latency_hist sum;
+
+    if (read_latency_hist(kind, values, ncpus, &sum) != 0 || sum.count == 0)
+      continue;
+
+    if (!header) {
+      fprintf(output_fp, "\nLatency Percentiles (μs):\n");
+      fprintf(output_fp, "%-12s %10s %10s %10s %10s %10s\n", "Operation",
+              "Count", "Mean", "p50", "p99", "p99.9");
+      fprintf(output_fp, "---------------------------------------------------"
+                         "-------------\n");
+      header = true;
+    }
+
+    fprintf(output_fp, "%-12s %10llu %10.2f %10.2f %10.2f %10.2f\n",
+            latency_names[kind], sum.count,
+            (double)sum.sum_ns / sum.count / 1000.0,
+            latency_percentile(&sum, 50) / 1000.0,
+            latency_percentile(&sum, 99) / 1000.0,
+            latency_percentile(&sum, 99.9) / 1000.0);
+  }
+
+  free(values);
+}
+
+// Sum of the per-CPU cache_stats, or all zero before the skeleton is loaded
+static int read_cache_stats(struct cache_stats *cs) {
+  int ncpus = libbpf_num_possible_cpus();
+  struct cache_stats *values;
+  __u32 key = 0;
+
+  memset(cs, 0, sizeof(*cs));
+  if (cache_stats_fd < 0 || ncpus <= 0)
+    return 0;
+
+  values = calloc(ncpus, sizeof(*values));
+  if (!values)
+    return -1;
+  if (bpf_map_lookup_elem(cache_stats_fd, &key, values) == 0) {
+    for (int cpu = 0; cpu < ncpus; cpu++) {
+      cs->dirtied_pages += values[cpu].dirtied_pages;
+      cs->writeback_pages += values[cpu].writeback_pages;
+      cs->writeback_inodes += values[cpu].writeback_inodes;
+      cs->readahead_pages += values[cpu].readahead_pages;
+    }
+  }
+  free(values);
+  return 0;
+}
+
+static void print_cache_summary() {
+  struct layer_stats *os = &stats[LAYER_OPERATING_SYSTEM];
+  struct cache_stats cs;
+  __u64 reads = os->cache_hits + os->cache_misses;
+  __u64 writeback = stats[LAYER_FILESYSTEM].writeback_bytes;
+  __u64 mmap = stats[LAYER_APPLICATION].mmap_bytes;
+
+  read_cache_stats(&cs);
+  if (reads == 0 && cs.dirtied_pages == 0 && writeback == 0 &&
+      cs.readahead_pages == 0 && mmap == 0)
+    return;
+
+  fprintf(output_fp, "\nPage Cache:\n");
+  if (reads > 0) {
+    fprintf(output_fp,
+            "  Buffered reads:      %10llu (%llu hits, %.1f%% hit ratio)\n",
+            reads, os->cache_hits, 100.0 * os->cache_hits / reads);
+    fprintf(output_fp,
+            "  Read bytes:          %10llu (%llu brought in, %.1f%% served "
+            "from cache)\n",
+            os->cache_read_bytes, os->cache_fill_bytes,
+            100.0 * cache_hit_ratio(os->cache_read_bytes,
+                                    os->cache_fill_bytes));
+  }
+  if (cs.readahead_pages > 0)
+    fprintf(output_fp, "  Read ahead:          %10llu bytes\n",
+            cs.readahead_pages * CACHE_PAGE_SIZE);
+  if (mmap > 0)
+    fprintf(output_fp,
+            "  Mmap faults:         %10llu bytes (not in APPLICATION bytes)\n",
+            mmap);
+  if (cs.dirtied_pages > 0)
+    fprintf(output_fp, "  Dirtied by writes:   %10llu bytes\n",
+            cs.dirtied_pages * CACHE_PAGE_SIZE);
+  if (writeback > 0) {
+    fprintf(output_fp, "  Deferred writeback:  %10llu bytes", writeback);
+    if (cs.writeback_inodes > 0)
+      fprintf(output_fp, " (%llu inode flushes)", cs.writeback_inodes);
+    fprintf(output_fp, "\n");
+  }
+}
+
+// One device's counters, with max_depth folded in from its per-CPU maxima
+static int read_device_stats(__u32 dev, struct device_stats *ds) {
+  int ncpus = libbpf_num_possible_cpus();
+
+  if (bpf_map_lookup_elem(device_stats_fd, &dev, ds) != 0)
+    return -1;
+
+  ds->max_depth = 0;
+  if (device_max_depth_fd < 0 || ncpus <= 0)
+    return 0;
+
+  __u64 *max = calloc(ncpus, sizeof(*max));
+  if (!max)
+    return 0;
+  if (bpf_map_lookup_elem(device_max_depth_fd, &dev, max) == 0) {
+    for (int cpu = 0; cpu < ncpus; cpu++)
+      if (max[cpu] > ds->max_depth)
+        ds->max_depth = max[cpu];
+  }
+  free(max);
+  return 0;
+}
+
+static void print_device_summary() {
+  __u32 key, next_key;
+  __u32 *prev = NULL;
+  bool header = false;
+
+  if (device_stats_fd < 0)
+    return;
+
+  while (bpf_map_get_next_key(device_stats_fd, prev, &next_key) == 0) {
+    struct device_stats ds;
+
+    key = next_key;
+    prev = &key;
+    if (read_device_stats(key, &ds) != 0 || ds.issued == 0)
+      continue;
+
+    if (!header) {
+      fprintf(output_fp, "\nBlock Device Queue Statistics:\n");
+      fprintf(output_fp, "%-8s %10s %12s %12s %8s %8s %10s %8s %8s\n",
+              "DEVICE", "REQUESTS", "READ_BYTES", "WRITE_BYTES", "AVG_QD",
+              "MAX_QD", "SVC(μs)", "MERGES", "ERRORS");
+      fprintf(output_fp, "---------------------------------------------------"
+                         "----------------------------------------\n");
+      header = true;
+    }
+
+    char dev[16];
+    snprintf(dev, sizeof(dev), "%u:%u", key >> 20, key & ((1U << 20) - 1));
+    fprintf(output_fp,
+            "%-8s %10llu %12llu %12llu %8.2f %8llu %10.2f %8llu %8llu\n", dev,
+            ds.completed, ds.read_bytes, ds.write_bytes,
+            (double)ds.depth_sum / ds.issued, ds.max_depth,
+            ds.completed ? (double)ds.service_ns / ds.completed / 1000.0 : 0,
+            ds.back_merges + ds.front_merges, ds.errors);
+  }
+}
+
+static void print_minio_summary() {
+  fprintf(output_fp, "\n========================================\n");
   fprintf(output_fp, "       MinIO-SPECIFIC ANALYSIS\n");
   fprintf(output_fp, "========================================\n\n");
 
@@ -702,6 +1669,20 @@ static void print_minio_summary() {
   fprintf(output_fp, "Metadata Bytes:            %10llu\n",
           minio_stats.metadata_bytes);
 
+  if (minio_stats.encoded_bytes > 0) {
+    fprintf(output_fp, "Erasure Encoded Bytes:     %10llu\n",
+            minio_stats.encoded_bytes);
+    fprintf(output_fp, "Parity Bytes:              %10llu (%.2fx of data)\n",
+            minio_stats.parity_bytes,
+            (double)minio_stats.parity_bytes / minio_stats.encoded_bytes);
+  }
+  if (minio_stats.decoded_bytes > 0)
+    fprintf(output_fp, "Erasure Decoded Bytes:     %10llu\n",
+            minio_stats.decoded_bytes);
+  if (minio_stats.bitrot_bytes > 0)
+    fprintf(output_fp, "Bitrot Hashed Bytes:       %10llu\n",
+            minio_stats.bitrot_bytes);
+
   if (minio_stats.data_bytes > 0) {
     double metadata_overhead =
         (double)minio_stats.metadata_bytes / minio_stats.data_bytes * 100.0;
@@ -765,31 +1746,209 @@ static void print_minio_summary() {
   }
 }
 
-static int find_minio_processes(struct multilayer_io_tracer_bpf *skel) {
+// One-off scan for MinIO processes that were running before the tracer
+// attached. Anything started later is picked up by the sched_process_exec
+// and sched_process_fork programs.
+// MinIO functions probed with -E (erasure coding and bitrot) and -T
+// (xl.meta writes), found by name in the binary's symbol table. Go >= 1.17
+// passes arguments in registers in declaration order, receiver first; a
+// string or interface takes two (ptr, len), a slice three (ptr, len, cap).
+#define GO_ARG_NONE 0xff
+#define MAX_GO_LINKS 16
+
+struct go_probe {
+  const char *symbol;
+  __u32 event_type;
+  __u8 size_reg;    // Register holding the byte count
+  __u8 erasure_reg; // Register holding the *Erasure, for shard counts
+  bool metadata;    // Enabled by -T rather than -E
+};
+
+static const struct go_probe minio_go_probes[] = {
+    // (e *Erasure) EncodeData(ctx context.Context, data []byte)
+    {"github.com/minio/minio/cmd.(*Erasure).EncodeData", 203, 4, 0, false},
+    // (e *Erasure) DecodeDataBlocks(data [][]byte)
+    {"github.com/minio/minio/cmd.(*Erasure).DecodeDataBlocks", 208,
+     GO_ARG_NONE, 0, false},
+    // (b *streamingBitrotWriter) Write(p []byte)
+    {"github.com/minio/minio/cmd.(*streamingBitrotWriter).Write", 205, 2,
+     GO_ARG_NONE, false},
+    // (b *streamingBitrotReader) ReadAt(buf []byte, offset int64)
+    {"github.com/minio/minio/cmd.(*streamingBitrotReader).ReadAt", 205, 2,
+     GO_ARG_NONE, false},
+    // (s *xlStorage) writeAll(ctx context.Context, volume string,
+    //                         path string, b []byte, ...)
+    {"github.com/minio/minio/cmd.(*xlStorage).writeAll", 204, 8, GO_ARG_NONE,
+     true},
+};
+
+static struct bpf_link *go_links[MAX_GO_LINKS];
+static int num_go_links = 0;
+
+static bool layer_enabled(int layer) {
+  return env.layers == 0 || (env.layers & (1u << layer));
+}
+
+static bool minio_uprobes_enabled(void) {
+  return env.minio_only && (env.trace_erasure || env.trace_metadata) &&
+         layer_enabled(LAYER_STORAGE_SERVICE);
+}
+
+static bool is_minio_comm(__u32 pid) {
+  char path[64], comm[MAX_COMM_LEN] = {};
   FILE *fp;
-  char cmd[256];
-  __u32 pid;
+
+  snprintf(path, sizeof(path), "/proc/%u/comm", pid);
+  fp = fopen(path, "r");
+  if (!fp)
+    return false;
+  if (!fgets(comm, sizeof(comm), fp))
+    comm[0] = '\0';
+  fclose(fp);
+
+  comm[strcspn(comm, "\n")] = '\0';
+  return strcmp(comm, "minio") == 0;
+}
+
+// -B, else the executable of the -p process or of the first running MinIO
+static int minio_binary_path(char *buf, size_t size) {
+  char exe[64];
+  __u32 pid = env.minio_pid > 0 ? env.minio_pid : 0;
+  ssize_t len;
+
+  if (env.minio_binary) {
+    snprintf(buf, size, "%s", env.minio_binary);
+    return 0;
+  }
+
+  if (pid == 0) {
+    struct dirent *de;
+    DIR *proc = opendir("/proc");
+
+    if (!proc)
+      return -1;
+    while (pid == 0 && (de = readdir(proc)) != NULL) {
+      char *end;
+      __u32 p = strtoul(de->d_name, &end, 10);
+
+      if (p != 0 && *end == '\0' && is_minio_comm(p))
+        pid = p;
+    }
+    closedir(proc);
+    if (pid == 0)
+      return -1;
+  }
+
+  snprintf(exe, sizeof(exe), "/proc/%u/exe", pid);
+  len = readlink(exe, buf, size - 1);
+  if (len < 0)
+    return -1;
+  buf[len] = '\0';
+  return 0;
+}
+
+// After attach. Uprobes are per binary, so MinIO processes started later
+// from the same executable are covered too.
+static void attach_minio_uprobes(struct multilayer_io_tracer_bpf *skel) {
+  char path[PATH_MAX];
+  int pid = env.minio_pid > 0 ? env.minio_pid : -1;
+
+  if (minio_binary_path(path, sizeof(path)) != 0) {
+    fprintf(stderr, "No MinIO binary found for -E/-T, pass it with -B\n");
+    return;
+  }
+
+  for (size_t i = 0;
+       i < sizeof(minio_go_probes) / sizeof(minio_go_probes[0]); i++) {
+    const struct go_probe *p = &minio_go_probes[i];
+    struct bpf_link *link;
+
+    if (p->metadata ? !env.trace_metadata : !env.trace_erasure)
+      continue;
+    if (num_go_links == MAX_GO_LINKS)
+      break;
+
+    LIBBPF_OPTS(bpf_uprobe_opts, opts, .func_name = p->symbol,
+                .bpf_cookie = p->event_type | (__u64)p->size_reg << 16 |
+                              (__u64)p->erasure_reg << 24);
+    link = bpf_program__attach_uprobe_opts(skel->progs.trace_minio_go, pid,
+                                           path, 0, &opts);
+    if (!link) {
+      if (env.verbose)
+        fprintf(stderr, "MinIO uprobe %s: %s\n", p->symbol, strerror(errno));
+      continue;
+    }
+    go_links[num_go_links++] = link;
+  }
+
+  if (num_go_links == 0)
+    fprintf(stderr, "Warning: no MinIO functions found in %s; a stripped "
+                    "binary (-ldflags -s) has no symbol table\n",
+            path);
+  else if (env.verbose)
+    fprintf(stderr, "Attached %d MinIO uprobes to %s\n", num_go_links, path);
+}
+
+static int find_minio_processes(struct multilayer_io_tracer_bpf *skel) {
+  struct dirent *de;
+  DIR *proc;
   __u8 val = 1;
   int count = 0;
 
-  // Find all MinIO processes
-  fp = popen("pgrep -x minio", "r");
-  if (fp) {
-    while (fscanf(fp, "%u", &pid) == 1) {
-      if (bpf_map_update_elem(bpf_map__fd(skel->maps.minio_pids), &pid, &val,
-                              BPF_ANY) == 0) {
-        if (env.verbose) {
-          printf("Tracking MinIO PID: %u\n", pid);
-        }
-        count++;
+  proc = opendir("/proc");
+  if (!proc)
+    return 0;
+
+  while ((de = readdir(proc)) != NULL) {
+    char *end;
+    __u32 pid = strtoul(de->d_name, &end, 10);
+
+    if (pid == 0 || *end != '\0' || !is_minio_comm(pid))
+      continue;
+
+    if (bpf_map_update_elem(bpf_map__fd(skel->maps.minio_pids), &pid, &val,
+                            BPF_ANY) == 0) {
+      if (env.verbose) {
+        printf("Tracking MinIO PID: %u\n", pid);
       }
+      count++;
     }
-    pclose(fp);
   }
+  closedir(proc);
 
   return count;
 }
 
+// Must run before load: the per-object table costs a hash update per VFS
+// call and bio, so the probes only keep it with -O. Paths come from
+// bpf_d_path() in the LSM file hooks, which need trampolines, or else from
+// the openat() argument.
+static void configure_object_tracking(struct multilayer_io_tracer_bpf *skel,
+                                      bool fentry) {
+  bool objects = env.top_objects > 0 || env.agent_addr;
+
+  skel->rodata->track_objects = objects;
+  skel->rodata->openat_paths = objects && !fentry;
+  bpf_program__set_autoload(skel->progs.trace_openat_exit, objects && !fentry);
+  bpf_program__set_autoload(skel->progs.fentry_path_open, objects && fentry);
+  bpf_program__set_autoload(skel->progs.fentry_path_access, objects && fentry);
+}
+
+// Must run before load. The discovery programs only matter when tracing
+// by PID, so leave them unattached otherwise.
+static void configure_minio_discovery(struct multilayer_io_tracer_bpf *skel) {
+  bool pid_mode =
+      env.minio_only && (env.minio_pid > 0 || env.auto_detect_minio);
+
+  bpf_program__set_autoload(skel->progs.trace_minio_exec,
+                            pid_mode && env.auto_detect_minio);
+  bpf_program__set_autoload(skel->progs.trace_minio_fork, pid_mode);
+  bpf_program__set_autoload(skel->progs.trace_minio_exit, pid_mode);
+  bpf_program__set_autoload(skel->progs.trace_minio_go,
+                            minio_uprobes_enabled());
+  skel->rodata->minio_discovery = env.auto_detect_minio;
+}
+
 static int add_minio_pid(struct multilayer_io_tracer_bpf *skel, __u32 pid) {
   __u8 val = 1;
 
@@ -804,6 +1963,378 @@ static int add_minio_pid(struct multilayer_io_tracer_bpf *skel, __u32 pid) {
   return -1;
 }
 
+// Looks the given symbols up in one pass over /proc/kallsyms. Returns false
+// if the file could not be read.
+static bool kallsyms_find(const char *const *names, bool *found, int n) {
+  char line[256], sym[128];
+  FILE *fp;
+
+  for (int i = 0; i < n; i++)
+    found[i] = false;
+
+  fp = fopen("/proc/kallsyms", "r");
+  if (!fp)
+    return false;
+
+  while (fgets(line, sizeof(line), fp)) {
+    if (sscanf(line, "%*s %*s %127s", sym) != 1)
+      continue;
+    for (int i = 0; i < n; i++) {
+      if (!found[i] && strcmp(sym, names[i]) == 0)
+        found[i] = true;
+    }
+  }
+  fclose(fp);
+  return true;
+}
+
+// Must run before load: picks the probes this kernel can attach.
+//  - Folio kernels renamed the page cache hooks, and the old ones are
+//    either gone or wrap the new ones, so exactly one of each pair is used.
+//  - io_uring_submit_req replaced io_uring_submit_sqe in 6.0, and io_uring
+//    may be compiled out altogether.
+//  - jbd2, ext4 and xfs are often modules, and their tracepoints only
+//    exist while loaded. The journal probes also need their BTF.
+static void configure_kernel_probes(struct multilayer_io_tracer_bpf *skel) {
+  static const char *const syms[] = {"folio_mark_accessed",
+                                     "__tracepoint_writeback_dirty_folio",
+                                     "__tracepoint_io_uring_submit_req",
+                                     "__tracepoint_io_uring_submit_sqe",
+                                     "__tracepoint_jbd2_handle_stats",
+                                     "__tracepoint_ext4_da_write_pages",
+                                     "__tracepoint_xfs_log_ticket_ungrant"};
+  bool found[7];
+
+  // Without kallsyms assume a current kernel, and no journal probes
+  if (!kallsyms_find(syms, found, 7)) {
+    found[0] = found[1] = found[2] = true;
+    found[3] = false;
+  }
+  bool uring = found[2] || found[3];
+
+  bpf_program__set_autoload(skel->progs.trace_cache_access_folio, found[0]);
+  bpf_program__set_autoload(skel->progs.trace_cache_access_page, !found[0]);
+  bpf_program__set_autoload(skel->progs.trace_dirty_folio, found[1]);
+  bpf_program__set_autoload(skel->progs.trace_dirty_page, !found[1]);
+  bpf_program__set_autoload(skel->progs.trace_uring_submit, found[2]);
+  bpf_program__set_autoload(skel->progs.trace_uring_submit_sqe,
+                            !found[2] && found[3]);
+  bpf_program__set_autoload(skel->progs.trace_uring_complete, uring);
+  bpf_program__set_autoload(skel->progs.trace_jbd2_handle, found[4]);
+  bpf_program__set_autoload(skel->progs.trace_jbd2_commit, found[4]);
+  bpf_program__set_autoload(skel->progs.trace_ext4_da_write_pages, found[5]);
+  bpf_program__set_autoload(skel->progs.trace_xfs_log_ungrant, found[6]);
+  bpf_program__set_autoload(skel->progs.trace_xfs_log_regrant, found[6]);
+
+  if (env.verbose) {
+    fprintf(stderr, "Page cache probes: %s, %s\n",
+            found[0] ? "folio_mark_accessed" : "mark_page_accessed",
+            found[1] ? "writeback_dirty_folio" : "writeback_dirty_page");
+    if (!uring)
+      fprintf(stderr, "io_uring tracepoints not available, not tracing "
+                      "io_uring\n");
+    fprintf(stderr, "Journal probes:%s%s%s%s\n", found[4] ? " jbd2" : "",
+            found[5] ? " ext4" : "", found[6] ? " xfs" : "",
+            found[4] || found[5] || found[6] ? "" : " none");
+  }
+}
+
+// Must run before load: the VFS, splice and bio probes come as kprobes and
+// as BPF trampolines (fentry/fexit), and exactly one of each is loaded.
+// Trampolines skip the int3 trap and get typed arguments, but need BTF and
+// per-architecture support in the kernel.
+static void configure_attach_mode(struct multilayer_io_tracer_bpf *skel,
+                                  bool fentry) {
+  struct bpf_program *kprobes[] = {
+      skel->progs.trace_vfs_read,     skel->progs.trace_vfs_read_ret,
+      skel->progs.trace_vfs_write,    skel->progs.trace_vfs_write_ret,
+      skel->progs.trace_fs_sync,      skel->progs.trace_fs_sync_ret,
+      skel->progs.trace_minio_splice, skel->progs.trace_bio_submit,
+      skel->progs.trace_bio_complete,
+  };
+  struct bpf_program *trampolines[] = {
+      skel->progs.fentry_vfs_read,     skel->progs.fexit_vfs_read,
+      skel->progs.fentry_vfs_write,    skel->progs.fexit_vfs_write,
+      skel->progs.fentry_fs_sync,      skel->progs.fexit_fs_sync,
+      skel->progs.fentry_minio_splice, skel->progs.fentry_bio_submit,
+      skel->progs.fentry_bio_complete,
+  };
+
+  for (size_t i = 0; i < sizeof(kprobes) / sizeof(kprobes[0]); i++) {
+    bpf_program__set_autoload(kprobes[i], !fentry);
+    bpf_program__set_autoload(trampolines[i], fentry);
+  }
+}
+
+// Programs of each layer, by name prefix, for -l. The MinIO discovery and
+// -O path programs are not listed and follow their own options.
+static const struct {
+  const char *prefix;
+  int layer;
+} layer_programs[] = {
+    {"trace_app_", LAYER_APPLICATION},
+    {"trace_uring_", LAYER_APPLICATION},
+    {"trace_mmap_fault", LAYER_APPLICATION},
+    {"trace_minio_openat", LAYER_STORAGE_SERVICE},
+    {"trace_minio_splice", LAYER_STORAGE_SERVICE},
+    {"fentry_minio_splice", LAYER_STORAGE_SERVICE},
+    {"trace_minio_go", LAYER_STORAGE_SERVICE},
+    {"trace_vfs_", LAYER_OPERATING_SYSTEM},
+    {"fentry_vfs_", LAYER_OPERATING_SYSTEM},
+    {"fexit_vfs_", LAYER_OPERATING_SYSTEM},
+    {"trace_cache_", LAYER_OPERATING_SYSTEM},
+    {"trace_dirty_", LAYER_OPERATING_SYSTEM},
+    {"trace_fs_sync", LAYER_FILESYSTEM},
+    {"fentry_fs_sync", LAYER_FILESYSTEM},
+    {"fexit_fs_sync", LAYER_FILESYSTEM},
+    {"trace_jbd2_", LAYER_FILESYSTEM},
+    {"trace_xfs_log_", LAYER_FILESYSTEM},
+    {"trace_ext4_", LAYER_FILESYSTEM},
+    {"trace_writeback_inode", LAYER_FILESYSTEM},
+    {"trace_bio_", LAYER_DEVICE},
+    {"fentry_bio_", LAYER_DEVICE},
+    {"trace_rq_", LAYER_DEVICE},
+};
+
+// Must run last before load: only ever turns programs off, and each one
+// skipped is one less to verify and attach. Lower layers still work without
+// the upper ones, but their events are not correlated to a request.
+static void configure_layers(struct multilayer_io_tracer_bpf *skel) {
+  struct bpf_program *prog;
+
+  if (env.layers == 0)
+    return;
+
+  bpf_object__for_each_program(prog, skel->obj) {
+    const char *name = bpf_program__name(prog);
+
+    for (size_t i = 0; i < sizeof(layer_programs) / sizeof(layer_programs[0]);
+         i++) {
+      if (strncmp(name, layer_programs[i].prefix,
+                  strlen(layer_programs[i].prefix)) == 0 &&
+          !layer_enabled(layer_programs[i].layer))
+        bpf_program__set_autoload(prog, false);
+    }
+  }
+}
+
+// Loading a tracing program succeeds on kernels that cannot attach it, so
+// try one before committing to trampolines. bio_endio only emits for bios
+// already in bio_inflight, which is still empty here, and fexit_vfs_read
+// only for reads its fentry half started.
+static bool trampolines_attach(struct multilayer_io_tracer_bpf *skel) {
+  struct bpf_program *prog = skel->progs.fentry_bio_complete;
+  struct bpf_link *link;
+
+  if (!bpf_program__autoload(prog))
+    prog = skel->progs.fexit_vfs_read;
+  if (!bpf_program__autoload(prog))
+    return true; // Nothing to go wrong, as far as we can tell
+
+  link = bpf_program__attach(prog);
+  if (!link)
+    return false;
+  bpf_link__destroy(link);
+  return true;
+}
+
+// With -F DIR the programs stay attached after exit, through links pinned
+// in DIR/links, and the maps stay pinned in DIR/maps. tracer_config is
+// left paused, so in between runs the probes return before counting or
+// streaming anything. The next run with the same options loads no program:
+// it reuses the maps, clears them and unpauses, which skips verification
+// and attach. Other options replace the pins; rm -r DIR detaches it all.
+static bool pins_reused = false;
+
+static void pin_path(char *buf, size_t size, const char *kind,
+                     const char *name) {
+  snprintf(buf, size, "%s/%s/%s", env.pin_dir, kind, name);
+}
+
+// The MinIO uprobes are pinned as trace_minio_go.N
+static bool link_pinned(const char *prog_name) {
+  char path[PATH_MAX];
+
+  pin_path(path, sizeof(path), "links", prog_name);
+  if (access(path, F_OK) == 0)
+    return true;
+  strncat(path, ".0", sizeof(path) - strlen(path) - 1);
+  return access(path, F_OK) == 0;
+}
+
+static bool pinned_kprobes(void) {
+  return link_pinned("trace_vfs_read") || link_pinned("trace_fs_sync") ||
+         link_pinned("trace_bio_submit");
+}
+
+static void remove_pins(void) {
+  static const char *const kinds[] = {"links", "maps"};
+  char path[PATH_MAX];
+
+  for (int i = 0; i < 2; i++) {
+    struct dirent *de;
+    DIR *dir;
+
+    pin_path(path, sizeof(path), kinds[i], "");
+    dir = opendir(path);
+    if (!dir)
+      continue;
+    while ((de = readdir(dir)) != NULL) {
+      if (de->d_name[0] == '.' && (de->d_name[1] == '\0' ||
+                                   strcmp(de->d_name, "..") == 0))
+        continue;
+      pin_path(path, sizeof(path), kinds[i], de->d_name);
+      unlink(path);
+    }
+    closedir(dir);
+    pin_path(path, sizeof(path), kinds[i], "");
+    rmdir(path);
+  }
+  rmdir(env.pin_dir);
+}
+
+// Must run last before load. True if DIR holds the pins of a run with the
+// same options: the same .rodata and the same set of loaded programs. Then
+// no program is loaded and every map is reused from its pin.
+static bool reuse_pins(struct multilayer_io_tracer_bpf *skel) {
+  struct bpf_program *prog;
+  struct bpf_map *map;
+  char path[PATH_MAX];
+  size_t size = 0;
+  const void *rodata = bpf_map__initial_value(skel->maps.rodata, &size);
+  void *pinned = malloc(bpf_map__value_size(skel->maps.rodata));
+  __u32 key = 0;
+  bool same = false;
+  int fd;
+
+  pin_path(path, sizeof(path), "maps", bpf_map__name(skel->maps.rodata));
+  fd = bpf_obj_get(path);
+  if (fd >= 0 && pinned && rodata &&
+      size <= bpf_map__value_size(skel->maps.rodata) &&
+      bpf_map_lookup_elem(fd, &key, pinned) == 0)
+    same = memcmp(pinned, rodata, size) == 0;
+  if (fd >= 0)
+    close(fd);
+  free(pinned);
+  if (fd < 0)
+    return false;
+
+  bpf_object__for_each_program(prog, skel->obj) {
+    if (bpf_program__autoload(prog) != link_pinned(bpf_program__name(prog)))
+      same = false;
+  }
+  if (!same) {
+    if (env.verbose)
+      fprintf(stderr, "Programs pinned in %s were loaded with other "
+                      "options, replacing them\n",
+              env.pin_dir);
+    remove_pins();
+    return false;
+  }
+
+  bpf_object__for_each_program(prog, skel->obj)
+    bpf_program__set_autoload(prog, false);
+  bpf_object__for_each_map(map, skel->obj) {
+    pin_path(path, sizeof(path), "maps", bpf_map__name(map));
+    bpf_map__set_pin_path(map, path);
+  }
+  return true;
+}
+
+// After load with reused pins: start from empty maps, as a fresh load
+// would. The inode path cache stays, it is as valid as before.
+static void clear_pinned_maps(struct multilayer_io_tracer_bpf *skel) {
+  int ncpus = libbpf_num_possible_cpus();
+  struct bpf_map *map;
+
+  bpf_object__for_each_map(map, skel->obj) {
+    enum bpf_map_type type = bpf_map__type(map);
+    size_t key_size = bpf_map__key_size(map);
+    size_t value_size = bpf_map__value_size(map);
+    int fd = bpf_map__fd(map);
+    char *key, *next, *zero;
+
+    if (bpf_map__is_internal(map) || map == skel->maps.inode_paths ||
+        type == BPF_MAP_TYPE_RINGBUF || type == BPF_MAP_TYPE_ARRAY_OF_MAPS)
+      continue;
+    if (type == BPF_MAP_TYPE_PERCPU_ARRAY ||
+        type == BPF_MAP_TYPE_PERCPU_HASH ||
+        type == BPF_MAP_TYPE_LRU_PERCPU_HASH)
+      value_size = ((value_size + 7) & ~(size_t)7) * ncpus;
+
+    key = calloc(1, key_size);
+    next = calloc(1, key_size);
+    zero = calloc(1, value_size);
+    if (key && next && zero) {
+      if (type == BPF_MAP_TYPE_ARRAY || type == BPF_MAP_TYPE_PERCPU_ARRAY) {
+        for (__u32 i = 0; i < bpf_map__max_entries(map); i++)
+          bpf_map_update_elem(fd, &i, zero, BPF_ANY);
+      } else {
+        int err = bpf_map_get_next_key(fd, NULL, key);
+        while (err == 0) {
+          err = bpf_map_get_next_key(fd, key, next);
+          bpf_map_delete_elem(fd, key);
+          memcpy(key, next, key_size);
+        }
+      }
+    }
+    free(key);
+    free(next);
+    free(zero);
+  }
+}
+
+// At exit: pause the programs and, unless they already are, pin them and
+// their maps. Links are then disconnected so destroying the skeleton
+// leaves them attached.
+static void pin_programs(struct multilayer_io_tracer_bpf *skel) {
+  const struct bpf_object_skeleton *s = skel->skeleton;
+  struct tracer_config config = {.paused = 1};
+  char path[PATH_MAX];
+  __u32 key = 0;
+  int err = 0;
+
+  bpf_map_update_elem(bpf_map__fd(skel->maps.tracer_config_map), &key,
+                      &config, BPF_ANY);
+  if (pins_reused)
+    return;
+
+  if (mkdir(env.pin_dir, 0700) != 0 && errno != EEXIST)
+    err = -errno;
+  pin_path(path, sizeof(path), "maps", "");
+  if (!err)
+    err = bpf_object__pin_maps(skel->obj, path);
+  for (int i = 0; !err && i < s->prog_cnt; i++) {
+    struct bpf_link *link = *s->progs[i].link;
+    if (!link)
+      continue;
+    pin_path(path, sizeof(path), "links", s->progs[i].name);
+    err = bpf_link__pin(link, path);
+  }
+  for (int i = 0; !err && i < num_go_links; i++) {
+    char name[64];
+    snprintf(name, sizeof(name), "trace_minio_go.%d", i);
+    pin_path(path, sizeof(path), "links", name);
+    err = bpf_link__pin(go_links[i], path);
+  }
+  if (err) {
+    fprintf(stderr, "Failed to pin programs to %s: %s\n", env.pin_dir,
+            strerror(-err));
+    remove_pins();
+    return;
+  }
+
+  for (int i = 0; i < s->prog_cnt; i++) {
+    if (*s->progs[i].link)
+      bpf_link__disconnect(*s->progs[i].link);
+  }
+  for (int i = 0; i < num_go_links; i++)
+    bpf_link__disconnect(go_links[i]);
+  if (env.verbose)
+    fprintf(stderr, "Programs left attached and paused in %s\n",
+            env.pin_dir);
+}
+
 static int configure_minio_tracing(struct multilayer_io_tracer_bpf *skel) {
   struct minio_config config = {0};
   __u32 key = 0;
@@ -814,15 +2345,8 @@ static int configure_minio_tracing(struct multilayer_io_tracer_bpf *skel) {
       config.trace_mode = MINIO_TRACE_PID;
       add_minio_pid(skel, env.minio_pid);
     } else if (env.auto_detect_minio) {
+      // Seeded after attach, see main()
       config.trace_mode = MINIO_TRACE_PID;
-      int count = find_minio_processes(skel);
-      if (count == 0) {
-        fprintf(stderr, "Warning: No MinIO processes found. Falling back to "
-                        "name-based detection.\n");
-        config.trace_mode = MINIO_TRACE_NAME;
-      } else {
-        printf("Found %d MinIO process(es)\n", count);
-      }
     } else {
       config.trace_mode = MINIO_TRACE_NAME;
     }
@@ -853,67 +2377,2123 @@ static int configure_minio_tracing(struct multilayer_io_tracer_bpf *skel) {
   return 0;
 }
 
-static int bump_memlock_rlimit(void) {
-  struct rlimit rlim_new = {
-      .rlim_cur = RLIM_INFINITY,
-      .rlim_max = RLIM_INFINITY,
-  };
-  return setrlimit(RLIMIT_MEMLOCK, &rlim_new);
+// cgroup v2 ids are the kernfs node id, which the kernel hands out as the
+// file handle of the cgroup directory
+static int cgroup_id_from_path(const char *path, __u64 *id) {
+  union {
+    struct file_handle fh;
+    char buf[sizeof(struct file_handle) + sizeof(__u64)];
+  } h;
+  char full[PATH_MAX];
+  int mount_id;
+
+  if (path[0] != '/') {
+    snprintf(full, sizeof(full), "/sys/fs/cgroup/%s", path);
+    path = full;
+  }
+
+  h.fh.handle_bytes = sizeof(__u64);
+  if (name_to_handle_at(AT_FDCWD, path, &h.fh, &mount_id, 0) != 0)
+    return -errno;
+
+  memcpy(id, h.fh.f_handle, sizeof(*id));
+  return 0;
 }
 
-int main(int argc, char **argv) {
-  struct ring_buffer *rb = NULL;
-  struct multilayer_io_tracer_bpf *skel;
-  int err = 0;
+// Must run between open and load: filter_mode is read-only once loaded
+static void configure_filter_mode(struct multilayer_io_tracer_bpf *skel) {
+  __u8 mode = 0;
 
-  err = argp_parse(&argp, argc, argv, 0, NULL, NULL);
-  if (err)
-    return err;
+  if (env.num_target_tgids > 0)
+    mode |= FILTER_TGID;
+  if (env.num_target_cgroups > 0)
+    mode |= FILTER_CGROUP;
+  skel->rodata->filter_mode = mode;
+}
 
-  signal(SIGINT, sig_handler);
-  signal(SIGTERM, sig_handler);
+static int configure_filter_targets(struct multilayer_io_tracer_bpf *skel) {
+  int tgid_fd = bpf_map__fd(skel->maps.target_tgids);
+  int cgroup_fd = bpf_map__fd(skel->maps.target_cgroups);
+  __u8 one = 1;
 
-  if (env.output_file) {
-    output_fp = fopen(env.output_file, "w");
-    if (!output_fp) {
-      fprintf(stderr, "Failed to open output file %s: %s\n", env.output_file,
-              strerror(errno));
-      return 1;
+  for (int i = 0; i < env.num_target_tgids; i++) {
+    if (bpf_map_update_elem(tgid_fd, &env.target_tgids[i], &one, BPF_ANY)) {
+      fprintf(stderr, "Failed to add target PID %u\n", env.target_tgids[i]);
+      return -1;
     }
-  } else {
-    output_fp = stdout;
   }
 
-  if (bump_memlock_rlimit()) {
-    fprintf(stderr, "Failed to increase RLIMIT_MEMLOCK limit!\n");
-    return 1;
+  for (int i = 0; i < env.num_target_cgroups; i++) {
+    __u64 cgid;
+    int err = cgroup_id_from_path(env.target_cgroups[i], &cgid);
+    if (err) {
+      fprintf(stderr, "Failed to resolve cgroup %s: %s\n",
+              env.target_cgroups[i], strerror(-err));
+      return -1;
+    }
+    if (bpf_map_update_elem(cgroup_fd, &cgid, &one, BPF_ANY)) {
+      fprintf(stderr, "Failed to add target cgroup %s\n",
+              env.target_cgroups[i]);
+      return -1;
+    }
+    if (env.verbose)
+      fprintf(stderr, "Tracing cgroup %s (id %llu)\n", env.target_cgroups[i],
+              cgid);
   }
 
-  skel = multilayer_io_tracer_bpf__open();
-  if (!skel) {
-    fprintf(stderr, "Failed to open BPF skeleton\n");
-    return 1;
-  }
+  return 0;
+}
 
-  err = multilayer_io_tracer_bpf__load(skel);
-  if (err) {
-    fprintf(stderr, "Failed to load BPF skeleton: %d\n", err);
-    goto cleanup;
-  }
+static int configure_tracer(struct multilayer_io_tracer_bpf *skel) {
+  struct tracer_config config = {0};
+  __u32 key = 0;
 
-  // Configure MinIO tracing
-  err = configure_minio_tracing(skel);
-  if (err) {
-    fprintf(stderr, "Failed to configure MinIO tracing\n");
+  config.aggregate = kernel_totals();
+  config.skip_events = env.aggregate;
+  config.sharded = env.shard_mode != SHARD_NONE;
+  config.per_process = env.exporter_addr != NULL;
+
+  if (sampling_enabled()) {
+    int ncpus = libbpf_num_possible_cpus();
+
+    for (int i = 1; i < SAMPLE_LAYERS; i++) {
+      __u64 rate = (__u64)(env.sample_rate[i] > 1 ? env.sample_rate[i] : 1) *
+                   sample_scale;
+      config.sample_rate[i] = rate > 0xFFFFFFFF ? 0xFFFFFFFF : rate;
+    }
+    if (env.budget > 0) {
+      __u32 per_cpu = env.budget / (ncpus > 0 ? ncpus : 1) / sample_scale;
+      config.budget_per_cpu = per_cpu > 0 ? per_cpu : 1;
+    }
+  }
+
+  if (env.wakeup_kb > 0) {
+    // Past half a ring the producer would fill it before anyone is woken
+    __u64 ring_size = config.sharded
+                          ? RING_SHARD_SIZE
+                          : bpf_map__max_entries(skel->maps.events);
+    __u64 bytes = (__u64)env.wakeup_kb * 1024;
+
+    config.wakeup_bytes = bytes < ring_size / 2 ? bytes : ring_size / 2;
+  }
+
+  if (bpf_map_update_elem(bpf_map__fd(skel->maps.tracer_config_map), &key,
+                          &config, BPF_ANY) != 0) {
+    fprintf(stderr, "Failed to update tracer configuration\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+// Sum one layer_aggregates entry over all CPUs. Returns false if it has
+// never been hit.
+static bool sum_aggregate(int fd, __u32 idx, struct layer_agg *values,
+                          int ncpus, struct layer_agg *sum) {
+  memset(sum, 0, sizeof(*sum));
+  if (bpf_map_lookup_elem(fd, &idx, values) != 0)
+    return false;
+
+  for (int cpu = 0; cpu < ncpus; cpu++) {
+    struct layer_agg *v = &values[cpu];
+    if (v->events == 0)
+      continue;
+    sum->event_type = v->event_type;
+    sum->events += v->events;
+    sum->bytes += v->bytes;
+    sum->aligned_bytes += v->aligned_bytes;
+    sum->latency_ns += v->latency_ns;
+    sum->metadata_ops += v->metadata_ops;
+    sum->journal_ops += v->journal_ops;
+    sum->cache_hits += v->cache_hits;
+    sum->minio_events += v->minio_events;
+    sum->minio_bytes += v->minio_bytes;
+    sum->xl_meta_ops += v->xl_meta_ops;
+  }
+  return sum->events > 0;
+}
+
+// Add one summed entry to the per-layer and MinIO totals
+static void fold_aggregate(struct layer_stats *ls, struct minio_stats *ms,
+                           int layer, const struct layer_agg *sum) {
+  struct layer_stats *s = &ls[layer];
+
+  s->total_events += sum->events;
+  if (is_cache_lookup(sum->event_type)) {
+    count_cache_lookup(s, sum->event_type, sum->events, sum->bytes,
+                       sum->aligned_bytes);
+    return;
+  }
+  if (sum->event_type == 407) { // FS_WRITEBACK, as in update_layer_stats()
+    s->writeback_bytes += sum->bytes;
+    return;
+  }
+  if (sum->event_type == 408) { // FS_JOURNAL_COMMIT
+    s->journal_bytes += sum->bytes;
+    return;
+  }
+  if (sum->event_type == 107) { // APP_MMAP_READ
+    s->mmap_bytes += sum->bytes;
+    return;
+  }
+  if (sum->event_type == 205) { // MINIO_BITROT_CHECK
+    ms->bitrot_bytes += sum->bytes;
+    return;
+  }
+
+  s->total_bytes += sum->bytes;
+  s->aligned_bytes += sum->aligned_bytes;
+  s->total_latency += sum->latency_ns;
+  s->metadata_ops += sum->metadata_ops;
+  s->journal_ops += sum->journal_ops;
+
+  s->minio_events += sum->minio_events;
+  s->minio_bytes += sum->minio_bytes;
+  s->xl_meta_ops += sum->xl_meta_ops;
+  if (sum->xl_meta_ops > 0) {
+    ms->xl_meta_operations += sum->xl_meta_ops;
+    ms->metadata_bytes += sum->minio_bytes;
+  }
+
+  switch (sum->event_type) {
+  case 201: // MINIO_OBJECT_PUT
+    ms->total_objects_written += sum->minio_events;
+    ms->data_bytes += sum->minio_bytes;
+    break;
+  case 202: // MINIO_OBJECT_GET
+    ms->total_objects_read += sum->minio_events;
+    break;
+  case 203: // MINIO_ERASURE_WRITE
+    s->erasure_writes += sum->minio_events;
+    ms->erasure_blocks_written += sum->minio_events;
+    ms->encoded_bytes += sum->bytes;
+    if (sum->aligned_bytes > sum->bytes)
+      ms->parity_bytes += sum->aligned_bytes - sum->bytes;
+    break;
+  case 208: // MINIO_ERASURE_READ
+    ms->decoded_bytes += sum->bytes;
+    break;
+  case 204: // MINIO_METADATA_UPDATE
+    ms->metadata_bytes += sum->bytes;
+    break;
+  case 206: // MINIO_MULTIPART
+    s->multipart_ops += sum->minio_events;
+    ms->multipart_uploads += sum->minio_events;
+    break;
+  }
+}
+
+// Rebuild stats[] and minio_stats from the per-CPU in-kernel aggregates.
+// The kernel counters are cumulative, so the userspace totals are replaced
+// rather than added to.
+static int read_aggregates(struct multilayer_io_tracer_bpf *skel) {
+  int fd = bpf_map__fd(skel->maps.layer_aggregates);
+  int ncpus = libbpf_num_possible_cpus();
+  struct layer_agg *values;
+
+  if (ncpus <= 0)
+    return -1;
+
+  values = calloc(ncpus, sizeof(*values));
+  if (!values)
+    return -1;
+
+  memset(stats, 0, sizeof(stats));
+  memset(&minio_stats, 0, sizeof(minio_stats));
+
+  for (__u32 idx = 0; idx < AGG_ENTRIES; idx++) {
+    struct layer_agg sum;
+
+    if (sum_aggregate(fd, idx, values, ncpus, &sum))
+      fold_aggregate(stats, &minio_stats,
+                     idx / (AGG_EVENT_SLOTS * AGG_SYSTEM_SLOTS), &sum);
+  }
+
+  free(values);
+  return 0;
+}
+
+// Sum the per-CPU streaming counters for one layer
+static int read_sample_counts(__u32 layer, struct sample_counts *out) {
+  int ncpus = libbpf_num_possible_cpus();
+  struct sample_counts *values;
+
+  memset(out, 0, sizeof(*out));
+  if (sample_stats_fd < 0 || ncpus <= 0)
+    return -1;
+
+  values = calloc(ncpus, sizeof(*values));
+  if (!values)
+    return -1;
+
+  if (bpf_map_lookup_elem(sample_stats_fd, &layer, values) == 0) {
+    for (int cpu = 0; cpu < ncpus; cpu++) {
+      out->seen += values[cpu].seen;
+      out->emitted += values[cpu].emitted;
+      out->ring_drops += values[cpu].ring_drops;
+    }
+  }
+  free(values);
+  return 0;
+}
+
+// Events lost so far, in the kernel ring or in the userspace queues
+static __u64 total_drops(void) {
+  __u64 drops = 0;
+
+  for (__u32 layer = 0; layer < SAMPLE_LAYERS; layer++) {
+    struct sample_counts sc;
+    if (read_sample_counts(layer, &sc) == 0)
+      drops += sc.ring_drops;
+  }
+  for (int i = 0; i < num_drainers; i++)
+    drops += atomic_load(&drainers[i].queue.drops);
+  return drops;
+}
+
+// Called once per interval with -G: back off quickly while events are
+// dropped, and return towards the configured rates after 10 quiet intervals
+static void adapt_sampling(struct multilayer_io_tracer_bpf *skel) {
+  static __u64 last_drops = 0;
+  static int quiet = 0;
+  __u64 drops = total_drops();
+  __u32 scale = sample_scale;
+
+  if (drops > last_drops) {
+    quiet = 0;
+    if (scale < (1U << 16))
+      scale *= 2;
+  } else if (++quiet >= 10 && scale > 1) {
+    quiet = 0;
+    scale /= 2;
+  }
+  last_drops = drops;
+
+  if (scale != sample_scale) {
+    sample_scale = scale;
+    configure_tracer(skel);
+    if (env.verbose)
+      fprintf(stderr, "Adaptive sampling: rate scale now %ux\n", scale);
+  }
+}
+
+static void print_sampling_summary() {
+  bool header = false;
+
+  if (sample_stats_fd < 0)
+    return;
+
+  for (__u32 layer = 1; layer < SAMPLE_LAYERS; layer++) {
+    struct sample_counts sc;
+
+    if (read_sample_counts(layer, &sc) != 0 || sc.seen == 0)
+      continue;
+    if (!sampling_enabled() && sc.ring_drops == 0)
+      continue;
+
+    if (!header) {
+      fprintf(output_fp, "\nEvent Streaming%s:\n",
+              sampling_enabled() ? " (sampled, totals above are exact)" : "");
+      fprintf(output_fp, "%-15s %12s %12s %10s %12s\n", "LAYER", "SEEN",
+              "STREAMED", "SCALE", "RING_DROPS");
+      header = true;
+    }
+    fprintf(output_fp, "%-15s %12llu %12llu %9.1fx %12llu\n",
+            layer_names[layer], sc.seen, sc.emitted,
+            sc.emitted ? (double)sc.seen / sc.emitted : 0, sc.ring_drops);
+  }
+
+  if (header && sampling_enabled() && env.correlation_mode)
+    fprintf(output_fp, "Per-request figures cover streamed requests only; "
+                       "multiply counts by SCALE to estimate totals.\n");
+}
+
+// One line of per-layer byte totals, printed at every aggregation interval
+// Calls fn for every entry of the object table. The map is LRU and
+// changes while it is walked, so the walk is bounded by its size rather
+// than by get_next_key running out. Returns the entries seen.
+static size_t walk_objects(void (*fn)(const struct object_key *,
+                                      const struct object_stats *, void *),
+                           void *ctx) {
+  struct object_key key, next_key, *prev = NULL;
+  struct object_stats os;
+  size_t seen = 0;
+
+  while (seen < MAX_TRACKED_OBJECTS &&
+         bpf_map_get_next_key(object_stats_fd, prev, &next_key) == 0) {
+    key = next_key;
+    prev = &key;
+    if (bpf_map_lookup_elem(object_stats_fd, &key, &os) != 0)
+      continue;
+    fn(&key, &os, ctx);
+    seen++;
+  }
+  return seen;
+}
+
+// Path of an object from inode_paths, or false if it was never resolved
+// or has been evicted
+static bool object_path(const struct object_key *key,
+                        struct inode_path *path) {
+  if (inode_paths_fd < 0 ||
+      bpf_map_lookup_elem(inode_paths_fd, key, path) != 0)
+    return false;
+  path->path[MAX_FILENAME_LEN - 1] = '\0';
+  return true;
+}
+
+// MinIO lays objects out as <drive>/<bucket>/<object>/..., and -D names
+// the drive, or the common prefix of several (/mnt/disk for /mnt/disk1..N).
+// Returns the part of path below the drive, or NULL.
+static const char *drive_relative(const char *path) {
+  const char *dir = env.minio_data_dir;
+
+  if (!dir)
+    return NULL;
+
+  size_t dir_len = strlen(dir);
+  while (dir_len > 1 && dir[dir_len - 1] == '/')
+    dir_len--;
+  if (strncmp(path, dir, dir_len) != 0)
+    return NULL;
+
+  const char *name = strchr(path + dir_len, '/');
+  return name ? name + 1 : NULL;
+}
+
+static bool path_bucket(const char *path, char *bucket, size_t size) {
+  const char *name = drive_relative(path);
+
+  if (!name)
+    return false;
+  const char *end = strchr(name, '/');
+  if (!end || end == name) // A file directly in the drive
+    return false;
+
+  size_t len = end - name;
+  if (len >= size)
+    len = size - 1;
+  memcpy(bucket, name, len);
+  bucket[len] = '\0';
+  return true;
+}
+
+struct object_sample {
+  struct object_key key;
+  struct object_stats os;
+  double rank;
+};
+
+struct top_objects {
+  struct object_sample *top;
+  int k;
+  int n;
+};
+
+static double object_rank(const struct object_stats *os) {
+  if (!env.objects_by_amp)
+    return os->device_bytes;
+  return os->app_bytes > 0 ? (double)os->device_bytes / os->app_bytes : 0;
+}
+
+// Insert into top[], kept sorted by rank
+static void add_top_object(const struct object_key *key,
+                           const struct object_stats *os, void *ctx) {
+  struct top_objects *t = ctx;
+  double rank = object_rank(os);
+
+  if (rank <= 0 || (t->n == t->k && rank <= t->top[t->k - 1].rank))
+    return;
+
+  int i = t->n < t->k ? t->n++ : t->k - 1;
+  for (; i > 0 && t->top[i - 1].rank < rank; i--)
+    t->top[i] = t->top[i - 1];
+  t->top[i].key = *key;
+  t->top[i].os = *os;
+  t->top[i].rank = rank;
+}
+
+static void print_top_objects(void) {
+  struct top_objects t = {.k = env.top_objects};
+
+  if (object_stats_fd < 0 || env.top_objects <= 0)
+    return;
+  t.top = calloc(t.k, sizeof(*t.top));
+  if (!t.top)
+    return;
+
+  size_t tracked = walk_objects(add_top_object, &t);
+
+  fprintf(output_fp, "\nTop %d Objects by %s (%zu tracked):\n",
+          env.top_objects,
+          env.objects_by_amp ? "amplification" : "device bytes", tracked);
+  fprintf(output_fp, "%-40s %12s %12s %12s %8s\n", "OBJECT", "APP", "VFS",
+          "DEVICE", "AMP");
+  fprintf(output_fp, "---------------------------------------------------------"
+                     "-----------------------------------\n");
+
+  for (int i = 0; i < t.n; i++) {
+    const struct object_stats *os = &t.top[i].os;
+    struct inode_path path;
+    char label[48];
+
+    // Paths keep their tail, which names the object
+    if (!object_path(&t.top[i].key, &path)) {
+      snprintf(label, sizeof(label), "%u:%u/%llu", t.top[i].key.dev >> 20,
+               t.top[i].key.dev & ((1U << 20) - 1), t.top[i].key.ino);
+    } else {
+      size_t len = strlen(path.path);
+      if (len > 40)
+        snprintf(label, sizeof(label), "...%s", path.path + len - 37);
+      else
+        snprintf(label, sizeof(label), "%s", path.path);
+    }
+
+    char amp[16] = "-";
+    if (os->app_bytes > 0)
+      snprintf(amp, sizeof(amp), "%.2fx",
+               (double)os->device_bytes / os->app_bytes);
+
+    fprintf(output_fp, "%-40s %12llu %12llu %12llu %8s\n", label,
+            os->app_bytes, os->vfs_bytes, os->device_bytes, amp);
+  }
+  fflush(output_fp);
+  free(t.top);
+}
+
+// Per-class sums of the object table, by the decoder of the traced system.
+// Objects whose path is unknown are not classified.
+struct class_set {
+  struct {
+    __u64 objects;
+    __u64 app_bytes;
+    __u64 vfs_bytes;
+    __u64 device_bytes;
+  } classes[NUM_PATH_CLASSES];
+  __u64 unnamed;
+};
+
+static void add_class_object(const struct object_key *key,
+                             const struct object_stats *os, void *ctx) {
+  struct class_set *set = ctx;
+  struct inode_path path;
+
+  if (!object_path(key, &path)) {
+    set->unnamed++;
+    return;
+  }
+
+  enum path_class c = decoder->classify(path.path);
+  set->classes[c].objects++;
+  set->classes[c].app_bytes += os->app_bytes;
+  set->classes[c].vfs_bytes += os->vfs_bytes;
+  set->classes[c].device_bytes += os->device_bytes;
+}
+
+// Only with -O and a system that has a decoder (-s minio/ceph/etcd, -M)
+static void print_class_summary(void) {
+  struct class_set set = {0};
+  __u64 device = 0;
+
+  if (object_stats_fd < 0 || env.top_objects <= 0 || !decoder)
+    return;
+
+  walk_objects(add_class_object, &set);
+  for (int c = 0; c < NUM_PATH_CLASSES; c++)
+    device += set.classes[c].device_bytes;
+
+  fprintf(output_fp, "\n%s Files by Class:\n",
+          system_names[decoder->system_type]);
+  fprintf(output_fp, "%-10s %10s %14s %14s %14s %8s %7s\n", "CLASS",
+          "OBJECTS", "APP", "VFS", "DEVICE", "AMP", "DEV%");
+  for (int c = 0; c < NUM_PATH_CLASSES; c++) {
+    char amp[16] = "-";
+
+    if (set.classes[c].objects == 0)
+      continue;
+    if (set.classes[c].app_bytes > 0)
+      snprintf(amp, sizeof(amp), "%.2fx",
+               (double)set.classes[c].device_bytes / set.classes[c].app_bytes);
+    fprintf(output_fp, "%-10s %10llu %14llu %14llu %14llu %8s %6.1f%%\n",
+            path_class_names[c], set.classes[c].objects,
+            set.classes[c].app_bytes, set.classes[c].vfs_bytes,
+            set.classes[c].device_bytes, amp,
+            device ? 100.0 * set.classes[c].device_bytes / device : 0.0);
+  }
+  if (set.unnamed)
+    fprintf(output_fp, "(%llu objects without a known path)\n", set.unnamed);
+}
+
+// Per-bucket sums of the object table. Objects whose path is unknown or
+// outside -D are not in any bucket.
+#define MAX_BUCKETS 256
+
+struct bucket_sample {
+  char name[MAX_BUCKET_NAME_LEN];
+  __u64 objects;
+  __u64 app_bytes;
+  __u64 vfs_bytes;
+  __u64 device_bytes;
+};
+
+struct bucket_set {
+  struct bucket_sample buckets[MAX_BUCKETS];
+  int n;
+  __u64 unnamed; // Objects without a bucket
+};
+
+static void add_bucket_object(const struct object_key *key,
+                              const struct object_stats *os, void *ctx) {
+  struct bucket_set *set = ctx;
+  struct inode_path path;
+  char name[MAX_BUCKET_NAME_LEN];
+  int i;
+
+  if (!object_path(key, &path) || !path_bucket(path.path, name, sizeof(name))) {
+    set->unnamed++;
+    return;
+  }
+
+  for (i = 0; i < set->n; i++) {
+    if (strcmp(set->buckets[i].name, name) == 0)
+      break;
+  }
+  if (i == set->n) {
+    if (set->n == MAX_BUCKETS) {
+      set->unnamed++;
+      return;
+    }
+    memset(&set->buckets[i], 0, sizeof(set->buckets[i]));
+    strcpy(set->buckets[i].name, name);
+    set->n++;
+  }
+
+  struct bucket_sample *b = &set->buckets[i];
+  b->objects++;
+  b->app_bytes += os->app_bytes;
+  b->vfs_bytes += os->vfs_bytes;
+  b->device_bytes += os->device_bytes;
+}
+
+static int cmp_bucket_device_bytes(const void *a, const void *b) {
+  const struct bucket_sample *x = a, *y = b;
+
+  return (x->device_bytes < y->device_bytes) -
+         (x->device_bytes > y->device_bytes);
+}
+
+// Walks the object table and sorts by device bytes. Caller frees.
+static struct bucket_set *collect_buckets(void) {
+  struct bucket_set *set = calloc(1, sizeof(*set));
+
+  if (!set)
+    return NULL;
+  walk_objects(add_bucket_object, set);
+  qsort(set->buckets, set->n, sizeof(set->buckets[0]),
+        cmp_bucket_device_bytes);
+  return set;
+}
+
+static void print_bucket_summary(void) {
+  struct bucket_set *set;
+
+  if (object_stats_fd < 0 || env.top_objects <= 0 || !env.minio_data_dir)
+    return;
+  set = collect_buckets();
+  if (!set)
+    return;
+
+  fprintf(output_fp, "\nPer-Bucket Amplification (under %s):\n",
+          env.minio_data_dir);
+  fprintf(output_fp, "%-32s %8s %12s %12s %12s %8s\n", "BUCKET", "OBJECTS",
+          "APP", "VFS", "DEVICE", "AMP");
+  fprintf(output_fp, "---------------------------------------------------------"
+                     "-----------------------------------\n");
+  for (int i = 0; i < set->n; i++) {
+    const struct bucket_sample *b = &set->buckets[i];
+    char amp[16] = "-";
+
+    if (b->app_bytes > 0)
+      snprintf(amp, sizeof(amp), "%.2fx",
+               (double)b->device_bytes / b->app_bytes);
+    fprintf(output_fp, "%-32.32s %8llu %12llu %12llu %12llu %8s\n", b->name,
+            b->objects, b->app_bytes, b->vfs_bytes, b->device_bytes, amp);
+  }
+  if (set->unnamed > 0)
+    fprintf(output_fp, "(%llu objects without a known bucket)\n",
+            set->unnamed);
+  free(set);
+}
+
+// ============================================================================
+// AGENT MODE - per-interval deltas to mlio_collector
+// ============================================================================
+
+// Counts of one object as of the last frame, keyed by its object_key
+struct agent_object {
+  __u64 app_bytes;
+  __u64 vfs_bytes;
+  __u64 device_bytes;
+};
+
+static struct cluster_agent *agent = NULL;
+static struct request_table *agent_objects = NULL;
+static struct layer_stats agent_layers[6];
+static struct minio_stats agent_minio;
+static __u64 agent_start_ns;
+
+static __u64 realtime_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// The object a path belongs to, spelled the same on every node that holds
+// a shard of it: bucket/object below the drive, without MinIO's xl.meta or
+// <uuid>/part.N. Without -D the whole path is used.
+static bool cluster_object_name(const char *path, char *out, size_t size) {
+  const char *rel = env.minio_data_dir ? drive_relative(path) : path;
+
+  if (!rel)
+    return false;
+  snprintf(out, size, "%s", rel);
+
+  char *last = strrchr(out, '/');
+  if (last && strcmp(last + 1, "xl.meta") == 0) {
+    *last = '\0';
+  } else if (last && strncmp(last + 1, "part.", 5) == 0) {
+    *last = '\0';
+    last = strrchr(out, '/');
+    if (last)
+      *last = '\0';
+  }
+  return out[0] != '\0';
+}
+
+static __u64 counter_delta(__u64 now, __u64 before) {
+  // A smaller count means the kernel evicted and recreated the entry
+  return now >= before ? now - before : now;
+}
+
+static void add_agent_object(const struct object_key *key,
+                             const struct object_stats *os, void *ctx) {
+  __u64 id = cluster_name_hash((const char *)key, sizeof(*key));
+  __u64 now_ns = *(const __u64 *)ctx;
+  int created = 0;
+  struct agent_object *prev =
+      request_table_get_or_create(agent_objects, id, now_ns, &created);
+
+  if (!prev)
+    return;
+
+  __u64 app = counter_delta(os->app_bytes, prev->app_bytes);
+  __u64 vfs = counter_delta(os->vfs_bytes, prev->vfs_bytes);
+  __u64 device = counter_delta(os->device_bytes, prev->device_bytes);
+  prev->app_bytes = os->app_bytes;
+  prev->vfs_bytes = os->vfs_bytes;
+  prev->device_bytes = os->device_bytes;
+  if (!app && !vfs && !device)
+    return;
+
+  // Objects with no known path still count in the layer totals
+  struct inode_path path;
+  char name[MAX_FILENAME_LEN];
+  if (object_path(key, &path) &&
+      cluster_object_name(path.path, name, sizeof(name)))
+    cluster_agent_add_object(agent, name, app, vfs, device);
+}
+
+// Sends what changed since the last frame. Called right after
+// read_aggregates(), so stats[] and minio_stats are current.
+static void agent_send_interval(void) {
+  __u64 now = realtime_ns();
+
+  cluster_agent_begin(agent, agent_start_ns, now - agent_start_ns);
+  for (int i = 1; i < CLUSTER_LAYERS; i++) {
+    struct cluster_layer delta = {
+        .events = stats[i].total_events - agent_layers[i].total_events,
+        .bytes = stats[i].total_bytes - agent_layers[i].total_bytes,
+        .aligned_bytes =
+            stats[i].aligned_bytes - agent_layers[i].aligned_bytes,
+    };
+    cluster_agent_set_layer(agent, i, &delta);
+    agent_layers[i] = stats[i];
+  }
+  cluster_agent_set_erasure(
+      agent, minio_stats.encoded_bytes - agent_minio.encoded_bytes,
+      minio_stats.parity_bytes - agent_minio.parity_bytes);
+  agent_minio = minio_stats;
+
+  walk_objects(add_agent_object, &now);
+  if (cluster_agent_send(agent) != 0 && env.verbose)
+    fprintf(stderr, "Collector %s unreachable, dropped interval\n",
+            env.agent_addr);
+  agent_start_ns = now;
+}
+
+static int start_agent(void) {
+  char node[CLUSTER_NODE_LEN] = {0};
+
+  gethostname(node, sizeof(node) - 1);
+  agent = cluster_agent_new(env.agent_addr, node);
+  agent_objects = request_table_new(sizeof(struct agent_object),
+                                    MAX_TRACKED_OBJECTS, 0);
+  if (!agent || !agent_objects) {
+    fprintf(stderr, "Invalid collector address %s\n", env.agent_addr);
+    return -1;
+  }
+  agent_start_ns = realtime_ns();
+  return 0;
+}
+
+static void print_agent_stats(void) {
+  struct cluster_agent_stats as;
+
+  if (!agent)
+    return;
+  cluster_agent_get_stats(agent, &as);
+  fprintf(output_fp,
+          "  Agent frames:   %llu sent (%llu bytes), %llu dropped, %llu "
+          "objects truncated\n",
+          as.frames_sent, as.bytes_sent, as.frames_dropped,
+          as.objects_truncated);
+}
+
+// ============================================================================
+// LIVE VIEW - rolling windows over the in-kernel totals
+// ============================================================================
+
+// -V keeps the last LIVE_SLOTS seconds of per-second deltas in a ring. Each
+// window span has a running sum that gains the newest second and loses the
+// one that just fell out of it, so a refresh costs the same however long the
+// tracer has been running.
+#define LIVE_SLOTS 60
+#define LIVE_SPANS 3
+
+static const int live_spans[LIVE_SPANS] = {1, 10, 60}; // Seconds
+
+struct live_counts {
+  __u64 bytes[NUM_LAYERS];
+  __u64 aligned_bytes[NUM_LAYERS];
+  struct latency_hist lat[LAT_KINDS];
+};
+
+static struct live_counts live_ring[LIVE_SLOTS];
+static struct live_counts live_sums[LIVE_SPANS];
+static struct live_counts live_last; // Totals at the previous sample
+static __u64 live_seconds = 0;       // Seconds in the ring so far
+static bool live_primed = false;
+
+// dst += src, or dst -= src when subtracting a second that left a window
+static void live_accumulate(struct live_counts *dst,
+                            const struct live_counts *src, bool add) {
+  __u64 sign = add ? 1 : (__u64)-1;
+
+  for (int i = 0; i < NUM_LAYERS; i++) {
+    dst->bytes[i] += sign * src->bytes[i];
+    dst->aligned_bytes[i] += sign * src->aligned_bytes[i];
+  }
+  for (int k = 0; k < LAT_KINDS; k++) {
+    dst->lat[k].count += sign * src->lat[k].count;
+    dst->lat[k].sum_ns += sign * src->lat[k].sum_ns;
+    for (int i = 0; i < LAT_SLOTS; i++)
+      dst->lat[k].slots[i] += sign * src->lat[k].slots[i];
+  }
+}
+
+// Called once a second, right after read_aggregates()
+static void live_sample(void) {
+  static struct latency_hist *values = NULL;
+  int ncpus = libbpf_num_possible_cpus();
+  struct live_counts now, *slot = &live_ring[live_seconds % LIVE_SLOTS];
+
+  if (ncpus <= 0)
+    return;
+  if (!values) {
+    values = calloc(ncpus, sizeof(*values));
+    if (!values)
+      return;
+  }
+
+  memset(&now, 0, sizeof(now));
+  for (int i = 1; i < NUM_LAYERS; i++) {
+    now.bytes[i] = stats[i].total_bytes;
+    now.aligned_bytes[i] = stats[i].aligned_bytes;
+  }
+  for (__u32 kind = 0; kind < LAT_KINDS; kind++)
+    read_latency_hist(kind, values, ncpus, &now.lat[kind]);
+
+  // The first sample only sets the baseline
+  if (!live_primed) {
+    live_last = now;
+    live_primed = true;
+    return;
+  }
+
+  for (int s = 0; s < LIVE_SPANS; s++) {
+    if (live_seconds >= (__u64)live_spans[s])
+      live_accumulate(
+          &live_sums[s],
+          &live_ring[(live_seconds - live_spans[s]) % LIVE_SLOTS], false);
+  }
+
+  *slot = now;
+  live_accumulate(slot, &live_last, false);
+  live_last = now;
+  for (int s = 0; s < LIVE_SPANS; s++)
+    live_accumulate(&live_sums[s], slot, true);
+  live_seconds++;
+}
+
+// Seconds actually covered by a span, shorter until the ring has filled
+static __u64 live_span_seconds(int s) {
+  return live_seconds < (__u64)live_spans[s] ? live_seconds : live_spans[s];
+}
+
+static void print_live_view(long elapsed) {
+  if (live_seconds == 0)
+    return;
+
+  fprintf(output_fp, "\n[%6lds] %-16s", elapsed, "Live window");
+  for (int s = 0; s < LIVE_SPANS; s++)
+    fprintf(output_fp, " %19ds", live_spans[s]);
+  fprintf(output_fp, "\n");
+
+  fprintf(output_fp, "  %-23s", "Amplification");
+  for (int s = 0; s < LIVE_SPANS; s++) {
+    __u64 app = live_sums[s].bytes[LAYER_APPLICATION];
+
+    if (app > 0)
+      fprintf(output_fp, " %19.2fx",
+              (double)live_sums[s].aligned_bytes[LAYER_DEVICE] / app);
+    else
+      fprintf(output_fp, " %20s", "-");
+  }
+  fprintf(output_fp, "\n");
+
+  for (int i = 1; i < NUM_LAYERS; i++) {
+    fprintf(output_fp, "  %-18s MB/s", layer_names[i]);
+    for (int s = 0; s < LIVE_SPANS; s++)
+      fprintf(output_fp, " %20.2f",
+              live_sums[s].bytes[i] / 1e6 / live_span_seconds(s));
+    fprintf(output_fp, "\n");
+  }
+
+  for (int k = 0; k < LAT_KINDS; k++) {
+    // Kinds idle for the whole ring are left out
+    if (live_sums[LIVE_SPANS - 1].lat[k].count == 0)
+      continue;
+    fprintf(output_fp, "  %-12s p50/p99 μs", latency_names[k]);
+    for (int s = 0; s < LIVE_SPANS; s++) {
+      const struct latency_hist *h = &live_sums[s].lat[k];
+      char cell[32] = "-";
+
+      if (h->count > 0)
+        snprintf(cell, sizeof(cell), "%.1f/%.1f",
+                 latency_percentile(h, 50) / 1000.0,
+                 latency_percentile(h, 99) / 1000.0);
+      fprintf(output_fp, " %20s", cell);
+    }
+    fprintf(output_fp, "\n");
+  }
+  fflush(output_fp);
+}
+
+static void print_aggregate_snapshot(long elapsed) {
+  __u64 app_bytes = stats[LAYER_APPLICATION].total_bytes;
+
+  fprintf(output_fp, "[%6lds]", elapsed);
+  for (int i = 1; i <= 5; i++) {
+    fprintf(output_fp, " %s %llu/%llu", layer_names[i], stats[i].total_events,
+            stats[i].total_bytes);
+  }
+  if (app_bytes > 0)
+    fprintf(output_fp, " AMP %.2fx",
+            (double)stats[LAYER_DEVICE].total_bytes / app_bytes);
+  fprintf(output_fp, "\n");
+  fflush(output_fp);
+}
+
+// Prometheus exposition, rendered on the exporter thread straight from the
+// BPF maps. Nothing here touches stats[] or minio_stats, which belong to
+// the main thread.
+struct counter_field {
+  const char *name;
+  const char *help;
+  size_t offset;
+};
+
+static const struct counter_field layer_counters[] = {
+    {"mlio_layer_events_total", "Events seen per layer",
+     offsetof(struct layer_stats, total_events)},
+    {"mlio_layer_bytes_total", "Bytes requested per layer",
+     offsetof(struct layer_stats, total_bytes)},
+    {"mlio_layer_aligned_bytes_total",
+     "Bytes per layer after block and page alignment",
+     offsetof(struct layer_stats, aligned_bytes)},
+    {"mlio_layer_metadata_ops_total", "Metadata operations per layer",
+     offsetof(struct layer_stats, metadata_ops)},
+    {"mlio_layer_journal_ops_total", "Journal operations per layer",
+     offsetof(struct layer_stats, journal_ops)},
+    {"mlio_layer_cache_hits_total", "Buffered reads served from page cache",
+     offsetof(struct layer_stats, cache_hits)},
+    {"mlio_layer_cache_misses_total", "Buffered reads that filled page cache",
+     offsetof(struct layer_stats, cache_misses)},
+    {"mlio_layer_cache_read_bytes_total", "Bytes read through page cache",
+     offsetof(struct layer_stats, cache_read_bytes)},
+    {"mlio_layer_cache_fill_bytes_total", "Bytes brought into page cache",
+     offsetof(struct layer_stats, cache_fill_bytes)},
+    {"mlio_layer_writeback_bytes_total", "Bytes written back from page cache",
+     offsetof(struct layer_stats, writeback_bytes)},
+    {"mlio_layer_journal_bytes_total", "Bytes committed to the fs journal",
+     offsetof(struct layer_stats, journal_bytes)},
+    {"mlio_layer_mmap_bytes_total", "Data pages faulted in through mmap",
+     offsetof(struct layer_stats, mmap_bytes)},
+    {"mlio_layer_minio_events_total", "Events issued by MinIO per layer",
+     offsetof(struct layer_stats, minio_events)},
+    {"mlio_layer_minio_bytes_total", "Bytes issued by MinIO per layer",
+     offsetof(struct layer_stats, minio_bytes)},
+    {"mlio_layer_xl_meta_ops_total", "MinIO xl.meta operations per layer",
+     offsetof(struct layer_stats, xl_meta_ops)},
+};
+
+static const struct counter_field minio_counters[] = {
+    {"mlio_minio_objects_written_total", "MinIO objects written",
+     offsetof(struct minio_stats, total_objects_written)},
+    {"mlio_minio_objects_read_total", "MinIO objects read",
+     offsetof(struct minio_stats, total_objects_read)},
+    {"mlio_minio_xl_meta_operations_total", "MinIO xl.meta operations",
+     offsetof(struct minio_stats, xl_meta_operations)},
+    {"mlio_minio_erasure_blocks_written_total",
+     "MinIO erasure coded blocks written",
+     offsetof(struct minio_stats, erasure_blocks_written)},
+    {"mlio_minio_multipart_uploads_total", "MinIO multipart upload parts",
+     offsetof(struct minio_stats, multipart_uploads)},
+    {"mlio_minio_metadata_bytes_total", "Bytes of MinIO metadata I/O",
+     offsetof(struct minio_stats, metadata_bytes)},
+    {"mlio_minio_data_bytes_total", "Bytes of MinIO object data written",
+     offsetof(struct minio_stats, data_bytes)},
+    {"mlio_minio_erasure_encoded_bytes_total",
+     "Bytes of object data erasure encoded",
+     offsetof(struct minio_stats, encoded_bytes)},
+    {"mlio_minio_parity_bytes_total", "Parity bytes produced by encoding",
+     offsetof(struct minio_stats, parity_bytes)},
+    {"mlio_minio_erasure_decoded_bytes_total", "Bytes of object data decoded",
+     offsetof(struct minio_stats, decoded_bytes)},
+    {"mlio_minio_bitrot_bytes_total", "Shard bytes hashed for bitrot checks",
+     offsetof(struct minio_stats, bitrot_bytes)},
+};
+
+static const struct counter_field device_counters[] = {
+    {"mlio_device_issued_total", "Block requests issued to the device",
+     offsetof(struct device_stats, issued)},
+    {"mlio_device_completed_total", "Block requests completed",
+     offsetof(struct device_stats, completed)},
+    {"mlio_device_read_bytes_total", "Bytes read from the device",
+     offsetof(struct device_stats, read_bytes)},
+    {"mlio_device_write_bytes_total", "Bytes written to the device",
+     offsetof(struct device_stats, write_bytes)},
+    {"mlio_device_back_merges_total", "Bios back-merged into a request",
+     offsetof(struct device_stats, back_merges)},
+    {"mlio_device_front_merges_total", "Bios front-merged into a request",
+     offsetof(struct device_stats, front_merges)},
+    {"mlio_device_requeues_total", "Block requests requeued",
+     offsetof(struct device_stats, requeues)},
+    {"mlio_device_errors_total", "Block requests completed with an error",
+     offsetof(struct device_stats, errors)},
+};
+
+struct agg_sample {
+  __u32 idx;
+  struct layer_agg sum;
+};
+
+struct device_sample {
+  __u32 dev;
+  struct device_stats ds;
+};
+
+struct process_sample {
+  struct process_agg_key key;
+  struct process_agg agg;
+};
+
+static inline __u64 field_u64(const void *base, size_t offset) {
+  return *(const __u64 *)((const char *)base + offset);
+}
+
+static void metric_header(FILE *out, const char *name, const char *type,
+                          const char *help) {
+  fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static const char *system_label(__u32 sys) {
+  return sys < sizeof(system_names) / sizeof(system_names[0])
+             ? system_names[sys]
+             : "Unknown";
+}
+
+static void render_aggregates(FILE *out, const struct agg_sample *samples,
+                              int n) {
+  static const struct counter_field event_counters[] = {
+      {"mlio_events_total", "Events per layer, event type and system",
+       offsetof(struct layer_agg, events)},
+      {"mlio_bytes_total", "Bytes per layer, event type and system",
+       offsetof(struct layer_agg, bytes)},
+      {"mlio_aligned_bytes_total",
+       "Aligned bytes per layer, event type and system",
+       offsetof(struct layer_agg, aligned_bytes)},
+  };
+
+  for (size_t f = 0; f < sizeof(event_counters) / sizeof(event_counters[0]);
+       f++) {
+    metric_header(out, event_counters[f].name, "counter",
+                  event_counters[f].help);
+    for (int i = 0; i < n; i++) {
+      int layer = samples[i].idx / (AGG_EVENT_SLOTS * AGG_SYSTEM_SLOTS);
+      __u32 sys = samples[i].idx % AGG_SYSTEM_SLOTS;
+
+      fprintf(out, "%s{layer=\"%s\",event=\"%s\",system_type=\"%s\"} %llu\n",
+              event_counters[f].name, layer_names[layer],
+              get_event_name(samples[i].sum.event_type), system_label(sys),
+              field_u64(&samples[i].sum, event_counters[f].offset));
+    }
+  }
+
+  metric_header(out, "mlio_event_latency_seconds_total", "counter",
+                "Summed latency per layer, event type and system");
+  for (int i = 0; i < n; i++) {
+    int layer = samples[i].idx / (AGG_EVENT_SLOTS * AGG_SYSTEM_SLOTS);
+    __u32 sys = samples[i].idx % AGG_SYSTEM_SLOTS;
+
+    fprintf(out,
+            "mlio_event_latency_seconds_total{layer=\"%s\",event=\"%s\","
+            "system_type=\"%s\"} %.9f\n",
+            layer_names[layer], get_event_name(samples[i].sum.event_type),
+            system_label(sys), samples[i].sum.latency_ns / 1e9);
+  }
+}
+
+static void render_layer_stats(FILE *out, const struct layer_stats *ls,
+                               const struct minio_stats *ms) {
+  __u64 app_bytes = ls[LAYER_APPLICATION].total_bytes;
+
+  for (size_t f = 0; f < sizeof(layer_counters) / sizeof(layer_counters[0]);
+       f++) {
+    metric_header(out, layer_counters[f].name, "counter",
+                  layer_counters[f].help);
+    for (int i = 1; i <= 5; i++)
+      fprintf(out, "%s{layer=\"%s\"} %llu\n", layer_counters[f].name,
+              layer_names[i], field_u64(&ls[i], layer_counters[f].offset));
+  }
+
+  // Same definition as the summary's AMP_FACTOR column
+  metric_header(out, "mlio_amplification_ratio", "gauge",
+                "Aligned bytes at each layer per application byte");
+  for (int i = 2; i <= 5 && app_bytes > 0; i++)
+    fprintf(out, "mlio_amplification_ratio{layer=\"%s\"} %.6f\n",
+            layer_names[i], (double)ls[i].aligned_bytes / app_bytes);
+
+  for (size_t f = 0; f < sizeof(minio_counters) / sizeof(minio_counters[0]);
+       f++) {
+    metric_header(out, minio_counters[f].name, "counter",
+                  minio_counters[f].help);
+    fprintf(out, "%s %llu\n", minio_counters[f].name,
+            field_u64(ms, minio_counters[f].offset));
+  }
+}
+
+// One bucket per power of two, i.e. every 1 << LAT_SUB_BUCKET_BITS slots,
+// so the bucket boundaries never change between scrapes
+static void render_latency(FILE *out, const struct latency_hist *h,
+                           const char *op) {
+  int sub_buckets = 1 << LAT_SUB_BUCKET_BITS;
+  __u64 cumulative = 0;
+
+  for (int i = 0; i < LAT_SLOTS; i++) {
+    cumulative += h->slots[i];
+    if ((i + 1) % sub_buckets == 0)
+      fprintf(out, "mlio_latency_seconds_bucket{op=\"%s\",le=\"%g\"} %llu\n",
+              op, latency_slot_upper(i) / 1e9, cumulative);
+  }
+  fprintf(out, "mlio_latency_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n",
+          op, h->count);
+  fprintf(out, "mlio_latency_seconds_sum{op=\"%s\"} %.9f\n", op,
+          h->sum_ns / 1e9);
+  fprintf(out, "mlio_latency_seconds_count{op=\"%s\"} %llu\n", op, h->count);
+}
+
+static int render_latency_hists(FILE *out, int ncpus) {
+  struct latency_hist *values = calloc(ncpus, sizeof(*values));
+
+  if (!values)
+    return -1;
+
+  metric_header(out, "mlio_latency_seconds", "histogram",
+                "Operation latency");
+  for (__u32 kind = 0; kind < LAT_KINDS; kind++) {
+    struct latency_hist sum;
+
+    if (read_latency_hist(kind, values, ncpus, &sum) != 0)
+      continue;
+    render_latency(out, &sum, latency_labels[kind]);
+  }
+
+  free(values);
+  return 0;
+}
+
+static int render_devices(FILE *out) {
+  struct device_sample *samples = calloc(MAX_DEVICES, sizeof(*samples));
+  __u32 key, next_key, *prev = NULL;
+  int n = 0;
+
+  if (!samples)
+    return -1;
+
+  while (n < MAX_DEVICES &&
+         bpf_map_get_next_key(device_stats_fd, prev, &next_key) == 0) {
+    key = next_key;
+    prev = &key;
+    if (read_device_stats(key, &samples[n].ds) == 0) {
+      samples[n].dev = key;
+      n++;
+    }
+  }
+
+  for (size_t f = 0; f < sizeof(device_counters) / sizeof(device_counters[0]);
+       f++) {
+    metric_header(out, device_counters[f].name, "counter",
+                  device_counters[f].help);
+    for (int i = 0; i < n; i++)
+      fprintf(out, "%s{device=\"%u:%u\"} %llu\n", device_counters[f].name,
+              samples[i].dev >> 20, samples[i].dev & ((1U << 20) - 1),
+              field_u64(&samples[i].ds, device_counters[f].offset));
+  }
+
+  metric_header(out, "mlio_device_service_seconds_total", "counter",
+                "Summed device service time");
+  for (int i = 0; i < n; i++)
+    fprintf(out, "mlio_device_service_seconds_total{device=\"%u:%u\"} %.9f\n",
+            samples[i].dev >> 20, samples[i].dev & ((1U << 20) - 1),
+            samples[i].ds.service_ns / 1e9);
+
+  metric_header(out, "mlio_device_inflight", "gauge",
+                "Block requests currently in flight");
+  for (int i = 0; i < n; i++)
+    fprintf(out, "mlio_device_inflight{device=\"%u:%u\"} %lld\n",
+            samples[i].dev >> 20, samples[i].dev & ((1U << 20) - 1),
+            samples[i].ds.inflight > 0 ? samples[i].ds.inflight : 0);
+
+  free(samples);
+  return 0;
+}
+
+static int render_processes(FILE *out, int ncpus) {
+  struct process_sample *samples = calloc(MAX_TRACKED_PROCS, sizeof(*samples));
+  struct process_agg *values = calloc(ncpus, sizeof(*values));
+  struct process_agg_key key, next_key, *prev = NULL;
+  int n = 0, err = 0;
+
+  if (!samples || !values) {
+    err = -1;
+    goto out;
+  }
+
+  while (n < MAX_TRACKED_PROCS &&
+         bpf_map_get_next_key(process_aggregates_fd, prev, &next_key) == 0) {
+    key = next_key;
+    prev = &key;
+    if (bpf_map_lookup_elem(process_aggregates_fd, &key, values) != 0 ||
+        key.layer > LAYER_DEVICE)
+      continue;
+
+    samples[n].key = key;
+    memset(&samples[n].agg, 0, sizeof(samples[n].agg));
+    for (int cpu = 0; cpu < ncpus; cpu++) {
+      samples[n].agg.events += values[cpu].events;
+      samples[n].agg.bytes += values[cpu].bytes;
+    }
+    n++;
+  }
+
+  metric_header(out, "mlio_process_events_total", "counter",
+                "Events per process and layer");
+  for (int i = 0; i < n; i++)
+    fprintf(out, "mlio_process_events_total{pid=\"%u\",layer=\"%s\"} %llu\n",
+            samples[i].key.tgid, layer_names[samples[i].key.layer],
+            samples[i].agg.events);
+
+  metric_header(out, "mlio_process_bytes_total", "counter",
+                "Bytes per process and layer");
+  for (int i = 0; i < n; i++)
+    fprintf(out, "mlio_process_bytes_total{pid=\"%u\",layer=\"%s\"} %llu\n",
+            samples[i].key.tgid, layer_names[samples[i].key.layer],
+            samples[i].agg.bytes);
+
+out:
+  free(values);
+  free(samples);
+  return err;
+}
+
+// Only with -O and -D. S3 bucket names need no label escaping.
+static int render_buckets(FILE *out) {
+  struct bucket_set *set;
+
+  if (object_stats_fd < 0 || env.top_objects <= 0 || !env.minio_data_dir)
+    return 0;
+  set = collect_buckets();
+  if (!set)
+    return -1;
+
+  metric_header(out, "mlio_bucket_objects", "gauge",
+                "Tracked objects per MinIO bucket");
+  for (int i = 0; i < set->n; i++)
+    fprintf(out, "mlio_bucket_objects{bucket=\"%s\"} %llu\n",
+            set->buckets[i].name, set->buckets[i].objects);
+
+  metric_header(out, "mlio_bucket_app_bytes", "gauge",
+                "Application bytes of the tracked objects per bucket");
+  for (int i = 0; i < set->n; i++)
+    fprintf(out, "mlio_bucket_app_bytes{bucket=\"%s\"} %llu\n",
+            set->buckets[i].name, set->buckets[i].app_bytes);
+
+  metric_header(out, "mlio_bucket_device_bytes", "gauge",
+                "Device bytes of the tracked objects per bucket");
+  for (int i = 0; i < set->n; i++)
+    fprintf(out, "mlio_bucket_device_bytes{bucket=\"%s\"} %llu\n",
+            set->buckets[i].name, set->buckets[i].device_bytes);
+
+  free(set);
+  return 0;
+}
+
+static int render_cache_stats(FILE *out) {
+  struct cache_stats cs;
+
+  if (read_cache_stats(&cs) != 0)
+    return -1;
+
+  metric_header(out, "mlio_cache_dirtied_bytes_total", "counter",
+                "Page cache bytes dirtied by traced writes");
+  fprintf(out, "mlio_cache_dirtied_bytes_total %llu\n",
+          cs.dirtied_pages * CACHE_PAGE_SIZE);
+  metric_header(out, "mlio_cache_writeback_bytes_total", "counter",
+                "Page cache bytes written back from traced inodes");
+  fprintf(out, "mlio_cache_writeback_bytes_total %llu\n",
+          cs.writeback_pages * CACHE_PAGE_SIZE);
+  metric_header(out, "mlio_cache_writeback_inodes_total", "counter",
+                "Inode writebacks of traced inodes");
+  fprintf(out, "mlio_cache_writeback_inodes_total %llu\n",
+          cs.writeback_inodes);
+  metric_header(out, "mlio_cache_readahead_bytes_total", "counter",
+                "Page cache bytes read ahead of traced reads");
+  fprintf(out, "mlio_cache_readahead_bytes_total %llu\n",
+          cs.readahead_pages * CACHE_PAGE_SIZE);
+  return 0;
+}
+
+// metrics_render_fn for the HTTP exporter
+static int render_metrics(FILE *out, void *ctx) {
+  struct layer_stats ls[6] = {0};
+  struct minio_stats ms = {0};
+  int ncpus = libbpf_num_possible_cpus();
+  struct agg_sample *samples;
+  struct layer_agg *values;
+  int n = 0, err = -1;
+
+  if (ncpus <= 0)
+    return -1;
+
+  samples = calloc(AGG_ENTRIES, sizeof(*samples));
+  values = calloc(ncpus, sizeof(*values));
+  if (!samples || !values)
+    goto out;
+
+  for (__u32 idx = 0; idx < AGG_ENTRIES; idx++) {
+    if (!sum_aggregate(layer_aggregates_fd, idx, values, ncpus,
+                       &samples[n].sum))
+      continue;
+    samples[n].idx = idx;
+    fold_aggregate(ls, &ms, idx / (AGG_EVENT_SLOTS * AGG_SYSTEM_SLOTS),
+                   &samples[n].sum);
+    n++;
+  }
+
+  render_aggregates(out, samples, n);
+  render_layer_stats(out, ls, &ms);
+  if (render_latency_hists(out, ncpus) != 0 || render_devices(out) != 0 ||
+      render_processes(out, ncpus) != 0 || render_cache_stats(out) != 0 ||
+      render_buckets(out) != 0)
+    goto out;
+  err = 0;
+
+out:
+  free(values);
+  free(samples);
+  return err;
+}
+
+// Ring buffer callback on a drain thread: copy out and return quickly
+static int queue_event(void *ctx, void *data, size_t data_sz) {
+  struct drainer *d = ctx;
+
+  spsc_queue_push(&d->queue, data, data_sz);
+  return 0;
+}
+
+static inline bool merge_queues(void) {
+  return num_drainers > 1 && env.correlation_mode;
+}
+
+static inline __u64 monotonic_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Drains the rings once more and publishes the time taken just before, so
+// the main thread knows nothing older can still be on its way
+static void publish_watermark(struct drainer *d) {
+  __u64 now = monotonic_ns();
+
+  ring_buffer__consume(d->rb);
+  atomic_store_explicit(&d->watermark, now, memory_order_release);
+}
+
+static void *drain_thread(void *arg) {
+  struct drainer *d = arg;
+  bool merge = merge_queues();
+  int timeout = env.wakeup_kb > 0 ? env.wakeup_ms : 100;
+  sigset_t set;
+
+  // Leave SIGINT/SIGTERM to the main thread
+  sigfillset(&set);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  if (d->pin &&
+      pthread_setaffinity_np(pthread_self(), sizeof(d->cpus), &d->cpus) != 0 &&
+      env.verbose)
+    fprintf(stderr, "Could not pin drain thread to node %d\n", d->node);
+
+  while (!exiting) {
+    int err = ring_buffer__poll(d->rb, timeout);
+
+    // Under load the next records are usually committed by the time the
+    // last batch is handled; take them without going back to epoll
+    for (int pass = 0; err > 0 && pass < DRAIN_CONSUME_PASSES; pass++)
+      err = ring_buffer__consume(d->rb);
+    if (err < 0 && err != -EINTR) {
+      drain_err = err;
+      break;
+    }
+    if (merge)
+      publish_watermark(d);
+  }
+
+  // Pick up whatever was committed before the programs were told to stop
+  ring_buffer__consume(d->rb);
+  atomic_store_explicit(&d->watermark, ULLONG_MAX, memory_order_release);
+  atomic_fetch_add(&drainers_done, 1);
+  return NULL;
+}
+
+// Returns the NUMA node of cpu, or 0 when the topology is not exposed
+static int cpu_to_node(int cpu) {
+  char path[64];
+  struct dirent *de;
+  int node = 0;
+  DIR *dir;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  dir = opendir(path);
+  if (!dir)
+    return 0;
+
+  while ((de = readdir(dir)) != NULL) {
+    if (strncmp(de->d_name, "node", 4) == 0 && de->d_name[4] >= '0' &&
+        de->d_name[4] <= '9') {
+      node = atoi(de->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+static struct drainer *drainer_for_node(int node) {
+  for (int i = 0; i < num_drainers; i++) {
+    if (drainers[i].node == node)
+      return &drainers[i];
+  }
+  if (num_drainers == MAX_DRAINERS)
+    return &drainers[node % MAX_DRAINERS];
+
+  struct drainer *d = &drainers[num_drainers++];
+  d->node = node;
+  CPU_ZERO(&d->cpus);
+  return d;
+}
+
+static int add_ring(struct drainer *d, int fd) {
+  if (!d->rb) {
+    d->rb = ring_buffer__new(fd, queue_event, d, NULL);
+    if (!d->rb)
+      return -errno;
+  } else if (ring_buffer__add(d->rb, fd, queue_event, d) != 0) {
+    return -errno;
+  }
+  d->rings++;
+  return 0;
+}
+
+// Create one ring per shard, publish them through event_shards/cpu_shard and
+// hand every ring to the drainer of the node its CPUs belong to
+static int setup_event_shards(struct multilayer_io_tracer_bpf *skel) {
+  int outer_fd = bpf_map__fd(skel->maps.event_shards);
+  int cpu_fd = bpf_map__fd(skel->maps.cpu_shard);
+  int ncpus = libbpf_num_possible_cpus();
+  int err;
+
+  if (ncpus <= 0)
+    return -1;
+  if (ncpus > MAX_CPUS) {
+    fprintf(stderr, "Warning: only the first %d CPUs are sharded\n",
+            MAX_CPUS);
+    ncpus = MAX_CPUS;
+  }
+
+  for (int i = 0; i < MAX_RING_SHARDS; i++)
+    shard_fds[i] = -1;
+
+  for (__u32 cpu = 0; cpu < (__u32)ncpus; cpu++) {
+    int node = cpu_to_node(cpu);
+    __u32 shard = env.shard_mode == SHARD_PER_CPU ? cpu % MAX_RING_SHARDS
+                                                  : node % MAX_RING_SHARDS;
+    struct drainer *d = drainer_for_node(node);
+
+    CPU_SET(cpu, &d->cpus);
+    d->pin = true;
+
+    if (shard_fds[shard] < 0) {
+      int fd = bpf_map_create(BPF_MAP_TYPE_RINGBUF, "event_shard", 0, 0,
+                              RING_SHARD_SIZE, NULL);
+      if (fd < 0) {
+        fprintf(stderr, "Failed to create ring shard %u: %s\n", shard,
+                strerror(errno));
+        return -1;
+      }
+      shard_fds[shard] = fd;
+      num_shards++;
+
+      if (bpf_map_update_elem(outer_fd, &shard, &fd, BPF_ANY) != 0) {
+        fprintf(stderr, "Failed to install ring shard %u: %s\n", shard,
+                strerror(errno));
+        return -1;
+      }
+      err = add_ring(d, fd);
+      if (err) {
+        fprintf(stderr, "Failed to open ring shard %u: %s\n", shard,
+                strerror(-err));
+        return -1;
+      }
+    }
+
+    if (bpf_map_update_elem(cpu_fd, &cpu, &shard, BPF_ANY) != 0) {
+      fprintf(stderr, "Failed to map CPU %u to shard %u\n", cpu, shard);
+      return -1;
+    }
+  }
+
+  if (env.verbose)
+    fprintf(stderr, "Sharded event stream: %d rings, %d drain threads\n",
+            num_shards, num_drainers);
+  return 0;
+}
+
+static int setup_drainers(struct multilayer_io_tracer_bpf *skel) {
+  size_t queue_size;
+  int err;
+
+  if (env.shard_mode != SHARD_NONE) {
+    if (setup_event_shards(skel) != 0)
+      return -1;
+  } else {
+    struct drainer *d = &drainers[num_drainers++];
+    err = add_ring(d, bpf_map__fd(skel->maps.events));
+    if (err) {
+      fprintf(stderr, "Failed to create ring buffer\n");
+      return -1;
+    }
+  }
+
+  // The -Q budget is split across drain threads
+  queue_size = ((size_t)env.queue_mb << 20) / num_drainers;
+  if (queue_size < (4 << 20))
+    queue_size = 4 << 20;
+
+  for (int i = 0; i < num_drainers; i++) {
+    if (spsc_queue_init(&drainers[i].queue, queue_size) != 0) {
+      fprintf(stderr, "Failed to allocate event queue\n");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int start_drainers(void) {
+  for (int i = 0; i < num_drainers; i++) {
+    int err = pthread_create(&drainers[i].thread, NULL, drain_thread,
+                             &drainers[i]);
+    if (err) {
+      fprintf(stderr, "Failed to start ring buffer thread: %s\n",
+              strerror(err));
+      return -err;
+    }
+    drainers[i].started = true;
+  }
+  return 0;
+}
+
+static void stop_drainers(void) {
+  exiting = true;
+  for (int i = 0; i < num_drainers; i++) {
+    if (drainers[i].started)
+      pthread_join(drainers[i].thread, NULL);
+    drainers[i].started = false;
+  }
+}
+
+static void free_drainers(void) {
+  for (int i = 0; i < num_drainers; i++) {
+    if (drainers[i].rb)
+      ring_buffer__free(drainers[i].rb);
+    spsc_queue_destroy(&drainers[i].queue);
+  }
+  // shard_fds is only initialized once sharding has been set up
+  for (int i = 0; num_shards > 0 && i < MAX_RING_SHARDS; i++) {
+    if (shard_fds[i] >= 0)
+      close(shard_fds[i]);
+  }
+}
+
+static inline __u64 record_timestamp(const void *data, __u32 len) {
+  return len >= sizeof(__u64) ? *(const __u64 *)data : 0;
+}
+
+// Process up to max queued records on the main thread. Correlation needs
+// events in time order, so with several queues it merges on the event
+// timestamp; otherwise each queue is drained in turn.
+//
+// A queue that is empty right now may still receive an older record, so
+// the oldest head is held back until it is no newer than the watermark of
+// every empty queue. Drain threads refresh their watermark at least every
+// poll timeout (100 ms), which bounds the hold-back. The order is exact
+// for records stamped when they are emitted. Records stamped at syscall
+// entry and emitted at exit can still trail the watermark and arrive late;
+// they are handled in arrival order.
+static int process_queue(int max) {
+  int n = 0;
+  __u32 len;
+  void *data;
+
+  if (merge_queues()) {
+    while (n < max) {
+      struct drainer *next = NULL;
+      __u64 next_ts = 0, limit = ULLONG_MAX;
+      __u32 next_len = 0;
+      void *next_data = NULL;
+
+      for (int i = 0; i < num_drainers; i++) {
+        // Read before peeking: records pushed before the watermark was
+        // published are then guaranteed to be visible
+        __u64 mark = atomic_load_explicit(&drainers[i].watermark,
+                                          memory_order_acquire);
+
+        data = spsc_queue_peek(&drainers[i].queue, &len);
+        if (!data) {
+          if (mark < limit)
+            limit = mark;
+        } else if (!next || record_timestamp(data, len) < next_ts) {
+          next = &drainers[i];
+          next_ts = record_timestamp(data, len);
+          next_data = data;
+          next_len = len;
+        }
+      }
+      if (!next || next_ts > limit)
+        break;
+
+      handle_event(NULL, next_data, next_len);
+      spsc_queue_release(&next->queue);
+      n++;
+    }
+    return n;
+  }
+
+  for (int i = 0; i < num_drainers; i++) {
+    struct spsc_queue *q = &drainers[i].queue;
+    int done = 0;
+
+    while (done < max && (data = spsc_queue_peek(q, &len)) != NULL) {
+      handle_event(NULL, data, len);
+      spsc_queue_release(q);
+      done++;
+    }
+    n += done;
+  }
+  return n;
+}
+
+static void print_queue_stats(void) {
+  __u64 pushed = 0, drops = 0, drop_bytes = 0;
+  double peak = 0;
+
+  if (num_drainers == 0)
+    return;
+
+  for (int i = 0; i < num_drainers; i++) {
+    struct spsc_queue *q = &drainers[i].queue;
+
+    if (!q->buf)
+      continue;
+    pushed += q->pushed;
+    drops += atomic_load(&q->drops);
+    drop_bytes += atomic_load(&q->drop_bytes);
+    if (100.0 * q->peak_used / q->capacity > peak)
+      peak = 100.0 * q->peak_used / q->capacity;
+  }
+
+  fprintf(output_fp, "\nEvent Queue:\n");
+  if (num_shards > 0)
+    fprintf(output_fp, "  Ring shards:    %d across %d drain threads\n",
+            num_shards, num_drainers);
+  fprintf(output_fp, "  Events queued:  %llu\n", pushed);
+  fprintf(output_fp, "  Events dropped: %llu (%llu bytes, queue full)\n",
+          drops, drop_bytes);
+  fprintf(output_fp, "  Peak fill:      %.1f%% of %zu MB per queue\n", peak,
+          drainers[0].queue.capacity >> 20);
+}
+
+// Fill level of the fullest ring right now, in percent. Read from the
+// producer/consumer positions, so it is safe next to the drain threads.
+static double ring_fill_now(void) {
+  double fill = 0;
+
+  for (int i = 0; i < num_drainers; i++) {
+    for (int r = 0; drainers[i].rb && r < drainers[i].rings; r++) {
+      struct ring *ring = ring_buffer__ring(drainers[i].rb, r);
+      double pct;
+
+      if (!ring || ring__size(ring) == 0)
+        continue;
+      pct = 100.0 * ring__avail_data_size(ring) / ring__size(ring);
+      if (pct > fill)
+        fill = pct;
+    }
+  }
+  return fill;
+}
+
+static void sample_ring_fill(void) {
+  double fill = ring_fill_now();
+
+  if (fill > ring_fill_peak)
+    ring_fill_peak = fill;
+}
+
+// -v: one line per interval to tell when sampling is worth turning on
+static void print_self_stats_line(long elapsed) {
+  static __u64 last_events = 0, last_ns = 0, last_drops = 0;
+  __u64 events = handled_events - last_events;
+  __u64 ns = handler_ns - last_ns;
+  __u64 drops = total_drops();
+
+  fprintf(stderr,
+          "[self] %.0f events/s, %.0f ns/event in handler, ring %.1f%% "
+          "(peak %.1f%%), %llu dropped\n",
+          elapsed > 0 ? (double)events / elapsed : 0,
+          events ? (double)ns / events : 0, ring_fill_now(), ring_fill_peak,
+          drops - last_drops);
+  last_events = handled_events;
+  last_ns = handler_ns;
+  last_drops = drops;
+}
+
+struct prog_sample {
+  const char *name;
+  __u64 run_time_ns;
+  __u64 run_cnt;
+};
+
+static int cmp_prog_run_time(const void *a, const void *b) {
+  const struct prog_sample *pa = a, *pb = b;
+
+  if (pa->run_time_ns == pb->run_time_ns)
+    return 0;
+  return pa->run_time_ns < pb->run_time_ns ? 1 : -1;
+}
+
+static void print_program_stats(struct multilayer_io_tracer_bpf *skel) {
+  struct prog_sample samples[128];
+  struct bpf_program *prog;
+  __u64 total_ns = 0;
+  int n = 0;
+
+  bpf_object__for_each_program(prog, skel->obj) {
+    struct bpf_prog_info info = {};
+    __u32 len = sizeof(info);
+    int fd = bpf_program__fd(prog);
+
+    if (fd < 0 || n == (int)(sizeof(samples) / sizeof(samples[0])))
+      continue;
+    if (bpf_prog_get_info_by_fd(fd, &info, &len) != 0 || info.run_cnt == 0)
+      continue;
+    samples[n].name = bpf_program__name(prog);
+    samples[n].run_time_ns = info.run_time_ns;
+    samples[n].run_cnt = info.run_cnt;
+    total_ns += info.run_time_ns;
+    n++;
+  }
+  if (n == 0)
+    return;
+
+  qsort(samples, n, sizeof(samples[0]), cmp_prog_run_time);
+  fprintf(output_fp, "\nBPF Program Run Time:\n");
+  fprintf(output_fp, "%-28s %12s %10s %12s %7s\n", "PROGRAM", "RUNS",
+          "AVG_NS", "TOTAL_MS", "SHARE");
+  for (int i = 0; i < n; i++) {
+    fprintf(output_fp, "%-28s %12llu %10.0f %12.1f %6.1f%%\n",
+            samples[i].name, samples[i].run_cnt,
+            (double)samples[i].run_time_ns / samples[i].run_cnt,
+            samples[i].run_time_ns / 1e6,
+            total_ns ? 100.0 * samples[i].run_time_ns / total_ns : 0);
+  }
+}
+
+static void print_ring_drops(void) {
+  int ncpus = libbpf_num_possible_cpus();
+  struct ring_drop *values;
+  bool header = false;
+
+  if (ring_drop_counts_fd < 0 || ncpus <= 0)
+    return;
+  values = calloc(ncpus, sizeof(*values));
+  if (!values)
+    return;
+
+  for (__u32 slot = 0; slot < AGG_EVENT_SLOTS; slot++) {
+    __u64 drops = 0;
+    __u32 event_type = 0;
+
+    if (bpf_map_lookup_elem(ring_drop_counts_fd, &slot, values) != 0)
+      continue;
+    for (int cpu = 0; cpu < ncpus; cpu++) {
+      drops += values[cpu].drops;
+      if (values[cpu].drops)
+        event_type = values[cpu].event_type;
+    }
+    if (drops == 0)
+      continue;
+
+    if (!header) {
+      fprintf(output_fp, "\nRing Buffer Drops:\n");
+      fprintf(output_fp, "%-28s %12s\n", "EVENT", "DROPS");
+      header = true;
+    }
+    fprintf(output_fp, "%-28s %12llu\n", get_event_name(event_type), drops);
+  }
+  free(values);
+}
+
+// What the tracer itself cost: userspace handling, ring pressure and the
+// time spent in each BPF program
+static void print_self_stats(struct multilayer_io_tracer_bpf *skel,
+                             long elapsed) {
+  fprintf(output_fp, "\nTracer Overhead:\n");
+  fprintf(output_fp, "  Events handled: %llu (%.0f/s)\n", handled_events,
+          elapsed > 0 ? (double)handled_events / elapsed : 0);
+  fprintf(output_fp, "  Handler time:   %.0f ns/event\n",
+          handled_events ? (double)handler_ns / handled_events : 0);
+  fprintf(output_fp, "  Ring peak fill: %.1f%%\n", ring_fill_peak);
+  print_ring_drops();
+  print_agent_stats();
+  if (bpf_stats_fd >= 0)
+    print_program_stats(skel);
+}
+
+// Feed a capture file through handle_event() as if it came off the ring
+static int replay_trace(const char *path) {
+  struct trace_reader reader;
+  __u64 records = 0;
+  int err;
+
+  err = trace_reader_open(&reader, path, sizeof(struct io_event_core));
+  if (err) {
+    fprintf(stderr, "Failed to open capture file %s: %s\n", path,
+            strerror(-err));
+    return err;
+  }
+
+  if (env.verbose) {
+    time_t started =
+        (reader.header.boot_offset_ns + reader.header.start_ns) / 1000000000;
+    fprintf(stderr, "Replaying %s (host %s, captured %s", path,
+            reader.header.hostname, ctime(&started));
+  }
+
+  print_header();
+  err = trace_reader_replay(&reader, handle_event, NULL, &records);
+  if (err < 0)
+    fprintf(stderr, "Warning: capture file truncated after %llu events\n",
+            records);
+  else if (env.verbose)
+    fprintf(stderr, "Replayed %llu events\n", records);
+
+  trace_reader_close(&reader);
+  return 0;
+}
+
+static int bump_memlock_rlimit(void) {
+  struct rlimit rlim_new = {
+      .rlim_cur = RLIM_INFINITY,
+      .rlim_max = RLIM_INFINITY,
+  };
+  return setrlimit(RLIMIT_MEMLOCK, &rlim_new);
+}
+
+int main(int argc, char **argv) {
+  struct multilayer_io_tracer_bpf *skel = NULL;
+  bool attached = false;
+  int err = 0;
+
+  err = argp_parse(&argp, argc, argv, 0, NULL, NULL);
+  if (err)
+    return err;
+
+  decoder = system_decoder_by_name(env.trace_system);
+  if (!decoder && env.minio_only)
+    decoder = system_decoder_by_type(SYSTEM_TYPE_MINIO);
+
+  if (env.capture_file && (env.aggregate || env.replay_file)) {
+    fprintf(stderr, "-w cannot be combined with -a, -X or -r\n");
+    return 1;
+  }
+  if (env.columns_file && env.aggregate) {
+    fprintf(stderr, "-W cannot be combined with -a or -X\n");
+    return 1;
+  }
+  if (env.exporter_addr && env.replay_file) {
+    fprintf(stderr, "-X cannot be combined with -r\n");
+    return 1;
+  }
+
+  signal(SIGINT, sig_handler);
+  signal(SIGTERM, sig_handler);
+
+  if (env.output_file) {
+    output_fp = fopen(env.output_file, "w");
+    if (!output_fp) {
+      fprintf(stderr, "Failed to open output file %s: %s\n", env.output_file,
+              strerror(errno));
+      return 1;
+    }
+  } else {
+    output_fp = stdout;
+  }
+
+  // JSON and compressed output go through one large buffer instead of
+  // being flushed per event
+  if (env.json_output || env.compress) {
+    if (env.compress && isatty(fileno(output_fp))) {
+      fprintf(stderr, "Refusing to write compressed output to a terminal, "
+                      "use -o\n");
+      return 1;
+    }
+    out_stream = stream_writer_open(fileno(output_fp), env.compress);
+    if (!out_stream) {
+      fprintf(stderr, "Failed to set up output buffering\n");
+      return 1;
+    }
+    raw_output_fp = output_fp;
+    output_fp = stream_writer_file(out_stream);
+  }
+
+  if (env.correlation_mode) {
+    requests = request_table_new(sizeof(struct request_stats),
+                                 env.max_requests,
+                                 env.request_max_age * 1000000000ULL);
+    if (!requests) {
+      fprintf(stderr, "Failed to allocate request table\n");
+      return 1;
+    }
+  }
+
+  if (env.columns_file) {
+    columns = column_writer_open(env.columns_file, event_columns,
+                                 sizeof(event_columns) /
+                                     sizeof(event_columns[0]));
+    if (!columns) {
+      fprintf(stderr, "Failed to open column file %s: %s\n",
+              env.columns_file, strerror(errno));
+      return 1;
+    }
+  }
+
+  if (env.replay_file) {
+    err = replay_trace(env.replay_file);
+    if (!err) {
+      print_amplification_summary();
+      if (env.minio_only) {
+        print_minio_summary();
+      }
+    }
+    goto cleanup;
+  }
+
+  if (env.capture_file) {
+    capture = trace_writer_open(env.capture_file, sizeof(struct io_event_core));
+    if (!capture) {
+      fprintf(stderr, "Failed to open capture file %s: %s\n",
+              env.capture_file, strerror(errno));
+      return 1;
+    }
+  }
+
+  if (bump_memlock_rlimit()) {
+    fprintf(stderr, "Failed to increase RLIMIT_MEMLOCK limit!\n");
+    err = -1;
+    goto cleanup;
+  }
+
+  // Prefer trampolines, and reopen with kprobes if they do not work here
+  bool fentry =
+      !env.force_kprobes && access("/sys/kernel/btf/vmlinux", R_OK) == 0;
+  if (env.pin_dir && pinned_kprobes())
+    fentry = false;
+  for (;;) {
+    skel = multilayer_io_tracer_bpf__open();
+    if (!skel) {
+      fprintf(stderr, "Failed to open BPF skeleton\n");
+      err = -1;
+      goto cleanup;
+    }
+
+    configure_filter_mode(skel);
+    configure_minio_discovery(skel);
+    configure_kernel_probes(skel);
+    configure_attach_mode(skel, fentry);
+    configure_object_tracking(skel, fentry);
+    configure_layers(skel);
+    pins_reused = env.pin_dir && reuse_pins(skel);
+
+    err = multilayer_io_tracer_bpf__load(skel);
+    if (pins_reused && err) {
+      if (env.verbose)
+        fprintf(stderr, "Cannot reuse the maps pinned in %s, reloading\n",
+                env.pin_dir);
+      multilayer_io_tracer_bpf__destroy(skel);
+      skel = NULL;
+      remove_pins();
+      continue;
+    }
+    if (pins_reused || !fentry || (!err && trampolines_attach(skel)))
+      break;
+
+    if (env.verbose)
+      fprintf(stderr, "fentry/fexit not usable, falling back to kprobes\n");
+    multilayer_io_tracer_bpf__destroy(skel);
+    skel = NULL;
+    fentry = false;
+  }
+  if (err) {
+    fprintf(stderr, "Failed to load BPF skeleton: %d\n", err);
     goto cleanup;
   }
+  if (env.verbose)
+    fprintf(stderr, "VFS and block probes: %s%s\n",
+            fentry ? "fentry/fexit" : "kprobes",
+            pins_reused ? ", reused from pins" : "");
+  if (pins_reused)
+    clear_pinned_maps(skel);
+
+  bpf_stats_fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+  if (bpf_stats_fd < 0 && env.verbose)
+    fprintf(stderr, "BPF run time stats unavailable: %s\n", strerror(errno));
+
+  err = configure_filter_targets(skel);
+  if (err)
+    goto cleanup;
 
-  err = multilayer_io_tracer_bpf__attach(skel);
+  // Configure MinIO tracing
+  err = configure_minio_tracing(skel);
   if (err) {
-    fprintf(stderr, "Failed to attach BPF skeleton: %d\n", err);
+    fprintf(stderr, "Failed to configure MinIO tracing\n");
+    goto cleanup;
+  }
+
+  // Rings must be in place before the programs are told to use them
+  if (setup_drainers(skel) != 0) {
+    err = -1;
+    goto cleanup;
+  }
+
+  err = configure_tracer(skel);
+  if (err)
+    goto cleanup;
+
+  latency_hists_fd = bpf_map__fd(skel->maps.latency_hists);
+  device_stats_fd = bpf_map__fd(skel->maps.device_stats_map);
+  device_max_depth_fd = bpf_map__fd(skel->maps.device_max_depth);
+  cache_stats_fd = bpf_map__fd(skel->maps.cache_stats_map);
+  sample_stats_fd = bpf_map__fd(skel->maps.sample_stats);
+  ring_drop_counts_fd = bpf_map__fd(skel->maps.ring_drop_counts);
+  layer_aggregates_fd = bpf_map__fd(skel->maps.layer_aggregates);
+  process_aggregates_fd = bpf_map__fd(skel->maps.process_aggregates);
+  object_stats_fd = bpf_map__fd(skel->maps.object_stats_map);
+  inode_paths_fd = bpf_map__fd(skel->maps.inode_paths);
+
+  // Pinned links are still attached
+  if (!pins_reused) {
+    err = multilayer_io_tracer_bpf__attach(skel);
+    if (err) {
+      fprintf(stderr, "Failed to attach BPF skeleton: %d\n", err);
+      goto cleanup;
+    }
+    if (minio_uprobes_enabled())
+      attach_minio_uprobes(skel);
+  }
+  attached = true;
+
+  if (env.exporter_addr) {
+    exporter = http_exporter_start(env.exporter_addr, render_metrics, NULL);
+    if (!exporter) {
+      fprintf(stderr, "Failed to listen on %s: %s\n", env.exporter_addr,
+              strerror(errno));
+      err = -1;
+      goto cleanup;
+    }
+  }
+
+  if (env.agent_addr && start_agent() != 0) {
+    err = -1;
     goto cleanup;
   }
 
+  // Scan only once the exec/fork programs are live, so a MinIO started in
+  // between is not missed
+  if (env.minio_only && env.auto_detect_minio) {
+    int count = find_minio_processes(skel);
+    if (count == 0)
+      fprintf(stderr, "No MinIO processes running yet; new ones will be "
+                      "picked up when they start\n");
+    else
+      printf("Found %d MinIO process(es)\n", count);
+  }
+
   if (env.verbose) {
     fprintf(stderr, "Multi-layer I/O tracer started!\n");
     fprintf(stderr, "Tracing layers: Application, Storage Service, OS, "
@@ -924,28 +4504,46 @@ int main(int argc, char **argv) {
       fprintf(stderr, "MinIO-only mode enabled\n");
     if (env.correlation_mode)
       fprintf(stderr, "Request correlation mode enabled\n");
+    if (env.aggregate)
+      fprintf(stderr, "In-kernel aggregation mode, reading every %ds\n",
+              env.interval);
+    if (env.exporter_addr)
+      fprintf(stderr, "Serving metrics on %s/metrics\n", env.exporter_addr);
+    if (env.agent_addr)
+      fprintf(stderr, "Sending aggregates to %s every %ds\n", env.agent_addr,
+              env.interval);
   }
 
-  rb = ring_buffer__new(bpf_map__fd(skel->maps.events), handle_event, NULL,
-                        NULL);
-  if (!rb) {
-    err = -1;
-    fprintf(stderr, "Failed to create ring buffer\n");
-    goto cleanup;
-  }
+  if (!env.aggregate)
+    print_header();
 
-  print_header();
+  err = start_drainers();
+  if (err)
+    goto cleanup;
 
   time_t start_time = time(NULL);
+  time_t last_read = start_time;
+  time_t last_flush = start_time;
+  time_t last_report = start_time;
+  time_t last_sample = 0;
+  useconds_t idle_us = IDLE_SLEEP_MIN_US;
+  useconds_t idle_max_us =
+      env.wakeup_kb > 0 ? (useconds_t)env.wakeup_ms * 1000 : IDLE_SLEEP_MAX_US;
   while (!exiting) {
-    err = ring_buffer__poll(rb, 100);
-    if (err == -EINTR) {
-      err = 0;
-      break;
-    }
-    if (err < 0) {
-      fprintf(stderr, "Error polling ring buffer: %d\n", err);
-      break;
+    __u64 batch_start = monotonic_ns();
+    int handled = process_queue(4096);
+
+    sample_ring_fill();
+    if (handled > 0) {
+      handler_ns += monotonic_ns() - batch_start;
+      handled_events += handled;
+      idle_us = IDLE_SLEEP_MIN_US;
+    } else {
+      if (atomic_load(&drainers_done) == num_drainers)
+        break;
+      // Back off while idle, but come back quickly once events flow again
+      usleep(idle_us);
+      idle_us = idle_us * 2 < idle_max_us ? idle_us * 2 : idle_max_us;
     }
 
     // Check duration limit
@@ -955,25 +4553,108 @@ int main(int argc, char **argv) {
       exiting = true; // Set flag instead of breaking
     }
 
-    // Periodically refresh MinIO PIDs if auto-detect is enabled
-    if (env.auto_detect_minio && (time(NULL) - start_time) % 10 == 0) {
-      find_minio_processes(skel);
+    time_t now = time(NULL);
+    if (out_stream && now != last_flush) {
+      last_flush = now;
+      stream_writer_flush(out_stream);
+    }
+    // The live windows need a sample every second whatever the interval
+    if (env.live && now != last_sample) {
+      last_sample = now;
+      read_aggregates(skel);
+      live_sample();
+    }
+    if (kernel_totals() && now - last_read >= env.interval) {
+      last_read = now;
+      if (!env.live)
+        read_aggregates(skel);
+      if (env.aggregate && env.realtime) {
+        if (env.live)
+          print_live_view(now - start_time);
+        else
+          print_aggregate_snapshot(now - start_time);
+        print_top_objects();
+      }
+      if (env.adaptive)
+        adapt_sampling(skel);
+      if (agent)
+        agent_send_interval();
     }
+    if (env.verbose && now - last_report >= env.interval) {
+      print_self_stats_line(now - last_report);
+      last_report = now;
+    }
+  }
+
+  stop_drainers();
+  while (process_queue(4096) > 0)
+    ;
+  if (drain_err) {
+    fprintf(stderr, "Error polling ring buffer: %d\n", drain_err);
+    err = drain_err;
   }
 
+  if (kernel_totals())
+    read_aggregates(skel);
+  if (agent)
+    agent_send_interval();
+
   // ALWAYS print summary before cleanup
-  if (!exiting || output_fp) { // Print if we haven't already in signal handler
-    print_amplification_summary();
-    if (env.minio_only) {
-      print_minio_summary();
-    }
+  if (interrupted && !env.aggregate)
+    fprintf(output_fp, "\n=== Tracer interrupted, generating summary ===\n");
+  print_amplification_summary();
+  print_top_objects();
+  print_class_summary();
+  print_bucket_summary();
+  print_latency_summary();
+  print_device_summary();
+  print_cache_summary();
+  if (env.minio_only) {
+    print_minio_summary();
   }
+  print_sampling_summary();
+  print_queue_stats();
+  print_self_stats(skel, time(NULL) - start_time);
 
 cleanup:
-  if (rb)
-    ring_buffer__free(rb);
+  http_exporter_stop(exporter);
+  cluster_agent_free(agent);
+  request_table_free(agent_objects);
+  stop_drainers();
+  free_drainers();
+  if (skel && env.pin_dir && attached)
+    pin_programs(skel);
+  for (int i = 0; i < num_go_links; i++)
+    bpf_link__destroy(go_links[i]);
   if (skel)
     multilayer_io_tracer_bpf__destroy(skel);
+  if (bpf_stats_fd >= 0)
+    close(bpf_stats_fd);
+  request_table_free(requests);
+
+  if (capture) {
+    __u64 captured = trace_writer_records(capture);
+    if (trace_writer_close(capture) != 0)
+      fprintf(stderr, "Failed to write capture file %s\n", env.capture_file);
+    else if (env.verbose)
+      fprintf(stderr, "Captured %llu events to %s\n", captured,
+              env.capture_file);
+  }
+
+  if (columns) {
+    __u64 rows = column_writer_rows(columns);
+    if (column_writer_close(columns) != 0)
+      fprintf(stderr, "Failed to write column file %s\n", env.columns_file);
+    else if (env.verbose)
+      fprintf(stderr, "Exported %llu events to %s\n", rows, env.columns_file);
+  }
+
+  if (out_stream) {
+    if (stream_writer_close(out_stream) != 0)
+      fprintf(stderr, "Failed to write output: %s\n",
+              env.output_file ? env.output_file : "stdout");
+    output_fp = raw_output_fp;
+  }
 
   if (output_fp && output_fp != stdout) {
     fflush(output_fp);
@@ -3,11 +3,22 @@
 # Fixed script to correctly parse actual test bytes from MinIO trace logs
 # File: parse_actual_bytes_fixed.py
 
+import os
 import sys
 import re
 from pathlib import Path
-from collections import defaultdict
+from collections import defaultdict, deque
 import json
+from multiprocessing import Pool
+
+import trace_columns
+
+# Entries on each side of an entry that is_test_operation() looks at
+CONTEXT = 5
+
+# Text traces are split into chunks of at least this size, analyzed in
+# parallel and merged back in file order
+MIN_CHUNK_BYTES = 16 * 1024 * 1024
 
 class IOTraceParser:
     def __init__(self, trace_file):
@@ -69,21 +80,20 @@ class IOTraceParser:
             return True
         return False
     
-    def is_test_operation(self, entry, context_window):
+    def is_test_operation(self, entry, near_marker):
         """Identify if this is part of the actual test operation"""
         # Test operations are identified by:
         # 1. Proximity to metadata operations (xl.meta)
         # 2. Proximity to sync operations
         # 3. Occurring in bursts (not regular intervals)
         # 4. Associated with actual data sizes or their aligned versions
-        
-        # Look for metadata operations in the context window
-        has_metadata = any('XL_META' in e.get('event', '') for e in context_window)
-        has_sync = any('FS_SYNC' in e.get('event', '') for e in context_window)
+        #
+        # near_marker is whether an XL_META or FS_SYNC event is within
+        # CONTEXT entries of this one (see is_marker())
         
         # For small tests (< 1KB), actual operations cluster around metadata/sync
         if self.test_size < 1024:
-            if has_metadata or has_sync:
+            if near_marker:
                 return True
             # Small operations that match or are close to test size
             if entry['size'] in [1, 10, 25, 100, 468, 563, 1024]:
@@ -97,62 +107,146 @@ class IOTraceParser:
     
     def parse_line(self, line):
         """Parse a single trace line"""
-        if 'TIME' in line or '===' in line or '>>>' in line or not line.strip():
-            return None
-            
-        parts = line.split()
-        if len(parts) < 7:
-            return None
-            
-        try:
-            entry = {
-                'timestamp': parts[0],
-                'layer': parts[1],
-                'event': parts[2],
-                'size': int(parts[3]),
-                'aligned_size': int(parts[4]),
-                'latency': float(parts[5]),
-                'comm': parts[6] if len(parts) > 6 else '',
-                'flags': ' '.join(parts[7:]) if len(parts) > 7 else ''
-            }
-            return entry
-        except (ValueError, IndexError):
-            return None
+        return parse_line(line)
     
-    def parse_file(self):
+    def parse_file(self, jobs=None):
         """Parse the trace file and separate test from background operations"""
-        
-        all_entries = []
-        
-        # First pass: collect all entries
-        with open(self.trace_file, 'r') as f:
-            for line in f:
-                entry = self.parse_line(line)
-                if entry:
-                    all_entries.append(entry)
-        
-        # Second pass: identify test operations using context windows
-        for i, entry in enumerate(all_entries):
-            # Create context window (±5 entries)
-            start_idx = max(0, i - 5)
-            end_idx = min(len(all_entries), i + 6)
-            context = all_entries[start_idx:end_idx]
-            
-            # Skip heartbeat operations
-            if self.is_heartbeat_operation(entry):
+        analyze_traces([self], jobs)
+
+    def parse_range(self, start, end):
+        """Analyze the entries whose lines start in [start, end) of a text
+        trace. The CONTEXT entries on either side of the range are read too,
+        so every entry sees the same context window as in a whole-file
+        pass and the results of adjacent ranges simply add up."""
+        with open(self.trace_file, 'rb') as f:
+            before = entries_before(f, start, CONTEXT)
+            stream = [(entry, False) for entry in before]
+            stream = _chain(stream, _range_entries(f, start, end))
+            self.analyze_stream(stream)
+
+    def analyze_stream(self, stream):
+        """Judge each (entry, counted) of stream against the entries
+        around it, only keeping a window of 2 * CONTEXT + 1 in memory.
+        Entries with counted False only serve as context."""
+        padding = [(None, False)] * CONTEXT
+        window = deque()
+        markers = 0
+
+        for item in _chain(stream, padding):
+            marker = item[0] is not None and is_marker(item[0])
+            window.append((item, marker))
+            markers += marker
+            if len(window) > 2 * CONTEXT + 1:
+                markers -= window.popleft()[1]
+            if len(window) <= CONTEXT:
+                continue
+
+            (entry, counted), _ = window[-CONTEXT - 1]
+            if counted:
+                self.analyze_entry(entry, markers > 0)
+
+    def analyze_entry(self, entry, near_marker):
+        """Account one entry, given whether its context window holds an
+        XL_META or FS_SYNC event"""
+        # Skip heartbeat operations
+        if self.is_heartbeat_operation(entry):
+            self.background_ops['heartbeat_count'] += 1
+            self.background_ops['heartbeat_bytes'] += entry['size']
+            return
+
+        # Check if this is a test operation
+        if self.is_test_operation(entry, near_marker):
+            self.categorize_test_operation(entry)
+        else:
+            # Still count as background if not identified as test
+            if entry['size'] == 8:
                 self.background_ops['heartbeat_count'] += 1
                 self.background_ops['heartbeat_bytes'] += entry['size']
-                continue
-            
-            # Check if this is a test operation
-            if self.is_test_operation(entry, context):
-                self.categorize_test_operation(entry)
-            else:
-                # Still count as background if not identified as test
-                if entry['size'] == 8:
-                    self.background_ops['heartbeat_count'] += 1
-                    self.background_ops['heartbeat_bytes'] += entry['size']
+
+    def results(self):
+        """What a worker process hands back to be merged"""
+        return (self.test_operations, self.background_ops,
+                self.significant_events)
+
+    def merge(self, results):
+        """Add the results() of another parser over the same trace"""
+        test_operations, background_ops, significant_events = results
+        for layer, ops in test_operations.items():
+            for kind, sizes in ops.items():
+                self.test_operations[layer][kind] += sizes
+        for key, value in background_ops.items():
+            self.background_ops[key] += value
+        self.significant_events += significant_events
     
+    def parse_columns(self):
+        """parse_file() for a column file written with the tracer's -W
+        option: the same heartbeat, context window and category rules,
+        applied to whole columns at once"""
+        import numpy as np
+
+        df = trace_columns.load_trace(self.trace_file)
+        n = len(df)
+        if n == 0:
+            return
+
+        layer = df['layer'].to_numpy()
+        event = df['event']
+        size = df['size'].to_numpy()
+        aligned = trace_columns.aligned_or_size(df)
+
+        heartbeat = (size == 8) & (layer == trace_columns.LAYER_APPLICATION)
+
+        # XL_META or FS_SYNC anywhere in the +-5 entry context window
+        marker = event.str.contains('XL_META|FS_SYNC').to_numpy()
+        seen = np.concatenate(([0], np.cumsum(marker)))
+        idx = np.arange(n)
+        near_marker = (seen[np.minimum(idx + 6, n)] -
+                       seen[np.maximum(idx - 5, 0)]) > 0
+
+        test = (size >= 1024) | (aligned >= 1024)
+        if self.test_size < 1024:
+            test |= near_marker
+            test |= np.isin(size, [1, 10, 25, 100, 468, 563, 1024])
+
+        background = ~heartbeat & ~test & (size == 8)
+        self.background_ops['heartbeat_count'] += int(heartbeat.sum() +
+                                                      background.sum())
+        self.background_ops['heartbeat_bytes'] += int(
+            size[heartbeat].sum() + size[background].sum())
+
+        test &= ~heartbeat
+        # Same list of entry dicts as categorize_test_operation() builds
+        self.significant_events = df[test].to_dict('records')
+
+        has = {key: event.str.contains(key).to_numpy()
+               for key in ('PUT', 'GET', 'WRITE', 'READ', 'META', 'SYNC',
+                           'SUBMIT', 'COMPLETE')}
+        at = {name: test & (layer == getattr(trace_columns, f'LAYER_{name}'))
+              for name in ('APPLICATION', 'STORAGE_SERVICE',
+                           'OPERATING_SYSTEM', 'FILESYSTEM', 'DEVICE')}
+        ops = self.test_operations
+
+        app = at['APPLICATION']
+        ops['application']['puts'] += size[app & has['PUT']].tolist()
+        ops['application']['gets'] += size[
+            app & ~has['PUT'] & has['GET']].tolist()
+
+        os_io = at['OPERATING_SYSTEM']
+        ops['os']['writes'] += aligned[os_io & has['WRITE']].tolist()
+        ops['os']['reads'] += aligned[
+            os_io & ~has['WRITE'] & has['READ']].tolist()
+
+        # Fixed sizes, as in categorize_test_operation()
+        ops['storage']['metadata'] += [450] * int(
+            (at['STORAGE_SERVICE'] & has['META']).sum())
+        ops['filesystem']['syncs'] += [4096] * int(
+            (at['FILESYSTEM'] & has['SYNC']).sum())
+
+        dev = at['DEVICE']
+        ops['device']['submits'] += size[dev & has['SUBMIT']].tolist()
+        ops['device']['completes'] += size[
+            dev & ~has['SUBMIT'] & has['COMPLETE']].tolist()
+
     def categorize_test_operation(self, entry):
         """Categorize a test operation by layer and type"""
         
@@ -364,37 +458,175 @@ class IOTraceParser:
         
         return json_data
 
+def parse_line(line):
+    """Parse a single trace line"""
+    if 'TIME' in line or '===' in line or '>>>' in line or not line.strip():
+        return None
+        
+    parts = line.split()
+    if len(parts) < 7:
+        return None
+        
+    try:
+        entry = {
+            'timestamp': parts[0],
+            'layer': parts[1],
+            'event': parts[2],
+            'size': int(parts[3]),
+            'aligned_size': int(parts[4]),
+            'latency': float(parts[5]),
+            'comm': parts[6] if len(parts) > 6 else '',
+            'flags': ' '.join(parts[7:]) if len(parts) > 7 else ''
+        }
+        return entry
+    except (ValueError, IndexError):
+        return None
+
+
+def is_marker(entry):
+    """Events that mark the neighbouring entries as test I/O"""
+    return 'XL_META' in entry['event'] or 'FS_SYNC' in entry['event']
+
+
+def _chain(*iterables):
+    for iterable in iterables:
+        yield from iterable
+
+
+def _decode(line):
+    return line.decode('utf-8', errors='replace')
+
+
+def entries_before(f, offset, count):
+    """The last count entries of lines ending at or before offset, which
+    must be the start of a line"""
+    block = 64 * 1024
+    while True:
+        pos = max(0, offset - block)
+        f.seek(pos)
+        lines = f.read(offset - pos).split(b'\n')
+        if pos > 0:
+            lines = lines[1:]  # Probably cut off at the front
+        entries = [e for e in map(parse_line, map(_decode, lines)) if e]
+        if len(entries) >= count or pos == 0:
+            return entries[max(0, len(entries) - count):]
+        block *= 4
+
+
+def _range_entries(f, start, end):
+    """Yield (entry, True) for the lines starting in [start, end), then
+    (entry, False) for up to CONTEXT entries after them"""
+    f.seek(start)
+    pos = start
+    after = 0
+    for line in f:
+        entry = parse_line(_decode(line))
+        if pos < end:
+            pos += len(line)
+            if entry:
+                yield entry, True
+            continue
+        if after == CONTEXT:
+            break
+        if entry:
+            yield entry, False
+            after += 1
+
+
+def chunk_offsets(path, chunks):
+    """Split a text trace into up to chunks ranges, each starting at a line"""
+    size = os.path.getsize(path)
+    chunks = max(1, min(chunks, size // MIN_CHUNK_BYTES))
+    offsets = [0]
+    with open(path, 'rb') as f:
+        for i in range(1, chunks):
+            f.seek(size * i // chunks)
+            f.readline()
+            pos = f.tell()
+            if offsets[-1] < pos < size:
+                offsets.append(pos)
+    offsets.append(size)
+    return list(zip(offsets, offsets[1:]))
+
+
+def _analyze_chunk(task):
+    path, start, end = task
+    parser = IOTraceParser(path)
+    if start is None:
+        parser.parse_columns()
+    else:
+        parser.parse_range(start, end)
+    return parser.results()
+
+
+def analyze_traces(parsers, jobs=None):
+    """Run parse_file() for every parser at once: text traces are cut into
+    chunks and all chunks of all traces share one pool of jobs worker
+    processes (default: one per CPU)"""
+    jobs = jobs or os.cpu_count() or 1
+    tasks = []
+    for index, parser in enumerate(parsers):
+        path = parser.trace_file
+        if trace_columns.is_column_file(path):
+            tasks.append((index, (path, None, None)))
+            continue
+        for start, end in chunk_offsets(path, jobs):
+            tasks.append((index, (path, start, end)))
+
+    work = [task for _, task in tasks]
+    if jobs == 1 or len(work) == 1:
+        results = map(_analyze_chunk, work)
+        for (index, _), result in zip(tasks, results):
+            parsers[index].merge(result)
+        return
+
+    # imap() keeps task order, so each trace is merged in file order
+    with Pool(min(jobs, len(work))) as pool:
+        results = pool.imap(_analyze_chunk, work)
+        for (index, _), result in zip(tasks, results):
+            parsers[index].merge(result)
+
+
 def main():
-    if len(sys.argv) < 2:
-        print("Usage: python parse_actual_bytes_fixed.py <trace_log_file>")
-        sys.exit(1)
-    
-    trace_file = sys.argv[1]
-    
-    if not Path(trace_file).exists():
-        print(f"Error: File {trace_file} not found")
+    args = sys.argv[1:]
+    jobs = None
+    if len(args) >= 2 and args[0] == '-j':
+        jobs = int(args[1])
+        args = args[2:]
+
+    if not args:
+        print("Usage: python parse_actual_bytes_fixed.py [-j JOBS] "
+              "<trace_log_file | trace.cols>...")
         sys.exit(1)
     
-    print(f"Parsing: {trace_file}")
-    print("-" * 40)
-    
-    parser = IOTraceParser(trace_file)
-    parser.parse_file()
-    
-    # Generate and print report
-    report = parser.generate_report()
-    print(report)
+    for trace_file in args:
+        if not Path(trace_file).exists():
+            print(f"Error: File {trace_file} not found")
+            sys.exit(1)
     
-    # Save report
-    report_file = trace_file.replace('.log', '_fixed_analysis.txt')
-    with open(report_file, 'w') as f:
-        f.write(report)
-    print(f"\nReport saved to: {report_file}")
+    # All size buckets are analyzed together, then reported one by one
+    parsers = [IOTraceParser(trace_file) for trace_file in args]
+    analyze_traces(parsers, jobs)
     
-    # Export JSON
-    json_file = trace_file.replace('.log', '_fixed_data.json')
-    parser.export_json(json_file)
-    print(f"JSON data saved to: {json_file}")
+    for parser in parsers:
+        trace_file = parser.trace_file
+        print(f"Parsing: {trace_file}")
+        print("-" * 40)
+        
+        # Generate and print report
+        report = parser.generate_report()
+        print(report)
+        
+        # Save report
+        report_file = trace_file.replace('.log', '_fixed_analysis.txt')
+        with open(report_file, 'w') as f:
+            f.write(report)
+        print(f"\nReport saved to: {report_file}")
+        
+        # Export JSON
+        json_file = trace_file.replace('.log', '_fixed_data.json')
+        parser.export_json(json_file)
+        print(f"JSON data saved to: {json_file}")
 
 if __name__ == "__main__":
     main()
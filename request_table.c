@@ -0,0 +1,345 @@
+// Request correlation table shared by the userspace tracers
+// File: request_table.c
+
+#include "request_table.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NIL UINT32_MAX
+#define INITIAL_CAPACITY 1024
+
+// Header stored in front of every value in the slab
+struct entry_hdr {
+  __u64 request_id;
+  __u64 last_seen;
+  __u32 prev; // Towards the most recently used end
+  __u32 next; // Towards the least recently used end, or free list link
+  __u32 in_use;
+  __u32 _pad;
+};
+
+struct request_table {
+  char *slab;
+  size_t stride;
+  size_t value_size;
+  size_t capacity;  // Entries allocated in the slab
+  size_t slab_used; // High-water mark of slab entries handed out
+  size_t max_entries;
+  __u32 free_head;
+
+  __u32 *index; // Slab positions, NIL for empty buckets
+  size_t index_mask;
+
+  __u32 lru_head; // Most recently used
+  __u32 lru_tail; // Least recently used
+  __u64 max_age_ns;
+
+  struct request_table_stats stats;
+};
+
+static inline __u64 hash_id(__u64 x) {
+  // splitmix64 finalizer: request ids are often sequential
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static inline struct entry_hdr *entry_at(const struct request_table *t,
+                                         __u32 pos) {
+  return (struct entry_hdr *)(t->slab + (size_t)pos * t->stride);
+}
+
+static inline void *entry_value(struct entry_hdr *e) { return e + 1; }
+
+// ============================================================================
+// HASH INDEX
+// ============================================================================
+
+// Returns the bucket holding request_id, or the empty bucket where it would
+// be inserted.
+static size_t index_find(const struct request_table *t, __u64 request_id) {
+  size_t b = hash_id(request_id) & t->index_mask;
+
+  while (t->index[b] != NIL) {
+    if (entry_at(t, t->index[b])->request_id == request_id)
+      return b;
+    b = (b + 1) & t->index_mask;
+  }
+  return b;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void index_remove(struct request_table *t, size_t b) {
+  size_t next = (b + 1) & t->index_mask;
+
+  t->index[b] = NIL;
+  while (t->index[next] != NIL) {
+    size_t home =
+        hash_id(entry_at(t, t->index[next])->request_id) & t->index_mask;
+
+    if (((next - home) & t->index_mask) >= ((next - b) & t->index_mask)) {
+      t->index[b] = t->index[next];
+      t->index[next] = NIL;
+      b = next;
+    }
+    next = (next + 1) & t->index_mask;
+  }
+}
+
+static int index_rebuild(struct request_table *t, size_t entries) {
+  size_t size = 1;
+  __u32 *index;
+
+  // Keep the load factor at or below one half
+  while (size < entries * 2)
+    size <<= 1;
+
+  index = malloc(size * sizeof(*index));
+  if (!index)
+    return -1;
+  memset(index, 0xff, size * sizeof(*index));
+
+  free(t->index);
+  t->index = index;
+  t->index_mask = size - 1;
+
+  for (size_t pos = 0; pos < t->slab_used; pos++) {
+    struct entry_hdr *e = entry_at(t, pos);
+    if (e->in_use)
+      t->index[index_find(t, e->request_id)] = pos;
+  }
+  return 0;
+}
+
+// ============================================================================
+// LRU LIST
+// ============================================================================
+
+static void lru_unlink(struct request_table *t, __u32 pos) {
+  struct entry_hdr *e = entry_at(t, pos);
+
+  if (e->prev != NIL)
+    entry_at(t, e->prev)->next = e->next;
+  else
+    t->lru_head = e->next;
+  if (e->next != NIL)
+    entry_at(t, e->next)->prev = e->prev;
+  else
+    t->lru_tail = e->prev;
+}
+
+static void lru_push_head(struct request_table *t, __u32 pos) {
+  struct entry_hdr *e = entry_at(t, pos);
+
+  e->prev = NIL;
+  e->next = t->lru_head;
+  if (t->lru_head != NIL)
+    entry_at(t, t->lru_head)->prev = pos;
+  t->lru_head = pos;
+  if (t->lru_tail == NIL)
+    t->lru_tail = pos;
+}
+
+static void touch(struct request_table *t, __u32 pos, __u64 now_ns) {
+  struct entry_hdr *e = entry_at(t, pos);
+
+  if (now_ns > e->last_seen)
+    e->last_seen = now_ns;
+  if (t->lru_head != pos) {
+    lru_unlink(t, pos);
+    lru_push_head(t, pos);
+  }
+}
+
+static void evict(struct request_table *t, __u32 pos) {
+  struct entry_hdr *e = entry_at(t, pos);
+
+  index_remove(t, index_find(t, e->request_id));
+  lru_unlink(t, pos);
+  e->in_use = 0;
+  e->next = t->free_head;
+  t->free_head = pos;
+  t->stats.count--;
+}
+
+static void expire(struct request_table *t, __u64 now_ns) {
+  if (t->max_age_ns == 0)
+    return;
+
+  while (t->lru_tail != NIL) {
+    struct entry_hdr *e = entry_at(t, t->lru_tail);
+    if (now_ns <= e->last_seen || now_ns - e->last_seen <= t->max_age_ns)
+      break;
+    evict(t, t->lru_tail);
+    t->stats.age_evictions++;
+  }
+}
+
+static int grow(struct request_table *t) {
+  size_t capacity = t->capacity * 2;
+  char *slab;
+
+  if (capacity > t->max_entries)
+    capacity = t->max_entries;
+
+  slab = realloc(t->slab, capacity * t->stride);
+  if (!slab)
+    return -1;
+  t->slab = slab;
+
+  // Only take the new capacity once the index can hold it
+  if (index_rebuild(t, capacity) != 0)
+    return -1;
+  t->capacity = capacity;
+  return 0;
+}
+
+// Returns a free slab position, growing the slab or evicting the LRU entry
+// when it is full
+static __u32 alloc_entry(struct request_table *t) {
+  __u32 pos;
+
+  if (t->free_head == NIL && t->slab_used == t->capacity) {
+    if (t->capacity < t->max_entries && grow(t) == 0) {
+      // Room at the end of the slab now
+    } else if (t->lru_tail != NIL) {
+      evict(t, t->lru_tail);
+      t->stats.lru_evictions++;
+    } else {
+      return NIL;
+    }
+  }
+
+  if (t->free_head != NIL) {
+    pos = t->free_head;
+    t->free_head = entry_at(t, pos)->next;
+  } else {
+    pos = t->slab_used++;
+  }
+  return pos;
+}
+
+// ============================================================================
+// PUBLIC INTERFACE
+// ============================================================================
+
+struct request_table *request_table_new(size_t value_size, size_t max_entries,
+                                        __u64 max_age_ns) {
+  struct request_table *t;
+
+  if (max_entries == 0 || max_entries >= NIL)
+    return NULL;
+
+  t = calloc(1, sizeof(*t));
+  if (!t)
+    return NULL;
+
+  t->value_size = value_size;
+  t->stride = (sizeof(struct entry_hdr) + value_size + 7) & ~(size_t)7;
+  t->max_entries = max_entries;
+  t->capacity =
+      max_entries < INITIAL_CAPACITY ? max_entries : INITIAL_CAPACITY;
+  t->free_head = NIL;
+  t->lru_head = NIL;
+  t->lru_tail = NIL;
+  t->max_age_ns = max_age_ns;
+  t->stats.max_entries = max_entries;
+
+  t->slab = malloc(t->capacity * t->stride);
+  if (!t->slab || index_rebuild(t, t->capacity) != 0) {
+    request_table_free(t);
+    return NULL;
+  }
+  return t;
+}
+
+void request_table_free(struct request_table *t) {
+  if (!t)
+    return;
+  free(t->index);
+  free(t->slab);
+  free(t);
+}
+
+void *request_table_lookup(struct request_table *t, __u64 request_id,
+                           __u64 now_ns) {
+  size_t b;
+
+  expire(t, now_ns);
+
+  b = index_find(t, request_id);
+  if (t->index[b] == NIL)
+    return NULL;
+
+  touch(t, t->index[b], now_ns);
+  return entry_value(entry_at(t, t->index[b]));
+}
+
+void *request_table_get_or_create(struct request_table *t, __u64 request_id,
+                                  __u64 now_ns, int *created) {
+  struct entry_hdr *e;
+  void *value;
+  __u32 pos;
+
+  if (created)
+    *created = 0;
+
+  value = request_table_lookup(t, request_id, now_ns);
+  if (value)
+    return value;
+
+  pos = alloc_entry(t);
+  if (pos == NIL)
+    return NULL;
+
+  e = entry_at(t, pos);
+  memset(e, 0, t->stride);
+  e->request_id = request_id;
+  e->last_seen = now_ns;
+  e->in_use = 1;
+
+  // alloc_entry() may have evicted or rebuilt, so probe again
+  t->index[index_find(t, request_id)] = pos;
+  lru_push_head(t, pos);
+
+  t->stats.count++;
+  t->stats.inserts++;
+  if (t->stats.count > t->stats.peak)
+    t->stats.peak = t->stats.count;
+
+  if (created)
+    *created = 1;
+  return entry_value(e);
+}
+
+size_t request_table_count(const struct request_table *t) {
+  return t ? t->stats.count : 0;
+}
+
+void request_table_get_stats(const struct request_table *t,
+                             struct request_table_stats *out) {
+  if (t)
+    *out = t->stats;
+  else
+    memset(out, 0, sizeof(*out));
+}
+
+size_t request_table_collect(const struct request_table *t, void **out,
+                             size_t max) {
+  size_t n = 0;
+
+  if (!t)
+    return 0;
+
+  for (size_t pos = 0; pos < t->slab_used && n < max; pos++) {
+    struct entry_hdr *e = entry_at(t, pos);
+    if (e->in_use)
+      out[n++] = entry_value(e);
+  }
+  return n;
+}
@@ -0,0 +1,55 @@
+// Request correlation table shared by the userspace tracers
+// File: request_table.h
+//
+// Open-addressing hash index keyed by request_id over a slab of fixed-size
+// entries. Entries are kept on an LRU list; once the table reaches its
+// maximum size the least recently touched request is evicted, and requests
+// idle for longer than max_age_ns are expired as new events arrive.
+
+#ifndef REQUEST_TABLE_H
+#define REQUEST_TABLE_H
+
+#include <linux/types.h>
+#include <stddef.h>
+
+#define REQUEST_TABLE_DEFAULT_MAX 65536
+#define REQUEST_TABLE_DEFAULT_AGE_SEC 60
+
+struct request_table;
+
+struct request_table_stats {
+  size_t count;
+  size_t peak;
+  size_t max_entries;
+  __u64 inserts;
+  __u64 lru_evictions;
+  __u64 age_evictions;
+};
+
+// value_size bytes of zeroed per-request state are stored inline with each
+// entry. max_age_ns of 0 disables age expiry.
+struct request_table *request_table_new(size_t value_size, size_t max_entries,
+                                        __u64 max_age_ns);
+void request_table_free(struct request_table *t);
+
+// Returns the value for request_id and marks it most recently used, or NULL.
+// now_ns drives age expiry and should be the event timestamp.
+void *request_table_lookup(struct request_table *t, __u64 request_id,
+                           __u64 now_ns);
+
+// Like request_table_lookup(), but inserts a zeroed value when request_id is
+// not present. Returns NULL only on allocation failure.
+void *request_table_get_or_create(struct request_table *t, __u64 request_id,
+                                  __u64 now_ns, int *created);
+
+size_t request_table_count(const struct request_table *t);
+void request_table_get_stats(const struct request_table *t,
+                             struct request_table_stats *out);
+
+// Fills out[] with up to max value pointers in slab order, which is insertion
+// order until the first eviction. Returns the number of pointers written.
+// The pointers are invalidated by the next insert.
+size_t request_table_collect(const struct request_table *t, void **out,
+                             size_t max);
+
+#endif // REQUEST_TABLE_H
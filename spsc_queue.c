@@ -0,0 +1,118 @@
+// Lock-free single-producer/single-consumer queue of variable-length records
+// File: spsc_queue.c
+
+#include "spsc_queue.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_ALIGN 8
+#define WRAP_MARKER UINT32_MAX
+
+struct record_hdr {
+  __u32 len;
+  __u32 _pad;
+};
+
+static inline size_t record_size(__u32 len) {
+  return (sizeof(struct record_hdr) + len + RECORD_ALIGN - 1) &
+         ~(size_t)(RECORD_ALIGN - 1);
+}
+
+int spsc_queue_init(struct spsc_queue *q, size_t capacity) {
+  size_t size = 4096;
+
+  while (size < capacity)
+    size <<= 1;
+
+  memset(q, 0, sizeof(*q));
+  if (posix_memalign((void **)&q->buf, SPSC_CACHELINE, size) != 0) {
+    q->buf = NULL;
+    return -1;
+  }
+  q->capacity = size;
+  q->mask = size - 1;
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->drops, 0);
+  atomic_init(&q->drop_bytes, 0);
+  return 0;
+}
+
+void spsc_queue_destroy(struct spsc_queue *q) {
+  free(q->buf);
+  q->buf = NULL;
+}
+
+int spsc_queue_push(struct spsc_queue *q, const void *data, __u32 len) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  size_t pos = head & q->mask;
+  size_t need = record_size(len);
+  size_t to_end = q->capacity - pos;
+  // A record never straddles the end of the buffer
+  size_t total = need + (to_end < need ? to_end : 0);
+
+  if (need > q->capacity / 2 || len == WRAP_MARKER)
+    goto drop;
+
+  if (q->capacity - (head - q->cached_tail) < total) {
+    q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (q->capacity - (head - q->cached_tail) < total)
+      goto drop;
+  }
+
+  if (to_end < need) {
+    ((struct record_hdr *)(q->buf + pos))->len = WRAP_MARKER;
+    head += to_end;
+    pos = 0;
+  }
+
+  struct record_hdr *hdr = (struct record_hdr *)(q->buf + pos);
+  hdr->len = len;
+  memcpy(hdr + 1, data, len);
+
+  size_t used = head + need - q->cached_tail;
+  if (used > q->peak_used)
+    q->peak_used = used;
+  q->pushed++;
+
+  atomic_store_explicit(&q->head, head + need, memory_order_release);
+  return 0;
+
+drop:
+  atomic_fetch_add_explicit(&q->drops, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&q->drop_bytes, len, memory_order_relaxed);
+  return -1;
+}
+
+void *spsc_queue_peek(struct spsc_queue *q, __u32 *len) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+  for (;;) {
+    if (tail == q->cached_head) {
+      q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+      if (tail == q->cached_head)
+        return NULL;
+    }
+
+    size_t pos = tail & q->mask;
+    struct record_hdr *hdr = (struct record_hdr *)(q->buf + pos);
+    if (hdr->len != WRAP_MARKER) {
+      *len = hdr->len;
+      return hdr + 1;
+    }
+
+    // Skip the unused space at the end of the buffer
+    tail += q->capacity - pos;
+    atomic_store_explicit(&q->tail, tail, memory_order_release);
+  }
+}
+
+void spsc_queue_release(struct spsc_queue *q) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  struct record_hdr *hdr = (struct record_hdr *)(q->buf + (tail & q->mask));
+
+  atomic_store_explicit(&q->tail, tail + record_size(hdr->len),
+                        memory_order_release);
+}
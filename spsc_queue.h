@@ -0,0 +1,55 @@
+// Lock-free single-producer/single-consumer queue of variable-length records
+// File: spsc_queue.h
+//
+// Used to hand ring buffer records from the drain thread to the thread that
+// does statistics, correlation and output. Records are copied into a
+// power-of-two byte ring with a small length header and padded to 8 bytes,
+// so the consumer sees them at the same alignment as the BPF ring buffer.
+// When the queue is full the record is dropped and counted.
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <linux/types.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define SPSC_CACHELINE 64
+
+struct spsc_queue {
+  // Producer side
+  _Alignas(SPSC_CACHELINE) _Atomic size_t head;
+  size_t cached_tail;
+  _Atomic __u64 drops;
+  _Atomic __u64 drop_bytes;
+  __u64 pushed;
+
+  // Consumer side
+  _Alignas(SPSC_CACHELINE) _Atomic size_t tail;
+  size_t cached_head;
+
+  _Alignas(SPSC_CACHELINE) char *buf;
+  size_t capacity;
+  size_t mask;
+  size_t peak_used;
+};
+
+// capacity is rounded up to a power of two
+int spsc_queue_init(struct spsc_queue *q, size_t capacity);
+void spsc_queue_destroy(struct spsc_queue *q);
+
+// Producer: copy a record in. Returns 0, or -1 if the queue was full and the
+// record was dropped.
+int spsc_queue_push(struct spsc_queue *q, const void *data, __u32 len);
+
+// Consumer: return the oldest record without removing it, or NULL if the
+// queue is empty. The pointer stays valid until spsc_queue_release().
+void *spsc_queue_peek(struct spsc_queue *q, __u32 *len);
+void spsc_queue_release(struct spsc_queue *q);
+
+static inline size_t spsc_queue_used(struct spsc_queue *q) {
+  return atomic_load_explicit(&q->head, memory_order_acquire) -
+         atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,187 @@
+// Buffered, optionally gzip-compressed output stream for the tracers
+// File: stream_writer.c
+
+#define _GNU_SOURCE // fopencookie
+#include "stream_writer.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define ZBUF_SIZE (256 * 1024)
+#define GZIP_WINDOW_BITS (15 + 16) // Default window, gzip framing
+
+struct stream_writer {
+  int fd;
+  char *buf;
+  size_t used;
+  bool gzip;
+  z_stream zs;
+  unsigned char *zbuf;
+  FILE *file;
+  bool dirty; // Written to since the last explicit flush
+  int error;
+};
+
+static int write_all(int fd, const void *data, size_t len) {
+  const char *p = data;
+
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+// Hands the buffer to the kernel, through deflate() when compressing.
+// mode is a zlib flush mode and only matters with gzip.
+static int drain(struct stream_writer *w, int mode) {
+  int err = 0, ret;
+
+  if (!w->gzip) {
+    if (w->used > 0)
+      err = write_all(w->fd, w->buf, w->used);
+    goto out;
+  }
+
+  w->zs.next_in = (unsigned char *)w->buf;
+  w->zs.avail_in = w->used;
+  do {
+    w->zs.next_out = w->zbuf;
+    w->zs.avail_out = ZBUF_SIZE;
+    ret = deflate(&w->zs, mode);
+    if (ret == Z_STREAM_ERROR) {
+      err = -EIO;
+      break;
+    }
+    size_t have = ZBUF_SIZE - w->zs.avail_out;
+    if (have > 0 && (err = write_all(w->fd, w->zbuf, have)) != 0)
+      break;
+  } while (w->zs.avail_out == 0 ||
+           (mode == Z_FINISH && ret != Z_STREAM_END));
+
+out:
+  w->used = 0;
+  if (mode != Z_NO_FLUSH)
+    w->dirty = false;
+  if (err && !w->error)
+    w->error = err;
+  return err;
+}
+
+static ssize_t cookie_write(void *cookie, const char *data, size_t len) {
+  struct stream_writer *w = cookie;
+
+  return stream_writer_write(w, data, len) == 0 ? (ssize_t)len : 0;
+}
+
+// ============================================================================
+// PUBLIC INTERFACE
+// ============================================================================
+
+struct stream_writer *stream_writer_open(int fd, bool gzip) {
+  cookie_io_functions_t io = {.write = cookie_write};
+  struct stream_writer *w;
+
+  w = calloc(1, sizeof(*w));
+  if (!w)
+    return NULL;
+
+  w->fd = fd;
+  w->gzip = gzip;
+  w->buf = malloc(STREAM_WRITER_BUFFER_SIZE);
+  if (!w->buf)
+    goto err;
+
+  if (gzip) {
+    w->zbuf = malloc(ZBUF_SIZE);
+    // Fastest level: the point is to keep up with the event rate
+    if (!w->zbuf || deflateInit2(&w->zs, Z_BEST_SPEED, Z_DEFLATED,
+                                 GZIP_WINDOW_BITS, 8,
+                                 Z_DEFAULT_STRATEGY) != Z_OK) {
+      w->gzip = false;
+      goto err;
+    }
+  }
+
+  w->file = fopencookie(w, "w", io);
+  if (!w->file)
+    goto err;
+  // Unbuffered, so fprintf() output lands in order with reserved records
+  setvbuf(w->file, NULL, _IONBF, 0);
+  return w;
+
+err:
+  if (w->gzip)
+    deflateEnd(&w->zs);
+  free(w->zbuf);
+  free(w->buf);
+  free(w);
+  return NULL;
+}
+
+char *stream_writer_reserve(struct stream_writer *w, size_t len) {
+  if (len > STREAM_WRITER_BUFFER_SIZE)
+    return NULL;
+  if (w->used + len > STREAM_WRITER_BUFFER_SIZE)
+    drain(w, Z_NO_FLUSH);
+  return w->buf + w->used;
+}
+
+void stream_writer_commit(struct stream_writer *w, char *end) {
+  w->used = end - w->buf;
+  w->dirty = true;
+}
+
+int stream_writer_write(struct stream_writer *w, const void *data,
+                        size_t len) {
+  const char *p = data;
+
+  w->dirty = true;
+  while (len > 0) {
+    size_t room = STREAM_WRITER_BUFFER_SIZE - w->used;
+    size_t n = len < room ? len : room;
+
+    memcpy(w->buf + w->used, p, n);
+    w->used += n;
+    p += n;
+    len -= n;
+    if (w->used == STREAM_WRITER_BUFFER_SIZE && drain(w, Z_NO_FLUSH) != 0)
+      return w->error;
+  }
+  return 0;
+}
+
+int stream_writer_flush(struct stream_writer *w) {
+  // A sync flush makes everything so far decompressible by a reader
+  // following the file, at a small cost in compression ratio
+  if (!w->dirty)
+    return 0;
+  return drain(w, Z_SYNC_FLUSH);
+}
+
+FILE *stream_writer_file(struct stream_writer *w) { return w->file; }
+
+int stream_writer_close(struct stream_writer *w) {
+  int err;
+
+  if (!w)
+    return 0;
+
+  fclose(w->file);
+  drain(w, Z_FINISH);
+  if (w->gzip)
+    deflateEnd(&w->zs);
+  err = w->error;
+  free(w->zbuf);
+  free(w->buf);
+  free(w);
+  return err;
+}
@@ -0,0 +1,97 @@
+// Buffered, optionally gzip-compressed output stream for the tracers
+// File: stream_writer.h
+//
+// Per-event output is formatted straight into one large reusable buffer
+// with the put_* helpers below and handed to the kernel in big writes,
+// instead of going through printf and a flush for every event. The
+// buffer is only flushed when it fills up, when stream_writer_flush() is
+// called (the tracer does this about once a second) and on close.
+//
+// stream_writer_file() returns an unbuffered stdio view of the same stream,
+// so the existing fprintf() summaries stay in order with the events and
+// end up in the same (possibly compressed) output.
+
+#ifndef STREAM_WRITER_H
+#define STREAM_WRITER_H
+
+#include <linux/types.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define STREAM_WRITER_BUFFER_SIZE (1024 * 1024)
+
+struct stream_writer;
+
+// Writes to fd, which stays owned by the caller. With gzip the output is a
+// single gzip member, readable with zcat even while it is being written.
+struct stream_writer *stream_writer_open(int fd, bool gzip);
+// Returns room for at least len bytes at the end of the buffer, flushing
+// first if needed, or NULL if len is larger than the buffer
+char *stream_writer_reserve(struct stream_writer *w, size_t len);
+// Takes everything formatted into the reserved space up to end
+void stream_writer_commit(struct stream_writer *w, char *end);
+int stream_writer_write(struct stream_writer *w, const void *data,
+                        size_t len);
+// Writes out everything buffered so far
+int stream_writer_flush(struct stream_writer *w);
+FILE *stream_writer_file(struct stream_writer *w);
+// Flushes, finishes the compressed stream and frees the writer. Returns 0,
+// or the first write error seen.
+int stream_writer_close(struct stream_writer *w);
+
+// ============================================================================
+// FORMATTING HELPERS
+// ============================================================================
+// Each writes at p and returns the position after the last character
+
+static inline char *put_char(char *p, char c) {
+  *p++ = c;
+  return p;
+}
+
+// Copies a string literal or other short string, at most max bytes
+static inline char *put_str(char *p, const char *s, size_t max) {
+  size_t len = strnlen(s, max);
+
+  memcpy(p, s, len);
+  return p + len;
+}
+
+#define put_lit(p, s) (memcpy((p), (s), sizeof(s) - 1), (p) + sizeof(s) - 1)
+
+// %llu
+static inline char *put_u64(char *p, __u64 v) {
+  char tmp[20];
+  int n = 0;
+
+  do {
+    tmp[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n > 0)
+    *p++ = tmp[--n];
+  return p;
+}
+
+// Zero-padded to width digits, e.g. %09llu. v must fit in width digits.
+static inline char *put_u64_pad(char *p, __u64 v, int width) {
+  for (int i = width - 1; i >= 0; i--) {
+    p[i] = '0' + v % 10;
+    v /= 10;
+  }
+  return p + width;
+}
+
+// %016llx
+static inline char *put_hex64(char *p, __u64 v) {
+  static const char digits[] = "0123456789abcdef";
+
+  for (int i = 15; i >= 0; i--) {
+    p[i] = digits[v & 0xf];
+    v >>= 4;
+  }
+  return p + 16;
+}
+
+#endif // STREAM_WRITER_H
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+
+# Loader for the tracer's columnar event export (multilayer_io_tracer -W)
+# File: trace_columns.py
+#
+# numpy and pandas are only imported once a column file is actually
+# loaded, so scripts that also take text logs work without them.
+#
+# The file layout is described in column_file.h. Each block holds every
+# column as a packed little-endian array, so loading is a handful of
+# numpy.frombuffer() calls per 65536 events instead of a regex per line.
+
+import struct
+import sys
+from pathlib import Path
+
+COLUMN_FILE_MAGIC = b'MLIOCOL\0'
+COLUMN_FILE_VERSION = 1
+COLUMN_BLOCK_MAGIC = 0x4b4c4243
+
+FILE_HEADER = struct.Struct('<8sIIQ64s')
+COLUMN_DESC = struct.Struct('<24sII')
+BLOCK_HEADER = struct.Struct('<II')
+
+# Layers and names as printed by the tracer (must match
+# multilayer_io_tracer.c)
+LAYER_APPLICATION = 1
+LAYER_STORAGE_SERVICE = 2
+LAYER_OPERATING_SYSTEM = 3
+LAYER_FILESYSTEM = 4
+LAYER_DEVICE = 5
+
+LAYER_NAMES = ['UNKNOWN', 'APPLICATION', 'STORAGE_SVC', 'OS', 'FILESYSTEM',
+               'DEVICE']
+
+EVENT_NAMES = {
+    101: 'APP_READ', 102: 'APP_WRITE', 103: 'APP_OPEN', 104: 'APP_CLOSE',
+    105: 'APP_FSYNC', 106: 'APP_COPY', 107: 'APP_MMAP_READ',
+    108: 'APP_URING_SUBMIT',
+    201: 'MINIO_OBJECT_PUT', 202: 'MINIO_OBJECT_GET',
+    203: 'MINIO_ERASURE_WRITE', 204: 'MINIO_METADATA_UPDATE',
+    205: 'MINIO_BITROT_CHECK', 206: 'MINIO_MULTIPART', 207: 'MINIO_XL_META',
+    208: 'MINIO_ERASURE_READ',
+    301: 'OS_SYSCALL_ENTER', 302: 'OS_SYSCALL_EXIT', 303: 'OS_VFS_READ',
+    304: 'OS_VFS_WRITE', 305: 'OS_PAGE_CACHE_HIT', 306: 'OS_PAGE_CACHE_MISS',
+    307: 'OS_CONTEXT_SWITCH',
+    401: 'FS_SYNC', 402: 'FS_METADATA_UPDATE', 403: 'FS_DATA_WRITE',
+    404: 'FS_INODE_UPDATE', 405: 'FS_EXTENT_ALLOC', 406: 'FS_BLOCK_ALLOC',
+    407: 'FS_WRITEBACK', 408: 'FS_JOURNAL_COMMIT',
+    501: 'DEV_BIO_SUBMIT', 502: 'DEV_BIO_COMPLETE', 503: 'DEV_REQUEST_QUEUE',
+    504: 'DEV_REQUEST_COMPLETE', 505: 'DEV_FTL_WRITE', 506: 'DEV_TRIM',
+}
+
+SYSTEM_NAMES = ['Unknown', 'MinIO', 'Ceph', 'etcd', 'PostgreSQL', 'GlusterFS',
+                'Application']
+
+# Event flag bits (must match multilayer_io_tracer.c)
+FLAG_COLUMNS = {
+    'is_metadata': 1 << 0,
+    'is_journal': 1 << 1,
+    'cache_hit': 1 << 2,
+    'is_minio': 1 << 3,
+    'is_xl_meta': 1 << 4,
+    'sampled': 1 << 6,
+    'inherited': 1 << 7,
+}
+
+
+def is_column_file(path):
+    """True if path was written by the tracer's -W option"""
+    try:
+        with open(path, 'rb') as f:
+            return f.read(len(COLUMN_FILE_MAGIC)) == COLUMN_FILE_MAGIC
+    except OSError:
+        return False
+
+
+def read_columns(path):
+    """Return ({name: numpy array}, header dict) for every column in path.
+
+    A trailing block cut short by a killed tracer is dropped, so every
+    column always has the same length.
+    """
+    import numpy as np
+
+    raw = np.memmap(path, dtype=np.uint8, mode='r')
+    if len(raw) < FILE_HEADER.size:
+        raise ValueError(f"{path}: not a column file")
+
+    magic, version, num_columns, boot_offset_ns, hostname = \
+        FILE_HEADER.unpack_from(raw, 0)
+    if magic != COLUMN_FILE_MAGIC:
+        raise ValueError(f"{path}: not a column file")
+    if version != COLUMN_FILE_VERSION:
+        raise ValueError(f"{path}: unsupported column file version {version}")
+
+    pos = FILE_HEADER.size
+    columns = []
+    for _ in range(num_columns):
+        name, width, _pad = COLUMN_DESC.unpack_from(raw, pos)
+        columns.append((name.rstrip(b'\0').decode(), np.dtype(f'<u{width}')))
+        pos += COLUMN_DESC.size
+
+    parts = {name: [] for name, _ in columns}
+    while pos + BLOCK_HEADER.size <= len(raw):
+        magic, rows = BLOCK_HEADER.unpack_from(raw, pos)
+        if magic != COLUMN_BLOCK_MAGIC:
+            raise ValueError(f"{path}: corrupt block at offset {pos}")
+
+        sizes = [(dtype.itemsize * rows + 7) & ~7 for _, dtype in columns]
+        if pos + BLOCK_HEADER.size + sum(sizes) > len(raw):
+            print(f"Warning: {path} truncated, dropping last block",
+                  file=sys.stderr)
+            break
+
+        pos += BLOCK_HEADER.size
+        for (name, dtype), size in zip(columns, sizes):
+            parts[name].append(np.frombuffer(raw, dtype=dtype, count=rows,
+                                             offset=pos))
+            pos += size
+
+    data = {}
+    for name, dtype in columns:
+        data[name] = (np.concatenate(parts[name]) if parts[name]
+                      else np.empty(0, dtype=dtype))
+
+    header = {
+        'boot_offset_ns': boot_offset_ns,
+        'hostname': hostname.rstrip(b'\0').decode(errors='replace'),
+    }
+    return data, header
+
+
+def _categorical(codes, names):
+    """Map integer codes to a pandas Categorical without a per-row lookup"""
+    import numpy as np
+    import pandas as pd
+
+    uniq, inverse = np.unique(codes, return_inverse=True)
+    labels = [names(int(c)) for c in uniq]
+    categories = sorted(set(labels))
+    index = {label: i for i, label in enumerate(categories)}
+    label_codes = np.array([index[label] for label in labels], dtype=np.int32)
+    return pd.Categorical.from_codes(label_codes[inverse], categories)
+
+
+def load_trace(path):
+    """Load a column file into a pandas DataFrame.
+
+    Adds the layer_name, event and system columns with the names the text
+    output uses, and one boolean column per event flag.
+    """
+    import pandas as pd
+
+    data, _ = read_columns(path)
+    df = pd.DataFrame(data, copy=False)
+
+    df['layer_name'] = _categorical(
+        df['layer'].to_numpy(),
+        lambda c: LAYER_NAMES[c] if c < len(LAYER_NAMES) else 'UNKNOWN')
+    df['event'] = _categorical(
+        df['event_type'].to_numpy(), lambda c: EVENT_NAMES.get(c, 'UNKNOWN'))
+    df['system'] = _categorical(
+        df['system_type'].to_numpy(),
+        lambda c: SYSTEM_NAMES[c] if c < len(SYSTEM_NAMES) else 'Unknown')
+
+    flags = df['flags'].to_numpy()
+    for name, bit in FLAG_COLUMNS.items():
+        df[name] = (flags & bit) != 0
+    return df
+
+
+def aligned_or_size(df):
+    """The ALIGNED column of the text output: aligned_size, or size if 0"""
+    import numpy as np
+
+    aligned = df['aligned_size'].to_numpy()
+    return np.where(aligned != 0, aligned, df['size'].to_numpy())
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("Usage: python3 trace_columns.py <file.cols> "
+              "[--parquet OUT] [--csv OUT]")
+        sys.exit(1)
+
+    path = sys.argv[1]
+    if not Path(path).exists() or not is_column_file(path):
+        print(f"Error: {path} is not a column file")
+        sys.exit(1)
+
+    df = load_trace(path)
+    print(f"{path}: {len(df):,} events")
+    summary = df.groupby('layer_name', observed=True).agg(
+        events=('size', 'size'), bytes=('size', 'sum'),
+        aligned_bytes=('aligned_size', 'sum'))
+    print(summary.to_string())
+
+    args = sys.argv[2:]
+    for flag, writer in (('--parquet', df.to_parquet), ('--csv', df.to_csv)):
+        if flag in args:
+            out = args[args.index(flag) + 1]
+            writer(out, index=False)
+            print(f"Saved to: {out}")
+
+
+if __name__ == "__main__":
+    main()
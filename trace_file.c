@@ -0,0 +1,223 @@
+// Binary trace capture and replay for the userspace tracers
+// File: trace_file.c
+
+#include "trace_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WRITE_BUFFER_SIZE (4 * 1024 * 1024)
+#define RECORD_ALIGN 8
+
+struct trace_writer {
+  int fd;
+  char *buf;
+  size_t used;
+  __u64 records;
+  int error;
+};
+
+static inline size_t record_size(__u32 len) {
+  return (sizeof(struct trace_record_hdr) + len + RECORD_ALIGN - 1) &
+         ~(size_t)(RECORD_ALIGN - 1);
+}
+
+static __u64 clock_ns(clockid_t clk) {
+  struct timespec ts;
+
+  clock_gettime(clk, &ts);
+  return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+  const char *p = data;
+
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static int writer_flush(struct trace_writer *w) {
+  int err;
+
+  if (w->used == 0)
+    return 0;
+
+  err = write_all(w->fd, w->buf, w->used);
+  w->used = 0;
+  if (err && !w->error)
+    w->error = err;
+  return err;
+}
+
+// ============================================================================
+// WRITER
+// ============================================================================
+
+struct trace_writer *trace_writer_open(const char *path, __u32 core_size) {
+  struct trace_file_header hdr = {0};
+  struct trace_writer *w;
+
+  w = calloc(1, sizeof(*w));
+  if (!w)
+    return NULL;
+
+  w->buf = malloc(WRITE_BUFFER_SIZE);
+  w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (!w->buf || w->fd < 0) {
+    if (w->fd >= 0)
+      close(w->fd);
+    free(w->buf);
+    free(w);
+    return NULL;
+  }
+
+  memcpy(hdr.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+  hdr.version = TRACE_FILE_VERSION;
+  hdr.header_size = sizeof(hdr);
+  hdr.core_size = core_size;
+  hdr.start_ns = clock_ns(CLOCK_MONOTONIC);
+  hdr.boot_offset_ns = clock_ns(CLOCK_REALTIME) - hdr.start_ns;
+  gethostname(hdr.hostname, sizeof(hdr.hostname) - 1);
+
+  memcpy(w->buf, &hdr, sizeof(hdr));
+  w->used = sizeof(hdr);
+  return w;
+}
+
+int trace_writer_append(struct trace_writer *w, const void *data, __u32 len) {
+  size_t size = record_size(len);
+  struct trace_record_hdr rec = {.len = len};
+
+  if (size > WRITE_BUFFER_SIZE)
+    return -E2BIG;
+  if (w->used + size > WRITE_BUFFER_SIZE && writer_flush(w) != 0)
+    return w->error;
+
+  memcpy(w->buf + w->used, &rec, sizeof(rec));
+  memcpy(w->buf + w->used + sizeof(rec), data, len);
+  memset(w->buf + w->used + sizeof(rec) + len, 0, size - sizeof(rec) - len);
+  w->used += size;
+  w->records++;
+  return 0;
+}
+
+int trace_writer_close(struct trace_writer *w) {
+  int err;
+
+  if (!w)
+    return 0;
+
+  writer_flush(w);
+  err = w->error;
+  if (close(w->fd) != 0 && !err)
+    err = -errno;
+  free(w->buf);
+  free(w);
+  return err;
+}
+
+__u64 trace_writer_records(const struct trace_writer *w) {
+  return w ? w->records : 0;
+}
+
+// ============================================================================
+// READER
+// ============================================================================
+
+int trace_reader_open(struct trace_reader *r, const char *path,
+                      __u32 core_size) {
+  struct stat st;
+
+  memset(r, 0, sizeof(*r));
+  r->fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (r->fd < 0)
+    return -errno;
+
+  if (fstat(r->fd, &st) != 0 || (size_t)st.st_size < sizeof(r->header)) {
+    fprintf(stderr, "%s: not a trace capture file\n", path);
+    goto err;
+  }
+
+  r->size = st.st_size;
+  r->base = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+  if (r->base == MAP_FAILED) {
+    r->base = NULL;
+    goto err;
+  }
+  madvise((void *)r->base, r->size, MADV_SEQUENTIAL);
+
+  memcpy(&r->header, r->base, sizeof(r->header));
+  if (memcmp(r->header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC))) {
+    fprintf(stderr, "%s: not a trace capture file\n", path);
+    goto err;
+  }
+  if (r->header.version != TRACE_FILE_VERSION ||
+      r->header.core_size != core_size ||
+      r->header.header_size < sizeof(r->header) ||
+      r->header.header_size > r->size) {
+    fprintf(stderr,
+            "%s: unsupported capture (version %u, event size %u, "
+            "expected version %u, event size %u)\n",
+            path, r->header.version, r->header.core_size, TRACE_FILE_VERSION,
+            core_size);
+    goto err;
+  }
+  return 0;
+
+err:
+  trace_reader_close(r);
+  return -EINVAL;
+}
+
+int trace_reader_replay(struct trace_reader *r, trace_record_fn fn, void *ctx,
+                        __u64 *records) {
+  size_t pos = r->header.header_size;
+  __u64 n = 0;
+  int ret = 0;
+
+  while (pos + sizeof(struct trace_record_hdr) <= r->size) {
+    struct trace_record_hdr rec;
+
+    memcpy(&rec, r->base + pos, sizeof(rec));
+    if (record_size(rec.len) > r->size - pos) {
+      ret = -1;
+      break;
+    }
+
+    ret = fn(ctx, (void *)(r->base + pos + sizeof(rec)), rec.len);
+    if (ret)
+      break;
+
+    pos += record_size(rec.len);
+    n++;
+  }
+
+  if (records)
+    *records = n;
+  return ret;
+}
+
+void trace_reader_close(struct trace_reader *r) {
+  if (r->base)
+    munmap((void *)r->base, r->size);
+  if (r->fd >= 0)
+    close(r->fd);
+  r->base = NULL;
+  r->fd = -1;
+}
@@ -0,0 +1,60 @@
+// Binary trace capture and replay for the userspace tracers
+// File: trace_file.h
+//
+// A capture file is a trace_file_header followed by raw ring buffer
+// records, each prefixed with a trace_record_hdr and padded to 8 bytes.
+// Records are written exactly as they came out of the ring buffer, so a
+// replay can feed them to the same handle_event() as a live trace.
+
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <linux/types.h>
+#include <stddef.h>
+
+#define TRACE_FILE_MAGIC "MLIOTRC"
+#define TRACE_FILE_VERSION 1
+
+struct trace_file_header {
+  char magic[8];
+  __u32 version;
+  __u32 header_size;
+  __u32 core_size;     // sizeof(struct io_event_core) of the writer
+  __u32 flags;
+  __u64 boot_offset_ns; // CLOCK_REALTIME - CLOCK_MONOTONIC at capture start
+  __u64 start_ns;       // CLOCK_MONOTONIC at capture start
+  char hostname[64];
+};
+
+struct trace_record_hdr {
+  __u32 len; // Payload length, excluding this header and padding
+  __u32 _pad;
+};
+
+struct trace_writer;
+
+struct trace_writer *trace_writer_open(const char *path, __u32 core_size);
+int trace_writer_append(struct trace_writer *w, const void *data, __u32 len);
+// Flushes buffered records and closes the file. Returns 0 on success.
+int trace_writer_close(struct trace_writer *w);
+__u64 trace_writer_records(const struct trace_writer *w);
+
+struct trace_reader {
+  int fd;
+  const char *base;
+  size_t size;
+  struct trace_file_header header;
+};
+
+typedef int (*trace_record_fn)(void *ctx, void *data, size_t len);
+
+// Maps the file and validates the header against the expected core size
+int trace_reader_open(struct trace_reader *r, const char *path,
+                      __u32 core_size);
+// Calls fn for every record in file order. Stops early if fn returns
+// non-zero and returns that value; returns -1 on a truncated file.
+int trace_reader_replay(struct trace_reader *r, trace_record_fn fn, void *ctx,
+                        __u64 *records);
+void trace_reader_close(struct trace_reader *r);
+
+#endif // TRACE_FILE_H
@@ -0,0 +1,191 @@
+// Event vocabulary and per-system decoders shared by the userspace tracers
+// File: tracer_events.c
+
+#include "tracer_events.h"
+
+#include <string.h>
+#include <strings.h>
+
+const char *const layer_names[NUM_LAYERS] = {
+    "UNKNOWN", "APPLICATION", "STORAGE_SVC", "OS", "FILESYSTEM", "DEVICE"};
+
+const char *const system_names[NUM_SYSTEM_TYPES] = {
+    "Unknown",    "MinIO",     "Ceph",       "etcd",
+    "PostgreSQL", "GlusterFS", "Application"};
+
+const char *const path_class_names[NUM_PATH_CLASSES] = {"data", "metadata",
+                                                        "journal"};
+
+const char *get_event_name(__u32 event_type) {
+  switch (event_type) {
+  // Application layer
+  case 101:
+    return "APP_READ";
+  case 102:
+    return "APP_WRITE";
+  case 103:
+    return "APP_OPEN";
+  case 104:
+    return "APP_CLOSE";
+  case 105:
+    return "APP_FSYNC";
+  case 106:
+    return "APP_COPY";
+  case 107:
+    return "APP_MMAP_READ";
+  case 108: // No longer emitted, kept for older captures
+    return "APP_URING_SUBMIT";
+
+  // MinIO events of minio_tracer.bpf.c
+  case 110:
+    return "MINIO_OBJECT_PUT";
+  case 111:
+    return "MINIO_OBJECT_GET";
+  case 112:
+    return "MINIO_ERASURE_ENCODE";
+  case 113:
+    return "MINIO_ERASURE_DECODE";
+  case 114:
+    return "MINIO_XL_META";
+  case 115:
+    return "MINIO_REPLICATION";
+
+  // MinIO events of multilayer_io_tracer.bpf.c
+  case 201:
+    return "MINIO_OBJECT_PUT";
+  case 202:
+    return "MINIO_OBJECT_GET";
+  case 203:
+    return "MINIO_ERASURE_WRITE";
+  case 204:
+    return "MINIO_METADATA_UPDATE";
+  case 205:
+    return "MINIO_BITROT_CHECK";
+  case 206:
+    return "MINIO_MULTIPART";
+  case 207:
+    return "MINIO_XL_META";
+  case 208:
+    return "MINIO_ERASURE_READ";
+
+  // OS layer
+  case 301:
+    return "OS_SYSCALL_ENTER";
+  case 302:
+    return "OS_SYSCALL_EXIT";
+  case 303:
+    return "OS_VFS_READ";
+  case 304:
+    return "OS_VFS_WRITE";
+  case 305:
+    return "OS_PAGE_CACHE_HIT";
+  case 306:
+    return "OS_PAGE_CACHE_MISS";
+  case 307:
+    return "OS_CONTEXT_SWITCH";
+
+  // Filesystem layer
+  case 401:
+    return "FS_SYNC";
+  case 402:
+    return "FS_METADATA_UPDATE";
+  case 403:
+    return "FS_DATA_WRITE";
+  case 404:
+    return "FS_INODE_UPDATE";
+  case 405:
+    return "FS_EXTENT_ALLOC";
+  case 406:
+    return "FS_BLOCK_ALLOC";
+  case 407:
+    return "FS_WRITEBACK";
+  case 408:
+    return "FS_JOURNAL_COMMIT";
+
+  // Device layer
+  case 501:
+    return "DEV_BIO_SUBMIT";
+  case 502:
+    return "DEV_BIO_COMPLETE";
+  case 503:
+    return "DEV_REQUEST_QUEUE";
+  case 504:
+    return "DEV_REQUEST_COMPLETE";
+  case 505:
+    return "DEV_FTL_WRITE";
+  case 506:
+    return "DEV_TRIM";
+
+  default:
+    return "UNKNOWN";
+  }
+}
+
+// ============================================================================
+// SYSTEM DECODERS
+// ============================================================================
+
+static const char *basename_of(const char *path) {
+  const char *slash = strrchr(path, '/');
+
+  return slash ? slash + 1 : path;
+}
+
+// Every object is a directory holding xl.meta, with the data either
+// inlined there or in <data-dir uuid>/part.N. .minio.sys holds the
+// bucket, IAM and config metadata.
+static enum path_class classify_minio(const char *path) {
+  if (strcmp(basename_of(path), "xl.meta") == 0 ||
+      strstr(path, "/.minio.sys/"))
+    return PATH_METADATA;
+  return PATH_DATA;
+}
+
+// BlueStore writes to the block, block.db and block.wal devices linked
+// from the OSD directory; FileStore keeps objects below current/, their
+// omap in a LevelDB and a separate journal
+static enum path_class classify_ceph(const char *path) {
+  const char *base = basename_of(path);
+
+  if (strcmp(base, "block.wal") == 0 || strcmp(base, "journal") == 0)
+    return PATH_JOURNAL;
+  if (strcmp(base, "block.db") == 0 || strcmp(base, "superblock") == 0 ||
+      strstr(path, "/current/omap/") || strstr(path, "/current/meta/"))
+    return PATH_METADATA;
+  return PATH_DATA;
+}
+
+// member/wal/*.wal is the raft log, member/snap/db the bbolt key-value
+// store, and member/snap/*.snap the raft snapshots
+static enum path_class classify_etcd(const char *path) {
+  size_t len = strlen(path);
+
+  if (strstr(path, "/member/wal/"))
+    return PATH_JOURNAL;
+  if (len > 5 && strcmp(path + len - 5, ".snap") == 0)
+    return PATH_METADATA;
+  return PATH_DATA;
+}
+
+static const struct system_decoder decoders[] = {
+    {"minio", SYSTEM_TYPE_MINIO, classify_minio},
+    {"ceph", SYSTEM_TYPE_CEPH, classify_ceph},
+    {"etcd", SYSTEM_TYPE_ETCD, classify_etcd},
+};
+
+const struct system_decoder *system_decoder_by_name(const char *name) {
+  for (size_t i = 0; name && i < sizeof(decoders) / sizeof(decoders[0]);
+       i++) {
+    if (strcasecmp(name, decoders[i].name) == 0)
+      return &decoders[i];
+  }
+  return NULL;
+}
+
+const struct system_decoder *system_decoder_by_type(__u32 system_type) {
+  for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++) {
+    if (decoders[i].system_type == system_type)
+      return &decoders[i];
+  }
+  return NULL;
+}
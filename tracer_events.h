@@ -0,0 +1,65 @@
+// Event vocabulary and per-system decoders shared by the userspace tracers
+// File: tracer_events.h
+//
+// One place for the layer, storage system and event type names that every
+// tracer prints, so a new event type is named once for all of them. Both
+// BPF programs number their events from the same space: minio_tracer.bpf.c
+// uses 110-115 for its MinIO events, multilayer_io_tracer.bpf.c 201-208.
+//
+// A system decoder knows one storage system's on-disk layout and tells the
+// files holding its data from its metadata and its write-ahead log, which
+// is where most of the amplification of each system comes from.
+
+#ifndef TRACER_EVENTS_H
+#define TRACER_EVENTS_H
+
+#include <linux/types.h>
+
+// Layer definitions (must match BPF program)
+#define LAYER_APPLICATION 1
+#define LAYER_STORAGE_SERVICE 2
+#define LAYER_OPERATING_SYSTEM 3
+#define LAYER_FILESYSTEM 4
+#define LAYER_DEVICE 5
+#define NUM_LAYERS 6 // Indexed by layer, 0 unknown
+
+// Storage system types (must match BPF program)
+#define SYSTEM_TYPE_UNKNOWN 0
+#define SYSTEM_TYPE_MINIO 1
+#define SYSTEM_TYPE_CEPH 2
+#define SYSTEM_TYPE_ETCD 3
+#define SYSTEM_TYPE_POSTGRES 4
+#define SYSTEM_TYPE_GLUSTER 5
+#define SYSTEM_TYPE_APPLICATION 6
+#define NUM_SYSTEM_TYPES 7
+
+extern const char *const layer_names[NUM_LAYERS];
+extern const char *const system_names[NUM_SYSTEM_TYPES];
+
+// "UNKNOWN" for numbers no tracer emits
+const char *get_event_name(__u32 event_type);
+
+// ============================================================================
+// SYSTEM DECODERS
+// ============================================================================
+
+enum path_class {
+  PATH_DATA,
+  PATH_METADATA,
+  PATH_JOURNAL, // Write-ahead log or journal
+  NUM_PATH_CLASSES,
+};
+
+extern const char *const path_class_names[NUM_PATH_CLASSES];
+
+struct system_decoder {
+  const char *name; // As given to -s
+  __u32 system_type;
+  enum path_class (*classify)(const char *path);
+};
+
+// NULL for systems without a decoder
+const struct system_decoder *system_decoder_by_name(const char *name);
+const struct system_decoder *system_decoder_by_type(__u32 system_type);
+
+#endif // TRACER_EVENTS_H
@@ -0,0 +1,233 @@
+#!/bin/bash
+
+# Tracer Overhead Benchmark
+# Runs the same fio read/write workloads with no tracer, under each
+# multilayer_io_tracer mode and under strace, and reports what tracing costs
+# File: tracer_overhead_benchmark.sh
+#
+# Usage: sudo ./tracer_overhead_benchmark.sh [TRACER]
+#   TRACER       path to multilayer_io_tracer (default: ./build/multilayer_io_tracer)
+#   RESULTS_DIR  write overhead.csv here, e.g. next to an experiment's
+#                summary.csv (default: a new bench_results_<date> directory)
+#   BENCH_DIR    directory holding the fio test files (default: /tmp/mlio_bench)
+#   RUNTIME      seconds per workload run (default: 10)
+#   MODES        subset of "none full sampled aggregated strace"
+
+set -e
+
+# Configuration
+TRACER=${1:-./build/multilayer_io_tracer}
+SIZES=(1 1024 102400 1048576 10485760 104857600)
+NAMES=("1B" "1KB" "100KB" "1MB" "10MB" "100MB")
+OPERATIONS=(write read)
+MODES=(${MODES:-none full sampled aggregated strace})
+RUNTIME=${RUNTIME:-10}
+BENCH_DIR=${BENCH_DIR:-/tmp/mlio_bench}
+SAMPLE_RATE=10
+
+# Tracer flags per mode. Every mode writes its summary to the log so the
+# event and drop counts can be read back.
+declare -A MODE_FLAGS=(
+    [full]=""
+    [sampled]="-q -n $SAMPLE_RATE"
+    [aggregated]="-a -q"
+)
+
+# Colors
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+if [ "$EUID" -ne 0 ]; then
+    echo -e "${RED}Error: run as root, the tracer and bpf_stats need it${NC}"
+    exit 1
+fi
+if ! command -v fio >/dev/null 2>&1; then
+    echo -e "${RED}Error: fio not found (apt-get install fio)${NC}"
+    exit 1
+fi
+if [ ! -x "$TRACER" ]; then
+    echo -e "${RED}Error: $TRACER not found, run 'make multi' first${NC}"
+    exit 1
+fi
+
+RESULTS_DIR=${RESULTS_DIR:-bench_results_$(date +%Y%m%d_%H%M%S)}
+mkdir -p $RESULTS_DIR/runs $BENCH_DIR
+CSV=$RESULTS_DIR/overhead.csv
+
+echo "=========================================================================="
+echo "Tracer Overhead Benchmark"
+echo "Tracer: $TRACER"
+echo "Results directory: $RESULTS_DIR"
+echo "=========================================================================="
+
+# Per-program run time is only accounted while kernel.bpf_stats_enabled is
+# set; restore the previous value on exit
+BPF_STATS_WAS=$(sysctl -n kernel.bpf_stats_enabled 2>/dev/null || echo 0)
+sysctl -qw kernel.bpf_stats_enabled=1 || \
+    echo -e "${YELLOW}Warning: cannot enable bpf_stats, BPF run time will be 0${NC}"
+trap 'sysctl -qw kernel.bpf_stats_enabled=$BPF_STATS_WAS 2>/dev/null' EXIT
+
+# Run one fio job, writing its JSON report to $3
+run_fio() {
+    local size=$1
+    local op=$2
+    local json=$3
+    local prefix=$4
+    local bs=$size
+
+    # Large objects are moved in 1MB requests, like an S3 multipart client
+    [ "$bs" -gt 1048576 ] && bs=1048576
+
+    $prefix fio --name=mlio_bench --filename=$BENCH_DIR/bench_${size}.dat \
+        --rw=$op --bs=$bs --size=$size --ioengine=psync \
+        --time_based --runtime=$RUNTIME --fsync_on_close=1 \
+        --output-format=json --output=$json >/dev/null
+}
+
+# Sum utime + stime of a process in nanoseconds
+process_cpu_ns() {
+    local ticks
+    ticks=$(awk '{print $14 + $15}' /proc/$1/stat 2>/dev/null || echo 0)
+    echo $((ticks * 1000000000 / $(getconf CLK_TCK)))
+}
+
+# Sum run_time_ns and run_cnt over the programs loaded by a process
+bpf_run_stats() {
+    bpftool prog show --json 2>/dev/null | python3 -c "
+import json, sys
+pid = int(sys.argv[1])
+run_ns = run_cnt = 0
+for prog in json.load(sys.stdin):
+    if any(p.get('pid') == pid for p in prog.get('pids', [])):
+        run_ns += prog.get('run_time_ns', 0)
+        run_cnt += prog.get('run_cnt', 0)
+print(run_ns, run_cnt)
+" $1 || echo "0 0"
+}
+
+# Pull events and drops back out of a tracer summary
+parse_tracer_log() {
+    awk '
+        /^Per-Layer Statistics:/ { in_layers = 1; next }
+        in_layers && /^(APPLICATION|STORAGE_SVC|OS|FILESYSTEM|DEVICE) / {
+            events += $2
+        }
+        in_layers && /^$/ { in_layers = 0 }
+        /^Event Streaming/ { in_stream = 1; next }
+        in_stream && /^(APPLICATION|STORAGE_SVC|OS|FILESYSTEM|DEVICE) / {
+            ring_drops += $5
+        }
+        in_stream && /^$/ { in_stream = 0 }
+        /Events dropped:/ { queue_drops += $3 }
+        END { printf "%d %d %d\n", events, ring_drops, queue_drops }
+    ' $1
+}
+
+# Throughput (bytes/s) and p99 completion latency (us) from a fio report
+parse_fio() {
+    python3 -c "
+import json, sys
+job = json.load(open(sys.argv[1]))['jobs'][0][sys.argv[2]]
+p99 = job.get('clat_ns', {}).get('percentile', {}).get('99.000000', 0)
+print(job['bw_bytes'], '%.1f' % (p99 / 1000.0))
+" $1 $2
+}
+
+run_benchmark() {
+    local size=$1
+    local name=$2
+    local op=$3
+    local mode=$4
+    local run=$RESULTS_DIR/runs/${name}_${op}_${mode}
+    local tracer_pid=""
+    local events=0 ring_drops=0 queue_drops=0 cpu_ns=0
+    local bpf_ns=0 bpf_cnt=0
+
+    echo -e "${BLUE}  $mode${NC}"
+
+    # Reads come from a file laid out before any tracer is attached
+    if [ "$op" = "read" ] && [ ! -f $BENCH_DIR/bench_${size}.dat ]; then
+        head -c $size /dev/zero > $BENCH_DIR/bench_${size}.dat
+    fi
+
+    case $mode in
+    none)
+        run_fio $size $op $run.json ""
+        ;;
+    strace)
+        run_fio $size $op $run.json "strace -f -qq -o /dev/null"
+        ;;
+    *)
+        $TRACER ${MODE_FLAGS[$mode]} -o $run.log &
+        tracer_pid=$!
+        sleep 2 # Load and attach
+
+        run_fio $size $op $run.json ""
+
+        cpu_ns=$(process_cpu_ns $tracer_pid)
+        read bpf_ns bpf_cnt < <(bpf_run_stats $tracer_pid)
+        kill -INT $tracer_pid 2>/dev/null || true
+        wait $tracer_pid 2>/dev/null || true
+        read events ring_drops queue_drops < <(parse_tracer_log $run.log)
+        ;;
+    esac
+
+    read bw p99 < <(parse_fio $run.json $op)
+    echo "${size},${op},${mode},${bw},${p99},${events},${cpu_ns},${ring_drops},${queue_drops},${bpf_ns},${bpf_cnt}" \
+        >> $RESULTS_DIR/raw.csv
+}
+
+echo "Size,Operation,Mode,Throughput_Bps,P99_us,Events,Tracer_CPU_ns,Ring_Drops,Queue_Drops,BPF_Run_ns,BPF_Run_Cnt" \
+    > $RESULTS_DIR/raw.csv
+
+for i in ${!SIZES[@]}; do
+    for op in ${OPERATIONS[@]}; do
+        echo -e "${GREEN}${NAMES[$i]} $op${NC}"
+        for mode in ${MODES[@]}; do
+            run_benchmark ${SIZES[$i]} ${NAMES[$i]} $op $mode
+        done
+        rm -f $BENCH_DIR/bench_${SIZES[$i]}.dat
+    done
+done
+
+# Deltas are against the untraced run of the same size and operation
+python3 - $RESULTS_DIR/raw.csv $CSV << 'EOF'
+import csv, sys
+
+rows = list(csv.DictReader(open(sys.argv[1])))
+base = {(r['Size'], r['Operation']): r for r in rows if r['Mode'] == 'none'}
+
+def delta(value, ref):
+    return '%.1f' % (100.0 * (value - ref) / ref) if ref else ''
+
+with open(sys.argv[2], 'w', newline='') as f:
+    out = csv.writer(f)
+    out.writerow(['Size', 'Operation', 'Mode', 'Throughput_Bps',
+                  'Throughput_Delta_Pct', 'P99_us', 'P99_Delta_Pct',
+                  'Events', 'CPU_ns_per_Event', 'Ring_Drops', 'Queue_Drops',
+                  'BPF_Run_ns', 'BPF_ns_per_Run'])
+    for r in rows:
+        ref = base.get((r['Size'], r['Operation']))
+        bw, p99 = float(r['Throughput_Bps']), float(r['P99_us'])
+        events, cpu = int(r['Events']), int(r['Tracer_CPU_ns'])
+        runs, run_ns = int(r['BPF_Run_Cnt']), int(r['BPF_Run_ns'])
+        out.writerow([
+            r['Size'], r['Operation'], r['Mode'], int(bw),
+            delta(bw, float(ref['Throughput_Bps'])) if ref else '',
+            r['P99_us'], delta(p99, float(ref['P99_us'])) if ref else '',
+            events, '%.0f' % (cpu / events) if events else '',
+            r['Ring_Drops'], r['Queue_Drops'], run_ns,
+            '%.0f' % (run_ns / runs) if runs else ''])
+EOF
+
+echo ""
+echo "=========================================================================="
+echo -e "${GREEN}Benchmark complete${NC}"
+echo "=========================================================================="
+column -t -s ',' $CSV
+echo ""
+echo "  • Overhead CSV: $CSV"
+echo "  • Per-run fio reports and tracer logs: $RESULTS_DIR/runs/"